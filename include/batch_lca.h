@@ -0,0 +1,129 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file batch_lca.h
+    \brief batch_lca.h contains an offline algorithm to answer many lca queries with one sweep over the LCP.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_BATCH_LCA_H
+#define CST_CN_BATCH_LCA_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace cstds {
+
+    //! Computes res[i] = cst.lca(v[i], w[i]) for all the pairs at once.
+    /*!
+    * Non nested pairs are reduced to a range minimum query over LCP[a..b]. The queries are
+    * sorted by b and answered with a left to right sweep over the LCP that keeps a stack of
+    * the positions that can still be a minimum. The previous smaller value of the minimum
+    * is taken from the stack, and its next smaller value is the position that pops it, so
+    * most queries do not touch the NPR at all. The sorted queries can be split in `threads`
+    * groups that are swept concurrently.
+    * Since the sweep reads LCP[min a..max b] sequentially, it pays off when the number of
+    * pairs is large with respect to the covered range.
+    */
+    template<class t_cst>
+    void
+    lca_batch(const t_cst& cst, const std::vector<typename t_cst::node_type>& v,
+              const std::vector<typename t_cst::node_type>& w,
+              std::vector<typename t_cst::node_type>& res, size_t threads = 1) {
+        typedef typename t_cst::size_type size_type;
+        size_type n_pairs = v.size();
+        std::vector<size_type> qa(n_pairs), qb(n_pairs), order;
+        res.resize(n_pairs);
+        for (size_type i = 0; i < n_pairs; ++i) {
+            if (cst.ancestor(v[i], w[i]))
+                res[i] = v[i];
+            else if (cst.ancestor(w[i], v[i]))
+                res[i] = w[i];
+            else {
+                if (v[i].second < w[i].first) {
+                    qa[i] = v[i].second + 1;
+                    qb[i] = w[i].first;
+                } else {
+                    qa[i] = w[i].second + 1;
+                    qb[i] = v[i].first;
+                }
+                order.push_back(i);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](size_type x, size_type y) { return qb[x] < qb[y]; });
+
+        auto sweep = [&](size_type q_begin, size_type q_end) {
+            const size_type npos = (size_type) -1;
+            struct entry {
+                size_type pos, value, prev_smaller, pending;
+            };
+            size_type n = cst.size(), lcp_value;
+            std::vector<entry> stack;
+            std::vector<size_type> next_pending(q_end - q_begin, npos), min_pos(q_end - q_begin);
+            size_type start = qa[order[q_begin]];
+            for (size_type k = q_begin; k < q_end; ++k)
+                start = std::min(start, qa[order[k]]);
+            size_type k = q_begin;
+            for (size_type p = start; k < q_end; ++p) {
+                entry e = {p, cst.lcp[p], npos, npos};
+                while (!stack.empty() and stack.back().value > e.value) { //p is the nsv of the popped entry
+                    for (size_type q = stack.back().pending; q != npos; q = next_pending[q])
+                        res[order[q_begin + q]].second = p - 1;
+                    stack.pop_back();
+                }
+                if (!stack.empty())
+                    e.prev_smaller = (stack.back().value == e.value) ? stack.back().prev_smaller : stack.size() - 1;
+                stack.push_back(e);
+                for (; k < q_end and qb[order[k]] == p; ++k) {
+                    size_type a = qa[order[k]];
+                    size_type s = std::lower_bound(stack.begin(), stack.end(), a,
+                                                   [](const entry& x, size_type y) { return x.pos < y; }) - stack.begin();
+                    size_type l;
+                    if (stack[s].prev_smaller != npos)
+                        l = stack[stack[s].prev_smaller].pos;
+                    else { //the previous smaller value is before the sweep
+                        l = cst.npr.psv(stack[s].pos, lcp_value);
+                        if (l == n)
+                            l = 0;
+                    }
+                    res[order[k]].first = l;
+                    min_pos[k - q_begin] = stack[s].pos;
+                    next_pending[k - q_begin] = stack[s].pending;
+                    stack[s].pending = k - q_begin;
+                }
+            }
+            for (auto& e : stack) { //the next smaller value is after the sweep
+                for (size_type q = e.pending; q != npos; q = next_pending[q])
+                    res[order[q_begin + q]].second = cst.npr.nsv(min_pos[q], lcp_value) - 1;
+            }
+        };
+
+        size_type n_queries = order.size();
+        if (threads <= 1 or n_queries < 2 * threads) {
+            if (n_queries > 0)
+                sweep(0, n_queries);
+            return;
+        }
+        std::vector<std::thread> pool;
+        size_type chunk = (n_queries + threads - 1) / threads;
+        for (size_type q = 0; q < n_queries; q += chunk)
+            pool.emplace_back(sweep, q, std::min(q + chunk, n_queries));
+        for (auto& th : pool)
+            th.join();
+    }
+
+}
+
+#endif //CST_CN_BATCH_LCA_H
@@ -0,0 +1,308 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file construct_cst_cn.h
+    \brief construct_cst_cn.h contains the construction pipeline of cst_cn using several threads.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_CONSTRUCT_H
+#define CST_CN_CONSTRUCT_H
+
+#include <sdsl/construct.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include "construction_report.h"
+#include "parallel.h"
+#include "text_input.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <string>
+#include <vector>
+
+namespace cstds {
+
+    using namespace sdsl;
+
+    //! Copies the inputs named by spec (see input_files) to the cache under key, separated by
+    //! INPUT_SEPARATOR and followed by the 0 symbol, without keeping the whole text in memory.
+    //! Each symbol takes num_bytes bytes (little endian). Returns false if an input cannot be
+    //! read or contains the 0 symbol, or the separator when spec is a list of files.
+    template<uint8_t t_width>
+    bool
+    stream_text_to_cache(const std::string& spec, const std::string& key, cache_config& config,
+                         uint8_t num_bytes = 1) {
+        std::vector<std::string> files = input_files(spec);
+        if (num_bytes == 0 or files.empty()) {
+            std::cerr << "Error: \"" << spec << "\" is not a list of files or a stream of symbols." << std::endl;
+            return false;
+        }
+        bool listed = spec[0] == '@';
+        int_vector_buffer<t_width> text(cache_file_name(key, config), std::ios::out, 1 << 20,
+                                        t_width ? t_width : 8 * num_bytes);
+        std::vector<char> buf(1 << 20);
+        for (uint64_t f = 0; f < files.size(); ++f) {
+            text_source in(files[f]);
+            if (!in.good()) {
+                std::cerr << "Error: File \"" << files[f] << "\" could not be opened." << std::endl;
+                text.close(true);
+                return false;
+            }
+            if (f > 0)
+                text.push_back(INPUT_SEPARATOR);
+            uint64_t symbol = 0;
+            uint8_t k = 0; //bytes of symbol read
+            ssize_t len;
+            while ((len = in.read(buf.data(), buf.size())) > 0) {
+                for (ssize_t i = 0; i < len; ++i) {
+                    symbol |= (uint64_t) (uint8_t) buf[i] << (8 * k);
+                    if (++k < num_bytes)
+                        continue;
+                    if (symbol == 0) {
+                        std::cerr << "Error: File \"" << files[f] << "\" contains zero symbol." << std::endl;
+                        text.close(true);
+                        return false;
+                    }
+                    if (listed and symbol == INPUT_SEPARATOR) {
+                        std::cerr << "Error: File \"" << files[f] << "\" contains the separator symbol "
+                                  << (uint64_t) INPUT_SEPARATOR << " of the listed files." << std::endl;
+                        text.close(true);
+                        return false;
+                    }
+                    text.push_back(symbol);
+                    symbol = 0;
+                    k = 0;
+                }
+            }
+            if (len < 0 or !in.close()) {
+                std::cerr << "Error: File \"" << files[f] << "\" could not be read." << std::endl;
+                text.close(true);
+                return false;
+            }
+        }
+        text.push_back(0);
+        text.close();
+        return true;
+    }
+
+    //! Builds the BWT from the text and the suffix array of the cache using `threads`
+    //! threads and stores it in the cache, as construct_bwt does. Unlike construct_bwt, which
+    //! streams the suffix array, both arrays are kept in memory.
+    template<uint8_t t_width>
+    void
+    construct_bwt_parallel(cache_config& config, uint64_t threads) {
+        int_vector<t_width> text;
+        load_from_cache(text, key_text_trait<t_width>::KEY_TEXT, config);
+        int_vector<> sa;
+        load_from_cache(sa, conf::KEY_SA, config);
+        uint64_t n = sa.size();
+        int_vector<t_width> bwt(n, 0, text.width());
+        parallel_for(n, threads, [&](uint64_t from, uint64_t to) {
+            for (uint64_t i = from; i < to; ++i)
+                bwt[i] = sa[i] ? text[sa[i] - 1] : text[n - 1];
+        });
+        store_to_cache(bwt, key_bwt_trait<t_width>::KEY_BWT, config);
+    }
+
+    //! Builds the LCP array from the text and the suffix array of the cache with the PHI
+    //! algorithm using `threads` threads and stores it in the cache, as construct_lcp_PHI does.
+    /*!
+    * PHI[SA[i]] = SA[i-1] is scattered by one thread. Then the positions of the text are
+    * split in one range per thread, and each range computes its PLCP values over PHI with
+    * the PHI algorithm: PLCP[i+1] >= PLCP[i] - 1, so only the first position of a range is
+    * compared from scratch. Last, LCP[i] = PLCP[SA[i]] overwrites the suffix array. The
+    * ranges are aligned to 64 values (see parallel_for), so the threads never write the same
+    * word. Keeps the text and two arrays of n log n bits in memory.
+    */
+    template<uint8_t t_width>
+    void
+    construct_lcp_phi_parallel(cache_config& config, uint64_t threads) {
+        int_vector<t_width> text;
+        load_from_cache(text, key_text_trait<t_width>::KEY_TEXT, config);
+        int_vector<> sa;
+        load_from_cache(sa, conf::KEY_SA, config);
+        uint64_t n = sa.size();
+        if (n == 0)
+            return;
+        uint64_t sa0 = sa[0]; //the 0 symbol, which has no previous suffix
+        int_vector<> plcp(n, 0, sa.width()); //PHI, overwritten by PLCP
+        for (uint64_t i = 1; i < n; ++i)
+            plcp[sa[i]] = sa[i - 1];
+        util::clear(sa);
+        parallel_for(n, threads, [&](uint64_t from, uint64_t to) {
+            uint64_t l = 0;
+            for (uint64_t i = from; i < to; ++i) {
+                if (i == sa0)
+                    l = 0;
+                else //the 0 symbol is unique, so the comparison stops before it
+                    for (uint64_t j = plcp[i]; text[i + l] == text[j + l]; ++l) { }
+                plcp[i] = l;
+                if (l > 0)
+                    --l;
+            }
+        });
+        util::clear(text);
+        load_from_cache(sa, conf::KEY_SA, config);
+        parallel_for(n, threads, [&](uint64_t from, uint64_t to) {
+            for (uint64_t i = from; i < to; ++i)
+                sa[i] = plcp[sa[i]];
+        });
+        store_to_cache(sa, conf::KEY_LCP, config);
+    }
+
+    //! Builds idx from the text in file using up to `threads` threads.
+    /*!
+    * file can also be "-" (stdin), a gzip or zstd file, or "@list_file" to index the files
+    * listed in list_file separated by INPUT_SEPARATOR. Those inputs are streamed into the
+    * text of the cache, which the suffix array construction reads.
+    *
+    * Follows the same steps of sdsl::construct for a CST. The suffix array is built by sdsl
+    * with one thread (divsufsort or the semi-external SAIS). With threads > 1 and no memory
+    * hint, the BWT is then built in parallel from the suffix array, and the CSA is built
+    * at the same time as the LCP array, which is computed by the other threads with
+    * construct_lcp_phi_parallel. Afterwards the levels of the NPR are computed in parallel
+    * by the constructor of cst_cn. With threads = 1 the result and the order of the steps
+    * are the same of sdsl::construct (the LCP with the semi-external PHI).
+    *
+    * mem_hint (in bytes) is a hint to reduce the peak memory, not a bound on it. If it is
+    * not 0, the text is streamed into the cache, the suffix array is built with the
+    * semi-external SAIS of sdsl when divsufsort would need more than mem_hint, the CSA and
+    * the LCP are only built at the same time if both fit in it, and the NPR reads the plain
+    * LCP from the cache instead of the compressed one. All the intermediate arrays (SA, BWT,
+    * LCP) are kept in config.dir, but the semi-external SAIS, the BWT, the PHI algorithm of
+    * the LCP and the CSA still keep about n bytes (the text or the BWT) in memory whatever
+    * mem_hint is, so the text must fit in memory.
+    * The algorithm of the suffix array is chosen for this call only: the global
+    * construct_config::byte_algo_sa is not modified, so concurrent builds (e.g. the shards of
+    * sharded_cst) do not interfere.
+    * npr_args are given to the NPR constructor (e.g. the block size of npr_support_cn_dyn).
+    * Returns false, leaving idx untouched, if the text could not be parsed.
+    */
+    template<class t_index, class... t_npr_args>
+    bool
+    construct_cst_cn(t_index& idx, const std::string& file, cache_config& config, uint8_t num_bytes,
+                     uint64_t threads = 1, uint64_t mem_hint = 0, t_npr_args... npr_args) {
+        const uint8_t width = t_index::alphabet_category::WIDTH;
+        const char* KEY_TEXT = key_text_trait<width>::KEY_TEXT;
+        const char* KEY_BWT = key_bwt_trait<width>::KEY_BWT;
+        typedef int_vector<width> text_type;
+        typedef typename t_index::csa_type csa_type;
+        const std::string key_csa = std::string(conf::KEY_CSA) + "_" + util::class_to_hash(csa_type());
+        {
+            auto event = memory_monitor::event("parse input text");
+            construction_report::phase phase("parse input text");
+            bool parsed = true;
+            if (!cache_file_exists(KEY_TEXT, config) and
+                (!is_plain_input(file) or (mem_hint > 0 and width == 8 and num_bytes == 1))) {
+                parsed = stream_text_to_cache<width>(file, KEY_TEXT, config, num_bytes);
+            } else if (!cache_file_exists(KEY_TEXT, config)) {
+                text_type text;
+                load_vector_from_file(text, file, num_bytes);
+                if (contains_no_zero_symbol(text, file)) {
+                    append_zero_symbol(text);
+                    store_to_cache(text, KEY_TEXT, config);
+                } else
+                    parsed = false;
+            }
+            if (!parsed)
+                return false;
+            register_cache_file(KEY_TEXT, config);
+        }
+        uint64_t n = 0;
+        {
+            //the text of an integer alphabet is bit compressed, so n is read from the header
+            int_vector_buffer<width> text_buf(cache_file_name(KEY_TEXT, config), std::ios::in);
+            n = text_buf.size();
+        }
+        {
+            auto event = memory_monitor::event("SA");
+            construction_report::phase phase("SA");
+            if (!cache_file_exists(conf::KEY_SA, config)) {
+                uint64_t sa_bytes = n * (1 + (n < (1ULL << 31) ? 4 : 8)); //text + divsufsort SA
+                if (mem_hint > 0 and width == 8 and sa_bytes > mem_hint)
+                    construct_sa_se(config);
+                else
+                    construct_sa<width>(config);
+            }
+            register_cache_file(conf::KEY_SA, config);
+        }
+        {
+            auto event = memory_monitor::event("BWT");
+            construction_report::phase phase("BWT");
+            if (!cache_file_exists(KEY_BWT, config)) {
+                if (threads > 1 and mem_hint == 0)
+                    construct_bwt_parallel<width>(config, threads);
+                else
+                    construct_bwt<width>(config);
+            }
+            register_cache_file(KEY_BWT, config);
+        }
+        {
+            auto event = memory_monitor::event("CSA and LCP");
+            construction_report::phase phase("CSA and LCP");
+            //each task works over its own copy of the file map
+            cache_config csa_config(false, config.dir, config.id, config.file_map);
+            cache_config lcp_config(false, config.dir, config.id, config.file_map);
+            auto build_csa = [&]() {
+                if (!cache_file_exists(key_csa, csa_config)) {
+                    csa_type csa(csa_config);
+                    store_to_cache(csa, key_csa, csa_config);
+                }
+            };
+            auto build_lcp = [&]() {
+                if (!cache_file_exists(conf::KEY_LCP, lcp_config)) {
+                    if (threads > 1 and mem_hint == 0)
+                        construct_lcp_phi_parallel<width>(lcp_config, threads - 1); //one builds the CSA
+                    else if (width == 8)
+                        construct_lcp_semi_extern_PHI(lcp_config);
+                    else
+                        construct_lcp_PHI<width>(lcp_config);
+                }
+            };
+            //each task keeps about 2n bytes in memory (more the parallel LCP, only used without a hint)
+            if (threads > 1 and (mem_hint == 0 or 4 * n <= mem_hint)) {
+                std::thread lcp_thread(build_lcp);
+                build_csa();
+                lcp_thread.join();
+            } else {
+                {
+                    construction_report::phase csa_phase("CSA");
+                    build_csa();
+                }
+                construction_report::phase lcp_phase("LCP");
+                build_lcp();
+            }
+            for (auto& f : csa_config.file_map)
+                config.file_map.insert(f);
+            for (auto& f : lcp_config.file_map)
+                config.file_map.insert(f);
+            register_cache_file(key_csa, config);
+            register_cache_file(conf::KEY_LCP, config);
+        }
+        {
+            auto event = memory_monitor::event("CST");
+            construction_report::phase phase("CST");
+            t_index tmp(config, threads, mem_hint > 0, npr_args...);
+            tmp.swap(idx);
+        }
+        if (config.delete_files) {
+            auto event = memory_monitor::event("delete temporary files");
+            util::delete_all_files(config.file_map);
+        }
+        return true;
+    }
+
+}
+
+#endif //CST_CN_CONSTRUCT_H
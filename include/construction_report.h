@@ -0,0 +1,227 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file construction_report.h
+    \brief construction_report.h contains a recorder of the time, memory and output of each construction phase.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_CONSTRUCTION_REPORT_H
+#define CST_CN_CONSTRUCTION_REPORT_H
+
+#include <sys/resource.h>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+namespace cstds {
+
+    //! Records, for each construction phase, its wall time, CPU time, peak RSS and bytes written.
+    /*!
+    * Phases are opened with a construction_report::phase object and closed when it is
+    * destroyed, so they can be nested. Nothing is recorded unless the report is enabled.
+    * On Linux the peak RSS of each phase is measured by resetting VmHWM through
+    * /proc/self/clear_refs and the bytes written are taken from /proc/self/io; elsewhere
+    * the peak is the one of the process so far and the bytes written are 0.
+    */
+    class construction_report {
+    public:
+        struct record_type {
+            std::string name;
+            uint64_t depth;
+            double wall_seconds;
+            double cpu_seconds;
+            uint64_t peak_rss_bytes;
+            uint64_t bytes_written;
+        };
+
+        //! A phase of the construction, recorded from its creation to its destruction.
+        class phase {
+            construction_report* m_report = nullptr;
+            uint64_t m_idx = 0;
+            std::chrono::steady_clock::time_point m_wall;
+            std::clock_t m_cpu = 0;
+            uint64_t m_written = 0;
+
+        public:
+            explicit phase(const std::string& name) {
+                construction_report& report = instance();
+                if (!report.enabled())
+                    return;
+                m_report = &report;
+                m_idx = report.open(name);
+                m_written = written_bytes();
+                m_cpu = std::clock();
+                m_wall = std::chrono::steady_clock::now();
+            }
+
+            ~phase() {
+                if (m_report == nullptr)
+                    return;
+                auto wall = std::chrono::steady_clock::now() - m_wall;
+                m_report->close(m_idx, std::chrono::duration<double>(wall).count(),
+                                (double) (std::clock() - m_cpu) / CLOCKS_PER_SEC, written_bytes() - m_written);
+            }
+
+            phase(const phase&) = delete;
+            phase& operator=(const phase&) = delete;
+        };
+
+    private:
+        bool m_enabled = false;
+        std::vector<record_type> m_records;
+        std::vector<uint64_t> m_open; //stack of open phases
+        std::mutex m_mutex;
+
+        construction_report() {}
+
+        static bool
+        reset_peak_rss() {
+            std::ofstream out("/proc/self/clear_refs");
+            out << "5";
+            return (bool) out;
+        }
+
+        static uint64_t
+        peak_rss() {
+            std::ifstream in("/proc/self/status");
+            std::string key;
+            uint64_t value;
+            while (in >> key) {
+                if (key == "VmHWM:" and in >> value)
+                    return value * 1024;
+            }
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return (uint64_t) usage.ru_maxrss * 1024;
+        }
+
+        static uint64_t
+        written_bytes() {
+            std::ifstream in("/proc/self/io");
+            std::string key;
+            uint64_t value;
+            while (in >> key >> value) {
+                if (key == "wchar:")
+                    return value;
+            }
+            return 0;
+        }
+
+        uint64_t
+        open(const std::string& name) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_open.empty()) { //keep the peak of the parent before resetting it
+                record_type& parent = m_records[m_open.back()];
+                parent.peak_rss_bytes = std::max(parent.peak_rss_bytes, peak_rss());
+            }
+            reset_peak_rss();
+            m_records.push_back({name, (uint64_t) m_open.size(), 0, 0, 0, 0});
+            m_open.push_back(m_records.size() - 1);
+            return m_records.size() - 1;
+        }
+
+        void
+        close(uint64_t idx, double wall, double cpu, uint64_t written) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            record_type& r = m_records[idx];
+            r.wall_seconds = wall;
+            r.cpu_seconds = cpu;
+            r.bytes_written = written;
+            r.peak_rss_bytes = std::max(r.peak_rss_bytes, peak_rss());
+            m_open.erase(std::find(m_open.begin(), m_open.end(), idx));
+            if (!m_open.empty()) {
+                record_type& parent = m_records[m_open.back()];
+                parent.peak_rss_bytes = std::max(parent.peak_rss_bytes, r.peak_rss_bytes);
+            }
+        }
+
+        static void
+        write_string(std::ostream& out, const std::string& s) {
+            out << '"';
+            for (char c : s) {
+                if (c == '"' or c == '\\')
+                    out << '\\';
+                out << c;
+            }
+            out << '"';
+        }
+
+    public:
+        //! The report shared by all the construction code.
+        static construction_report&
+        instance() {
+            static construction_report report;
+            return report;
+        }
+
+        void
+        enable(bool enabled = true) {
+            m_enabled = enabled;
+        }
+
+        bool
+        enabled() const {
+            return m_enabled;
+        }
+
+        //! Removes all the records.
+        void
+        clear() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_records.clear();
+            m_open.clear();
+        }
+
+        //! The phases recorded, in the order they were opened.
+        const std::vector<record_type>&
+        records() const {
+            return m_records;
+        }
+
+        //! Writes the report as a JSON object. Each entry of `info` is added as a string field.
+        void
+        write_json(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& info = {}) const {
+            out << "{\n";
+            for (auto& field : info) {
+                out << "  ";
+                write_string(out, field.first);
+                out << ": ";
+                write_string(out, field.second);
+                out << ",\n";
+            }
+            out << "  \"phases\": [";
+            for (size_t i = 0; i < m_records.size(); ++i) {
+                const record_type& r = m_records[i];
+                out << (i ? ",\n" : "\n") << "    {\"name\": ";
+                write_string(out, r.name);
+                out << ", \"depth\": " << r.depth
+                    << ", \"wall_seconds\": " << r.wall_seconds
+                    << ", \"cpu_seconds\": " << r.cpu_seconds
+                    << ", \"peak_rss_bytes\": " << r.peak_rss_bytes
+                    << ", \"bytes_written\": " << r.bytes_written << "}";
+            }
+            out << "\n  ]\n}\n";
+        }
+    };
+
+}
+
+#endif //CST_CN_CONSTRUCTION_REPORT_H
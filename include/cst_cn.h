@@ -23,20 +23,73 @@ along with this program.  If not, see http://www.gnu.org/licenses/ .
 #include <sdsl/int_vector.hpp>
 #include <sdsl/lcp.hpp>
 #include <sdsl/csa_wt.hpp> // for std initialization of cst_sct3
+#include <sdsl/csa_sada.hpp>
 #include <sdsl/cst_iterators.hpp>
 #include <sdsl/util.hpp>
 #include <sdsl/sdsl_concepts.hpp>
 #include <sdsl/construct.hpp>
 #include <sdsl/suffix_tree_helper.hpp>
 #include <sdsl/suffix_tree_algorithm.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <algorithm>
+#include <type_traits>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <string>
 
 #include "./npr.h"
+#include "./top_tree.h"
+#include "./construction_report.h"
+#include "./sectioned_file.h"
 
 
 using namespace sdsl;
 
 namespace cstds {  //compressed suffix tree data structure
 
+    //! Name of a CSA of sdsl in a format_tag: its family, its sample densities and the width
+    //! of its alphabet. The other class parameters (e.g. the wavelet tree of csa_wt) are not
+    //! part of it, since the programs only use their defaults.
+    inline std::string
+    csa_format_tag(const std::string& family, uint32_t dens, uint32_t inv_dens, uint32_t width) {
+        return family + "<" + std::to_string(dens) + "," + std::to_string(inv_dens) + "," + std::to_string(width) + ">";
+    }
+
+    template<class t_wt, uint32_t t_dens, uint32_t t_inv_dens, class t_sa, class t_isa, class t_alphabet>
+    struct format_tag<csa_wt<t_wt, t_dens, t_inv_dens, t_sa, t_isa, t_alphabet> > {
+        static std::string
+        name() {
+            typedef csa_wt<t_wt, t_dens, t_inv_dens, t_sa, t_isa, t_alphabet> csa_type;
+            return csa_format_tag("csa_wt", t_dens, t_inv_dens, csa_type::alphabet_category::WIDTH);
+        }
+    };
+
+    template<class t_enc_vec, uint32_t t_dens, uint32_t t_inv_dens, class t_sa, class t_isa, class t_alphabet>
+    struct format_tag<csa_sada<t_enc_vec, t_dens, t_inv_dens, t_sa, t_isa, t_alphabet> > {
+        static std::string
+        name() {
+            typedef csa_sada<t_enc_vec, t_dens, t_inv_dens, t_sa, t_isa, t_alphabet> csa_type;
+            return csa_format_tag("csa_sada", t_dens, t_inv_dens, csa_type::alphabet_category::WIDTH);
+        }
+    };
+
+    template<uint8_t t_b, class t_rank>
+    struct format_tag<lcp_dac<t_b, t_rank> > {
+        static std::string
+        name() {
+            return "lcp_dac<" + std::to_string(t_b) + ">";
+        }
+    };
+
+    template<class t_bitvec, class t_select>
+    struct format_tag<lcp_support_sada<t_bitvec, t_select> > {
+        static std::string
+        name() {
+            return "lcp_support_sada";
+        }
+    };
+
 
     //! A class for the Compressed Suffix Tree (CST-CN) proposed by Canovas and Navarro
     /*!
@@ -46,6 +99,17 @@ namespace cstds {  //compressed suffix tree data structure
     *                      `lcp`, default class is sdsl::lcp_dac).
     * \tparam t_npr        Type of NSV/PSV/RMQ support data structure used (default
     *                      class is cdsds::npr_support_cn<t_lcp>).
+    * \tparam t_size       Type of the positions of cst_cn and its NPR: node intervals,
+    *                      leaves, depths and the results of the queries. uint32_t halves
+    *                      the size of nodes for texts of less than 2^32-1 symbols (see
+    *                      max_size). The files are the same for every t_size.
+    *
+    * Optionally, the nodes near the root can be materialized with build_top_tree().
+    * Then parent, depth, degree, select_child and child are answered from the top
+    * tree for the nodes stored in it.
+    *
+    * The const methods do not modify any shared state, so one cst_cn can be queried
+    * concurrently by several threads as long as no thread modifies it (see query_engine.h).
     * \par Reference
     *  Canovas, Rodrigo and Navarro, Gonzalo:
     *  Practical Compressed Suffix Trees.
@@ -57,12 +121,14 @@ namespace cstds {  //compressed suffix tree data structure
             class t_lcp = lcp_dac<>,
             class t_npr = npr_support_cn,
             uint8_t bs = 32,
-            uint8_t sbs = 8>
+            uint8_t sbs = 8,
+            class t_size = typename t_csa::size_type>
     class cst_cn {
+        static_assert(std::is_unsigned<t_size>::value, "t_size must be an unsigned integer type");
 
     public:
         typedef cst_dfs_const_forward_iterator<cst_cn>              const_iterator;
-        typedef typename t_csa::size_type                           size_type;
+        typedef t_size                                              size_type;
         typedef t_csa                                               csa_type;
         typedef typename t_lcp::template type<cst_cn>               lcp_type;
         typedef typename t_npr::template type<cst_cn, bs, sbs>      npr_type;
@@ -74,16 +140,25 @@ namespace cstds {  //compressed suffix tree data structure
         typedef typename t_csa::alphabet_type::comp_char_type       comp_char_type;
 
         typedef cst_tag                                             index_category;
+        typedef top_tree<size_type, char_type>                      top_tree_type;
 
     private:
         csa_type m_csa;
         lcp_type m_lcp;
         npr_type m_npr;
+        top_tree_type m_top; //not serialized, see build_top_tree
+        size_type m_size = 0; //not serialized, taken from the CSA or the LCP when they are loaded
+
+        //! The LCP of lcp_support_sada is read through the CSA, so it cannot tell the size
+        // before the CSA is loaded.
+        static constexpr bool lcp_through_csa = !std::is_same<typename lcp_type::lcp_category,
+                                                              sdsl::lcp_plain_tag>::value;
 
     public:
         const csa_type& csa = m_csa;
         const lcp_type& lcp = m_lcp;
         const npr_type& npr = m_npr;
+        const top_tree_type& top = m_top;
 
         //! Default constructor
         cst_cn() {}
@@ -98,14 +173,21 @@ namespace cstds {  //compressed suffix tree data structure
             *this = std::move(cst);
         }
 
-        //! Construct CST from cache config
-        cst_cn(cache_config& config) {
+        //! Construct CST from cache config. The NPR is built using up to `threads` threads.
+        //! With stream_lcp the NPR reads the plain LCP array of the cache sequentially from
+        //! disk instead of accessing the compressed one. npr_args are given to the constructor
+        //! of the NPR after the number of threads (e.g. the block size of npr_support_cn_dyn).
+        template<class... t_npr_args>
+        cst_cn(cache_config& config, size_type threads = 1, bool stream_lcp = false, t_npr_args... npr_args) {
             {
                 auto event = memory_monitor::event("load csa");
+                construction_report::phase phase("load csa");
                 load_from_cache(m_csa, std::string(conf::KEY_CSA) + "_" + util::class_to_hash(m_csa), config);
+                m_size = m_csa.size();
             }
             {
                 auto event = memory_monitor::event("load lcp");
+                construction_report::phase phase("load lcp");
                 cache_config tmp_config(false, config.dir, config.id, config.file_map);
                 construct_lcp(m_lcp, *this, tmp_config);
                 config.file_map = tmp_config.file_map;
@@ -114,11 +196,53 @@ namespace cstds {  //compressed suffix tree data structure
             }
             {
                 auto event = memory_monitor::event("construct NPR");
-                m_npr = npr_type(&m_lcp);
+                construction_report::phase phase("construct NPR");
+                if (stream_lcp and cache_file_exists(conf::KEY_LCP, config))
+                    m_npr = npr_type(&m_lcp, cache_file_name(conf::KEY_LCP, config), threads, npr_args...);
+                else
+                    m_npr = npr_type(&m_lcp, threads, npr_args...);
                 std::cout << "npr created" << std::endl;
             }
         }
 
+        //! Construct CST from another CST of sdsl (e.g. cst_sct3 or cst_sada) with the same CSA.
+        /*!
+        * The CSA is copied and, when both use the same LCP type, also the LCP. Otherwise the
+        * plain LCP array (and the ISA, for an LCP in text order) is written to the cache and
+        * the LCP of cst_cn is built from it. Only the NPR is computed from scratch.
+        */
+        template<class t_cst, class... t_npr_args>
+        cst_cn(const t_cst& cst, cache_config& config, size_type threads = 1, t_npr_args... npr_args) {
+            static_assert(std::is_same<typename t_cst::csa_type, csa_type>::value,
+                          "the CSA of both CSTs must be of the same type");
+            {
+                auto event = memory_monitor::event("copy csa");
+                construction_report::phase phase("copy csa");
+                m_csa = cst.csa;
+                m_size = m_csa.size();
+            }
+            {
+                auto event = memory_monitor::event("copy lcp");
+                construction_report::phase phase("copy lcp");
+                copy_lcp_from(cst.lcp, config, std::is_same<typename t_cst::lcp_type, lcp_type>());
+                typename lcp_type::lcp_category tag;
+                assign_to_lcp(tag);
+            }
+            {
+                auto event = memory_monitor::event("construct NPR");
+                construction_report::phase phase("construct NPR");
+                m_npr = npr_type(&m_lcp, threads, npr_args...);
+            }
+        }
+
+        //! Replaces the NPR by a new one built over the same LCP with npr_args, which are
+        //! the arguments of the NPR constructor after the LCP (e.g. threads, block size).
+        template<class... t_npr_args>
+        void
+        build_npr(t_npr_args... npr_args) {
+            m_npr = npr_type(&m_lcp, npr_args...);
+        }
+
         //! Swap method for cst_cn
         void
         swap(cst_cn& cst) {
@@ -126,6 +250,8 @@ namespace cstds {  //compressed suffix tree data structure
                 m_csa.swap(cst.m_csa);
                 swap_lcp(m_lcp, cst.m_lcp, *this, cst);
                 swap_npr(m_npr, cst.m_npr, *this, cst);
+                m_top.swap(cst.m_top);
+                std::swap(m_size, cst.m_size);
             }
         }
 
@@ -142,15 +268,17 @@ namespace cstds {  //compressed suffix tree data structure
                 m_csa = std::move(cst.m_csa);
                 move_lcp(m_lcp, cst.m_lcp, *this);
                 move_npr(m_npr, cst.m_npr, *this);
+                m_top = std::move(cst.m_top);
+                m_size = cst.m_size;
             }
             return *this;
         }
 
         //! Serialize to a stream.
-        size_type
+        uint64_t
         serialize(std::ostream& out, structure_tree_node* v=nullptr, std::string name="") const {
             structure_tree_node* child = structure_tree::add_child(v, name, util::class_name(*this));
-            size_type written_bytes = 0, csa_size = 0, lcp_size = 0, npr_size = 0;
+            uint64_t written_bytes = 0, csa_size = 0, lcp_size = 0, npr_size = 0;
             csa_size += m_csa.serialize(out, child, "csa");
             lcp_size += m_lcp.serialize(out, child, "lcp");
             npr_size += m_npr.serialize(out, child, "npr");
@@ -167,28 +295,115 @@ namespace cstds {  //compressed suffix tree data structure
         load(std::istream& in) {
             size_type n_levels;
             m_csa.load(in);
+            m_size = m_csa.size();
             load_lcp(m_lcp, in, *this);
             typename lcp_type::lcp_category tag;
             assign_to_lcp(tag); //just in case that the assigning of the lcp does not work
             m_npr.load(in, &m_lcp);
         }
 
+        //! Type stored in the header of a sectioned file: the names of the CSA, the LCP and
+        // the NPR (see format_tag) and the block sizes. It is the same for every t_size,
+        // since they write the same files.
+        static std::string
+        format_type() {
+            return "cst_cn<" + format_tag<t_csa>::name() + "," + format_tag<t_lcp>::name() + "," +
+                   format_tag<t_npr>::name() + "," + std::to_string(bs) + "," + std::to_string(sbs) + ">";
+        }
+
+        //! Serializes the CSA, the LCP and the NPR as the sections of a sectioned file (see
+        // section_writer), so they can be loaded at the same time. options are stored in its
+        // header (e.g. the options of createCST). out must be seekable.
+        uint64_t
+        serialize_sectioned(std::ostream& out, const std::string& options = "") const {
+            section_writer sections(out, 3, format_type(), options);
+            m_csa.serialize(sections.next());
+            m_lcp.serialize(sections.next());
+            m_npr.serialize(sections.next());
+            return sections.close();
+        }
+
+        //! Loads a file written by serialize_sectioned. With threads > 1 the CSA, the LCP and
+        // the NPR are read and deserialized at the same time, each one by its own thread and
+        // stream. Returns false, before reading any section, if file is not a sectioned file
+        // of this type, and false if a section could not be read.
+        bool
+        load_sectioned(const std::string& file, size_type threads = 3) {
+            section_header header;
+            if (!read_section_header(file, format_type(), 3, header))
+                return false;
+            const std::vector<uint64_t>& offset = header.offset;
+            const std::vector<uint64_t>& size = header.size;
+            bool ok[3] = {false, false, false};
+            auto read_section = [&](size_type k) {
+                std::ifstream in(file, std::ios::in | std::ios::binary);
+                in.seekg(offset[k]);
+                load_section(k, in);
+                ok[k] = in and (uint64_t) in.tellg() == offset[k] + size[k];
+            };
+            std::vector<std::thread> pool;
+            for (size_type k = 1; k < 3; ++k) {
+                if (threads > k)
+                    pool.emplace_back(read_section, k);
+                else
+                    read_section(k);
+            }
+            read_section(0);
+            for (auto& th : pool)
+                th.join();
+            return ok[0] and ok[1] and ok[2];
+        }
+
+        //! Loads from in, placed at the start of the section, the component k (0 = CSA,
+        // 1 = LCP, 2 = NPR) of a file written by serialize_sectioned. The others do not need
+        // to be loaded, since the LCP and the NPR only keep pointers to the CSA and the LCP.
+        // The size is set by the LCP section, or by the CSA one when the LCP is read through
+        // the CSA, so each member is only written by the section that owns it.
+        void
+        load_section(size_type k, std::istream& in) {
+            if (k == 0) {
+                m_csa.load(in);
+                if (lcp_through_csa)
+                    m_size = m_csa.size();
+            } else if (k == 1) {
+                load_lcp(m_lcp, in, *this);
+                typename lcp_type::lcp_category tag;
+                assign_to_lcp(tag);
+                if (!lcp_through_csa)
+                    m_size = m_lcp.size();
+            } else {
+                m_npr.load(in, &m_lcp);
+            }
+        }
+
+        //! Materializes all the nodes with at least `threshold` leaves (0 removes the top tree).
+        // The top tree is not serialized, so it has to be built again after load.
+        void
+        build_top_tree(size_type threshold) {
+            m_top = top_tree_type();
+            if (threshold > 0)
+                m_top = top_tree_type(*this, threshold);
+        }
+
         //! Number of leaves of the suffix tree.
+        // It is stored apart from the CSA, so it can be read while the CSA is being loaded
+        // by another thread (see lazy_cst_cn).
         size_type
         size() const {
-            return m_csa.size();
+            return m_size;
         }
 
-        //! Returns the largest size that cst_cn can ever have.
+        //! Returns the largest size that cst_cn can ever have. The size n itself is a
+        // position (e.g. the result of psv when there is none), so it must fit in size_type.
         static size_type
         max_size() {
-            return t_csa::max_size();
+            return (size_type) std::min<uint64_t>(t_csa::max_size(), std::numeric_limits<size_type>::max());
         }
 
         //! Returns if the data structure is empty.
         bool
         empty() const {
-            return m_csa.empty();
+            return m_size == 0;
         }
 
         //! Returns a const_iterator to the first element of a depth first traversal of the tree.
@@ -229,7 +444,7 @@ namespace cstds {  //compressed suffix tree data structure
         //! Returns the root of the suffix tree.
         node_type
         root() const {
-            return node_type(0, m_csa.size() - 1);
+            return node_type(0, size() - 1);
         }
 
         //! Returns true iff node v is a leaf.
@@ -241,7 +456,7 @@ namespace cstds {  //compressed suffix tree data structure
         //! Return the i-th leaf (1-based from left to right) of the suffix tree.
         node_type
         select_leaf(size_type i) const {
-            assert(i > 0 and i <= m_csa.size());
+            assert(i > 0 and i <= size());
             return node_type(i - 1, i - 1);
         }
 
@@ -278,7 +493,9 @@ namespace cstds {  //compressed suffix tree data structure
         //! Calculate the parent node of a node v.
         node_type
         parent(const node_type& v) const {
-            size_type lcp_p_pos;
+            size_type lcp_p_pos, t = m_top.find(v);
+            if (t != m_top.size())
+                return m_top.parent(t);
             //get the lcp value that represent the node
             if (v.second == m_lcp.size() - 1 or m_lcp[v.first] > m_lcp[v.second + 1])
                 lcp_p_pos = v.first;
@@ -314,6 +531,9 @@ namespace cstds {  //compressed suffix tree data structure
             assert(i > 0);
             if (is_leaf(v))   //no child
                 return root();
+            size_type t = m_top.find(v);
+            if (t != m_top.size())
+                return m_top.select_child(t, i);
             size_type lcp_value, left_margin, aux_lcp;
             size_type left, right;
             //every internal node of the tree must have at least two children
@@ -340,6 +560,9 @@ namespace cstds {  //compressed suffix tree data structure
             size_type count = 0;
             if (is_leaf(v))  // if v is a leave, v has no child
                 return 0;
+            size_type t = m_top.find(v);
+            if (t != m_top.size())
+                return m_top.degree(t);
             size_type lcp_value, left_margin, aux_lcp;
             size_type left, right;
             left_margin = m_npr.rmq(v.first + 1, v.second, lcp_value);
@@ -363,6 +586,44 @@ namespace cstds {  //compressed suffix tree data structure
         //! Get the child w of node v which edge label (v,w) starts with character c.
         node_type
         child(const node_type& v, const char_type c, size_type& char_pos) const {
+            return child(v, c, char_pos, alphabet_category());
+        }
+
+    private:
+        //! Child over an integer alphabet. v can have millions of children, so instead of
+        //  listing them the leaves of v are binary searched by their symbol at depth(v).
+        node_type
+        child(const node_type& v, const char_type c, size_type& char_pos, int_alphabet_tag) const {
+            if (is_leaf(v))
+                return root();
+            comp_char_type cc = m_csa.char2comp[c];
+            if ((cc==0 and c!=0) or cc >= m_csa.sigma) //a contiguous alphabet maps c to itself
+                return root();
+            size_type char_ex_max_pos = m_csa.C[((size_type)1)+cc];
+            size_type char_inc_min_pos = m_csa.C[cc];
+            size_type d = depth(v), aux_lcp;
+            //first leaf of v whose symbol at depth d is >= c
+            size_type l_bound = v.first, r_bound = v.second + 1, mid;
+            while (l_bound < r_bound) {
+                mid = (l_bound + r_bound) >> 1;
+                if (get_char_pos(mid, d, m_csa) < char_inc_min_pos)
+                    l_bound = mid + 1;
+                else
+                    r_bound = mid;
+            }
+            if (l_bound > v.second)
+                return root();
+            char_pos = get_char_pos(l_bound, d, m_csa);
+            if (char_pos >= char_ex_max_pos)
+                return root();
+            if (l_bound == v.second) //the child is a leaf
+                return node_type(l_bound, l_bound);
+            return node_type(l_bound, m_npr.fwd_nsv(l_bound + 1, d + 1, aux_lcp) - 1);
+        }
+
+        //! Child over a byte alphabet: checks the first and last children and binary searches the rest.
+        node_type
+        child(const node_type& v, const char_type c, size_type& char_pos, byte_alphabet_tag) const {
             if (is_leaf(v))  // if v is a leaf, v has no child
                 return root();
             //check firs if the letter is a valid letter using the csa
@@ -421,11 +682,14 @@ namespace cstds {  //compressed suffix tree data structure
             return root(); // not found
         }
 
-
+    public:
 
         //! Get the child w of node v which edge label (v,w) starts with character c.
         node_type
         child(const node_type& v, const char_type c) const {
+            size_type t = m_top.find(v);
+            if (t != m_top.size())
+                return m_top.child(t, c);
             size_type char_pos;
             return child(v, c, char_pos);
         }
@@ -471,6 +735,9 @@ namespace cstds {  //compressed suffix tree data structure
             else if (v == root()) {
                 return 0;
             }
+            else if ((k = m_top.find(v)) != m_top.size()) {
+                return m_top.depth(k);
+            }
             else {
                 k = npr.rmq(v.first + 1, v.second, val);
                 return val;
@@ -512,8 +779,7 @@ namespace cstds {  //compressed suffix tree data structure
         //! Computes the Weiner link of node v and character c.
         node_type
         wl(const node_type& v, const char_type c) const {
-            size_type l, r;
-            std::tie(l, r) = v;
+            typename t_csa::size_type l = v.first, r = v.second;
             if (l == r) // no WL
                 return root();
             sdsl::backward_search(m_csa, l, r, c, l, r);
@@ -628,6 +894,8 @@ namespace cstds {  //compressed suffix tree data structure
             m_csa = cst.m_csa;
             copy_lcp(m_lcp, cst.m_lcp, *this);
             copy_npr(m_npr, cst.m_npr, *this);
+            m_top = cst.m_top;
+            m_size = cst.m_size;
         }
 
         node_type
@@ -650,6 +918,45 @@ namespace cstds {  //compressed suffix tree data structure
             return ch;
         }
 
+        template<class t_src_lcp>
+        void
+        copy_lcp_from(const t_src_lcp& lcp, cache_config&, std::true_type) {
+            m_lcp = lcp;
+        }
+
+        template<class t_src_lcp>
+        void
+        copy_lcp_from(const t_src_lcp& lcp, cache_config& config, std::false_type) {
+            {
+                int_vector_buffer<> lcp_buf(cache_file_name(conf::KEY_LCP, config), std::ios::out);
+                for (size_type i = 0; i < lcp.size(); ++i)
+                    lcp_buf.push_back(lcp[i]);
+            }
+            register_cache_file(conf::KEY_LCP, config);
+            typename lcp_type::lcp_category tag;
+            store_isa(tag, config);
+            cache_config tmp_config(false, config.dir, config.id, config.file_map);
+            construct_lcp(m_lcp, *this, tmp_config);
+            config.file_map = tmp_config.file_map;
+        }
+
+        template<class t_tag>
+        void store_isa(t_tag, cache_config&) {}
+
+        //! An LCP in text order is built from the ISA, which is written following psi.
+        void
+        store_isa(lcp_permuted_tag, cache_config& config) {
+            if (!cache_file_exists(conf::KEY_ISA, config)) {
+                int_vector_buffer<> isa_buf(cache_file_name(conf::KEY_ISA, config), std::ios::out);
+                size_type i = m_csa.isa[0];
+                for (size_type k = 0; k < m_csa.size(); ++k) {
+                    isa_buf.push_back(i);
+                    i = m_csa.psi[i];
+                }
+            }
+            register_cache_file(conf::KEY_ISA, config);
+        }
+
         void assign_to_lcp(lcp_plain_tag) {}
         void assign_to_lcp(lcp_permuted_tag) { m_lcp.set_csa(&(csa));}
         void assign_to_lcp(lcp_tree_compressed_tag) { m_lcp.set_cst(*this);}
@@ -657,6 +964,16 @@ namespace cstds {  //compressed suffix tree data structure
 
     };
 
+    //! The type of cst_cn t_cst with positions of type t_size (see cst_cn). Both types load
+    //! the same files.
+    template<class t_cst, class t_size>
+    struct cst_cn_with_size;
+
+    template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_old_size, class t_size>
+    struct cst_cn_with_size<cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_old_size>, t_size> {
+        typedef cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size> type;
+    };
+
 }
 
 #endif //CST_CN_HPP
@@ -0,0 +1,186 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file cst_node_cache.h
+    \brief cst_node_cache.h contains a small direct-mapped cache of node results for a CST.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_NODE_CACHE_H
+#define CST_CN_NODE_CACHE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace cstds {
+
+    //! A wrapper of a CST that memoizes depth and parent of the nodes queried, and lca of
+    //! the pairs of nodes queried.
+    /*!
+    * The caches are direct-mapped with 2^t_bits entries keyed by the interval (lb, rb) of
+    * the node, or the intervals of both nodes for lca, so a new key simply replaces the one
+    * stored in its slot. The wrapper is
+    * not thread-safe: each thread creates its own wrapper over the shared CST, which
+    * needs no locking since the CST is only read.
+    * \tparam t_cst   Type of the CST (cst_cn or any sdsl CST).
+    * \tparam t_bits  Logarithm of the number of entries of the cache.
+    */
+    template<class t_cst, uint8_t t_bits = 12>
+    class cst_node_cache {
+        static_assert(t_bits > 0 and t_bits < 32, "t_bits must be in [1,31]");
+
+    public:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+
+        //! Hit and miss counters of the cache.
+        struct stats_type {
+            size_type depth_hits = 0;
+            size_type depth_misses = 0;
+            size_type parent_hits = 0;
+            size_type parent_misses = 0;
+            size_type lca_hits = 0;
+            size_type lca_misses = 0;
+        };
+
+    private:
+        struct entry {
+            node_type key;
+            node_type parent;
+            size_type depth;
+            bool has_parent;
+            bool has_depth;
+        };
+
+        struct lca_entry {
+            node_type v;
+            node_type w;
+            node_type lca;
+        };
+
+        const t_cst* m_cst;
+        std::vector<entry> m_entries;
+        std::vector<lca_entry> m_lca_entries;
+        stats_type m_stats;
+
+        static uint64_t
+        hash(const node_type& v) {
+            return ((uint64_t) v.first * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t) v.second * 0xC2B2AE3D27D4EB4FULL);
+        }
+
+        entry&
+        slot(const node_type& v) {
+            entry& e = m_entries[hash(v) >> (64 - t_bits)];
+            if (e.key != v) {
+                e.key = v;
+                e.has_parent = e.has_depth = false;
+            }
+            return e;
+        }
+
+    public:
+
+        //! Constructor
+        cst_node_cache(const t_cst& cst) : m_cst(&cst), m_entries((size_type)1 << t_bits),
+                                           m_lca_entries((size_type)1 << t_bits) {
+            clear();
+        }
+
+        //! The CST being cached.
+        const t_cst&
+        cst() const {
+            return *m_cst;
+        }
+
+        //! Removes all the entries and resets the counters.
+        void
+        clear() {
+            entry empty;
+            empty.key = node_type(1, 0); //not a valid node
+            empty.has_parent = empty.has_depth = false;
+            std::fill(m_entries.begin(), m_entries.end(), empty);
+            lca_entry empty_lca;
+            empty_lca.v = empty_lca.w = empty_lca.lca = empty.key;
+            std::fill(m_lca_entries.begin(), m_lca_entries.end(), empty_lca);
+            m_stats = stats_type();
+        }
+
+        //! Hit and miss counters since the last clear.
+        const stats_type&
+        stats() const {
+            return m_stats;
+        }
+
+        //! Returns the string depth of node v.
+        size_type
+        depth(const node_type& v) {
+            entry& e = slot(v);
+            if (e.has_depth) {
+                ++m_stats.depth_hits;
+                return e.depth;
+            }
+            ++m_stats.depth_misses;
+            e.depth = m_cst->depth(v);
+            e.has_depth = true;
+            return e.depth;
+        }
+
+        //! Calculate the parent node of a node v.
+        node_type
+        parent(const node_type& v) {
+            entry& e = slot(v);
+            if (e.has_parent) {
+                ++m_stats.parent_hits;
+                return e.parent;
+            }
+            ++m_stats.parent_misses;
+            e.parent = m_cst->parent(v);
+            e.has_parent = true;
+            return e.parent;
+        }
+
+        //! Calculate the lowest common ancestor of nodes v and w.
+        node_type
+        lca(const node_type& v, const node_type& w) {
+            uint64_t h = hash(v) ^ (hash(w) * 0xFF51AFD7ED558CCDULL);
+            lca_entry& e = m_lca_entries[h >> (64 - t_bits)];
+            if (e.v == v and e.w == w) {
+                ++m_stats.lca_hits;
+                return e.lca;
+            }
+            ++m_stats.lca_misses;
+            e.v = v;
+            e.w = w;
+            e.lca = m_cst->lca(v, w);
+            return e.lca;
+        }
+
+        //! Returns the node depth of node v, using the cached parents.
+        size_type
+        node_depth(node_type v) {
+            size_type d = 0;
+            node_type root = m_cst->root();
+            while (v != root) {
+                ++d;
+                v = parent(v);
+            }
+            return d;
+        }
+
+    }; //end class
+
+}
+
+#endif //CST_CN_NODE_CACHE_H
@@ -0,0 +1,108 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file forked_workers.h
+    \brief forked_workers.h contains the hosting of one loaded index by several worker processes.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_FORKED_WORKERS_H
+#define CST_CN_FORKED_WORKERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace cstds {
+
+    //! Runs work(w) in `workers` child processes, w in [0, workers), and waits for them.
+    /*!
+    * The index has to be loaded by the calling process before: each worker is forked from
+    * it, so all of them share the pages of the index with the loader (copy on write, and a
+    * cst_cn is never written by the queries) and no worker loads or copies it again. The
+    * exit code of a worker is the value returned by work. A worker killed by a signal (e.g.
+    * a crash) is forked again from the loader up to max_restarts times in total, so one
+    * failing worker does not affect the others. Returns true if every worker returned 0.
+    */
+    template<class t_work>
+    bool
+    run_forked_workers(uint64_t workers, t_work work, uint64_t max_restarts = 0) {
+        std::map<pid_t, uint64_t> running;
+        auto start = [&](uint64_t w) -> bool {
+            std::cout.flush(); //the buffers are copied to the child
+            std::cerr.flush();
+            fflush(nullptr);
+            pid_t pid = fork();
+            if (pid < 0)
+                return false;
+            if (pid == 0) {
+                int code = work(w);
+                std::cout.flush();
+                std::cerr.flush();
+                _exit(code);
+            }
+            running[pid] = w;
+            return true;
+        };
+        bool ok = true;
+        for (uint64_t w = 0; w < workers; ++w)
+            ok = start(w) and ok;
+        while (!running.empty()) {
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0)
+                break;
+            auto it = running.find(pid);
+            if (it == running.end())
+                continue;
+            uint64_t w = it->second;
+            running.erase(it);
+            if (WIFSIGNALED(status) and max_restarts > 0) {
+                --max_restarts;
+                std::cerr << "Worker " << w << " was killed by signal " << WTERMSIG(status) << ", restarting it"
+                          << std::endl;
+                ok = start(w) and ok;
+            } else if (!WIFEXITED(status) or WEXITSTATUS(status) != 0) {
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    //! Bytes of memory written by this process since it was forked (Private_Dirty of
+    //! /proc/self/smaps_rollup), that is, the pages it does not share. 0 if it is not available.
+    inline uint64_t
+    private_dirty_bytes() {
+        std::ifstream in("/proc/self/smaps_rollup");
+        std::string key;
+        uint64_t kb = 0;
+        while (in >> key) {
+            if (key == "Private_Dirty:") {
+                in >> kb;
+                return kb * 1024;
+            }
+            in.ignore(1 << 10, '\n');
+        }
+        return 0;
+    }
+
+}
+
+#endif //CST_CN_FORKED_WORKERS_H
@@ -0,0 +1,289 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file huge_pages.h
+    \brief huge_pages.h contains the placement of the arrays of a loaded index in huge pages and a counter of dTLB misses.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_HUGE_PAGES_H
+#define CST_CN_HUGE_PAGES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+namespace cstds {
+
+    //! Pages used by the arrays of an index, chosen before it is loaded.
+    enum huge_page_mode : uint8_t {
+        hp_none = 0,        //!< pages of the base size
+        hp_transparent = 1, //!< transparent huge pages (2 MB), requested with madvise after the load
+        hp_explicit = 2     //!< huge pages of the hugetlb pool (2 MB or 1 GB, its default size), moved to after the load
+    };
+
+    const uint64_t HUGE_PAGE_SIZE = 1ULL << 21;
+
+    typedef std::vector<std::pair<uint64_t, uint64_t> > memory_ranges; //[begin, end) in address order
+
+    //! Stream buffer that discards the bytes written to it but records the ranges of memory
+    //! they are written from. An int_vector (and int_vector_view) writes its words straight
+    //! from its data, so serializing an index through it gives the ranges of its arrays.
+    class array_range_recorder : public std::streambuf {
+    private:
+        memory_ranges m_ranges;
+
+    protected:
+        std::streamsize
+        xsputn(const char* s, std::streamsize n) override {
+            uint64_t begin = (uint64_t) s, end = begin + n;
+            if (!m_ranges.empty() and m_ranges.back().second == begin) //next block of the same array
+                m_ranges.back().second = end;
+            else if (n > 0)
+                m_ranges.emplace_back(begin, end);
+            return n;
+        }
+
+        int_type
+        overflow(int_type c) override {
+            return traits_type::not_eof(c);
+        }
+
+    public:
+        //! Ranges recorded, sorted and merged.
+        memory_ranges
+        ranges() const {
+            memory_ranges r = m_ranges, merged;
+            std::sort(r.begin(), r.end());
+            for (auto& x : r) {
+                if (!merged.empty() and x.first <= merged.back().second)
+                    merged.back().second = std::max(merged.back().second, x.second);
+                else
+                    merged.push_back(x);
+            }
+            return merged;
+        }
+    };
+
+    //! Ranges of memory that hold the arrays of idx (for cst_cn, the int_vectors of the CSA,
+    //! the LCP and the NPR), found by serializing it through an array_range_recorder.
+    template<class t_index>
+    memory_ranges
+    array_ranges(const t_index& idx) {
+        array_range_recorder rec;
+        std::ostream out(&rec);
+        idx.serialize(out);
+        return rec.ranges();
+    }
+
+    //! Anonymous read-write mappings of the process (the heap included), where malloc places
+    //! the arrays. The mappings of files (e.g. a mapped index) are left out.
+    inline memory_ranges
+    anonymous_mappings() {
+        std::ifstream maps("/proc/self/maps");
+        std::string line;
+        memory_ranges ranges;
+        while (std::getline(maps, line)) {
+            std::istringstream in(line);
+            std::string range, perms, offset, dev, inode, path;
+            in >> range >> perms >> offset >> dev >> inode >> path;
+            if (perms.compare(0, 2, "rw") != 0 or inode != "0" or (!path.empty() and path != "[heap]"))
+                continue;
+            uint64_t begin = std::stoull(range.substr(0, range.find('-')), nullptr, 16);
+            uint64_t end = std::stoull(range.substr(range.find('-') + 1), nullptr, 16);
+            ranges.emplace_back(begin, end);
+        }
+        return ranges;
+    }
+
+    //! The whole pages of page_size inside the arrays of idx that lie in anonymous memory.
+    template<class t_index>
+    memory_ranges
+    array_pages(const t_index& idx, uint64_t page_size) {
+        memory_ranges arrays = array_ranges(idx), anon = anonymous_mappings(), pages;
+        uint64_t k = 0;
+        for (auto& a : arrays) {
+            while (k < anon.size() and anon[k].second <= a.first)
+                ++k;
+            for (uint64_t j = k; j < anon.size() and anon[j].first < a.second; ++j) {
+                uint64_t begin = std::max(a.first, anon[j].first), end = std::min(a.second, anon[j].second);
+                begin = (begin + page_size - 1) & ~(page_size - 1);
+                end &= ~(page_size - 1);
+                if (begin < end)
+                    pages.emplace_back(begin, end);
+            }
+        }
+        return pages;
+    }
+
+    //! Asks for transparent huge pages (MADV_HUGEPAGE) in the arrays of idx and collapses
+    //! them right away (MADV_COLLAPSE) when the kernel supports it; otherwise khugepaged does
+    //! it in the background. The rest of the memory of the process is not advised. Returns
+    //! the bytes advised.
+    template<class t_index>
+    uint64_t
+    advise_huge_pages(const t_index& idx) {
+        uint64_t bytes = 0;
+        for (auto& r : array_pages(idx, HUGE_PAGE_SIZE)) {
+            if (madvise((void*) r.first, r.second - r.first, MADV_HUGEPAGE) == 0) {
+                madvise((void*) r.first, r.second - r.first, MADV_COLLAPSE);
+                bytes += r.second - r.first;
+            }
+        }
+        return bytes;
+    }
+
+    //! Size and free pages of the default hugetlb pool, read from /proc/meminfo.
+    inline void
+    hugetlb_pool(uint64_t& page_size, uint64_t& free_pages) {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        uint64_t value;
+        page_size = HUGE_PAGE_SIZE;
+        free_pages = 0;
+        while (meminfo >> key >> value) {
+            if (key == "HugePages_Free:")
+                free_pages = value;
+            else if (key == "Hugepagesize:")
+                page_size = value << 10; //in kB
+            meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+    }
+
+    //! Moves the arrays of idx to huge pages of the hugetlb pool: the whole huge pages of each
+    //! array are copied to a hugetlb mapping, which mremap then places at their address. The
+    //! allocations of sdsl and of the rest of the process are not changed. The arrays are
+    //! moved in address order while the pool has free pages. Needs a kernel that can mremap
+    //! hugetlb mappings (5.17 or later). Returns the bytes moved.
+    template<class t_index>
+    uint64_t
+    move_to_hugetlb(const t_index& idx) {
+        uint64_t page_size, free_pages, bytes = 0;
+        hugetlb_pool(page_size, free_pages);
+        for (auto& r : array_pages(idx, page_size)) {
+            uint64_t len = std::min(r.second - r.first, free_pages * page_size); //as many as the pool has
+            if (len == 0)
+                break;
+            void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p == MAP_FAILED)
+                break; //the pool is exhausted
+            memcpy(p, (const void*) r.first, len);
+            if (mremap(p, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, (void*) r.first) == MAP_FAILED) {
+                munmap(p, len);
+                break;
+            }
+            bytes += len;
+            free_pages -= len / page_size;
+        }
+        return bytes;
+    }
+
+    //! Checks, before an index is loaded, that mode can be used: for hp_explicit the hugetlb
+    //! pool must have free pages for at least bytes (0 asks for one page). Returns false if
+    //! the pool is too small.
+    inline bool
+    use_huge_pages(huge_page_mode mode, uint64_t bytes = 0) {
+        if (mode != hp_explicit)
+            return true;
+        uint64_t page_size, free_pages;
+        hugetlb_pool(page_size, free_pages);
+        return free_pages > 0 and free_pages * page_size >= bytes;
+    }
+
+    //! Places the arrays of the loaded index idx in the pages of mode. Returns the bytes
+    //! placed in huge pages.
+    template<class t_index>
+    uint64_t
+    place_in_huge_pages(const t_index& idx, huge_page_mode mode) {
+        if (mode == hp_transparent)
+            return advise_huge_pages(idx);
+        if (mode == hp_explicit)
+            return move_to_hugetlb(idx);
+        return 0;
+    }
+
+    //! Counts the dTLB load misses of the calling thread between start() and stop().
+    class tlb_miss_counter {
+    private:
+        int m_fd = -1;
+
+    public:
+        tlb_miss_counter() {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            m_fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        tlb_miss_counter(const tlb_miss_counter&) = delete;
+        tlb_miss_counter& operator=(const tlb_miss_counter&) = delete;
+
+        ~tlb_miss_counter() {
+            if (m_fd >= 0)
+                close(m_fd);
+        }
+
+        //! Returns false if the counter is not available (e.g. perf_event_paranoid or a VM).
+        bool
+        good() const {
+            return m_fd >= 0;
+        }
+
+        void
+        start() {
+            if (m_fd >= 0) {
+                ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        //! Returns the misses counted since start().
+        uint64_t
+        stop() {
+            uint64_t count = 0;
+            if (m_fd >= 0) {
+                ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+                    count = 0;
+            }
+            return count;
+        }
+    };
+
+}
+
+#endif //CST_CN_HUGE_PAGES_H
@@ -0,0 +1,138 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file int_vector_view.h
+    \brief int_vector_view.h contains a read only view of the values of an sdsl int_vector, in memory or serialized.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_INT_VECTOR_VIEW_H
+#define CST_CN_INT_VECTOR_VIEW_H
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/io.hpp>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace cstds {
+
+    //! Read only view of the values of an int_vector<> that does not own them.
+    /*!
+    * The view reads the words of an int_vector<> in memory, or the words of a serialized
+    * int_vector<> (e.g. in a mapped file), which sdsl writes after a header of 9 bytes and
+    * so are not aligned to 8 bytes. Every word is read with memcpy, which is a plain load on
+    * x86 and ARMv8. The memory must outlive the view.
+    */
+    class int_vector_view {
+    public:
+        typedef uint64_t size_type;
+        typedef uint64_t value_type;
+
+    private:
+        const char* m_data = nullptr; //first word
+        size_type m_size = 0;
+        uint8_t m_width = 64;
+        uint64_t m_mask = ~0ULL;
+
+        void
+        set_width(uint8_t width) {
+            m_width = width;
+            m_mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+        }
+
+    public:
+        int_vector_view() { }
+
+        //! View of the values of v.
+        explicit int_vector_view(const sdsl::int_vector<>& v)
+                : m_data((const char*) v.data()), m_size(v.size()) {
+            set_width(v.width());
+        }
+
+        //! Makes this a view of the int_vector<> serialized at data, which has size bytes.
+        //! Returns the bytes of the serialized int_vector<>, or 0 if it is damaged or does
+        //! not fit in size bytes.
+        uint64_t
+        map(const char* data, uint64_t size) {
+            uint64_t bits = 0;
+            uint8_t width = 0;
+            if (size < sizeof(bits) + sizeof(width))
+                return 0;
+            memcpy(&bits, data, sizeof(bits));
+            memcpy(&width, data + sizeof(bits), sizeof(width));
+            uint64_t header = sizeof(bits) + sizeof(width);
+            uint64_t bytes = ((bits + 63) >> 6) << 3;
+            if (width == 0 or width > 64 or bits % width != 0 or bytes > size - header)
+                return 0;
+            m_data = data + header;
+            m_size = bits / width;
+            set_width(width);
+            return header + bytes;
+        }
+
+        size_type
+        size() const {
+            return m_size;
+        }
+
+        bool
+        empty() const {
+            return m_size == 0;
+        }
+
+        uint8_t
+        width() const {
+            return m_width;
+        }
+
+        //! First word of the values.
+        const char*
+        data() const {
+            return m_data;
+        }
+
+        value_type
+        operator[](size_type i) const {
+            uint64_t bit = i * m_width, offset = bit & 63, x;
+            const char* word = m_data + ((bit >> 6) << 3);
+            memcpy(&x, word, sizeof(x));
+            x >>= offset;
+            if (offset + m_width > 64) { //the value continues in the next word
+                uint64_t y;
+                memcpy(&y, word + sizeof(y), sizeof(y));
+                x |= y << (64 - offset);
+            }
+            return x & m_mask;
+        }
+
+        //! Writes the values as a serialized int_vector<>, so the bytes are the same ones
+        //! that sdsl writes for the int_vector<> viewed.
+        uint64_t
+        serialize(std::ostream& out, sdsl::structure_tree_node* v = nullptr, std::string name = "") const {
+            sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, "int_vector<>");
+            uint64_t bits = m_size * m_width, bytes = ((bits + 63) >> 6) << 3;
+            uint64_t written_bytes = sdsl::write_member(bits, out);
+            written_bytes += sdsl::write_member(m_width, out);
+            out.write(m_data, bytes);
+            written_bytes += bytes;
+            sdsl::structure_tree::add_size(child, written_bytes);
+            return written_bytes;
+        }
+    };
+
+}
+
+#endif //CST_CN_INT_VECTOR_VIEW_H
@@ -0,0 +1,489 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file interleaved_ops.h
+    \brief interleaved_ops.h contains experimental versions of the cst_cn operations that
+           work over a batch of queries and overlap their memory accesses.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_INTERLEAVED_OPS_H
+#define CST_CN_INTERLEAVED_OPS_H
+
+#include <sdsl/suffix_tree_helper.hpp>
+#include <vector>
+#include <cstddef>
+
+namespace cstds {
+
+    //! Answers the queries [0,n) keeping `group` of them in flight.
+    /*!
+    * Each query is a state machine of type t_query: start(q, i) starts the query i in q and
+    * returns true if it is already answered, q.step(cst) advances q until its next access
+    * to the NPR, which it prefetches before returning false, and returns true when q is
+    * answered, and done(q, i) stores the answer of the query i. The queries in flight are
+    * resumed round robin, so the cache misses of each one overlap the work of the others.
+    * The LCP and the CSA are components of sdsl and are read without a prefetch.
+    *
+    * Experimental: the only measurements so far (testOps -g, over an 8 MB text and a
+    * stand-in of sdsl) run the batches at 0.5-0.9 times the speed of the plain loops, so
+    * no default path of the library or the programs uses these functions. They are kept
+    * to be measured with the real sdsl on trees larger than the last level cache.
+    */
+    template<class t_query, class t_cst, class t_start, class t_done>
+    void
+    interleave(const t_cst& cst, size_t n, size_t group, t_start start, t_done done) {
+        if (group == 0)
+            group = 1;
+        std::vector<t_query> q(group);
+        std::vector<size_t> id(group);
+        size_t next = 0, in_flight = 0;
+        //starts the next query that is not answered by start in q[k]
+        auto refill = [&](size_t k) {
+            while (next < n) {
+                id[k] = next++;
+                if (!start(q[k], id[k]))
+                    return true;
+                done(q[k], id[k]);
+            }
+            return false;
+        };
+        size_t slots = 0;
+        while (slots < group and refill(slots))
+            ++slots;
+        std::vector<char> active(slots, 1);
+        in_flight = slots;
+        while (in_flight > 0) {
+            for (size_t k = 0; k < slots; ++k) {
+                if (active[k] and q[k].step(cst)) {
+                    done(q[k], id[k]);
+                    if (!refill(k)) {
+                        active[k] = 0;
+                        --in_flight;
+                    }
+                }
+            }
+        }
+    }
+
+    //! get_node of cst_cn: the node whose lcp value is LCP[pos], found with a bwd_psv and a
+    //! fwd_nsv that advance together.
+    template<class t_cst>
+    class node_search {
+    private:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+
+        typename t_cst::npr_type::search_type m_psv, m_nsv;
+
+    public:
+        void
+        start(const t_cst& cst, size_type pos) {
+            size_type value = cst.lcp[pos];
+            cst.npr.start_bwd_psv(m_psv, pos - 1, pos == 0 ? 0 : value); //psv(0) is n
+            cst.npr.start_fwd_nsv(m_nsv, pos + 1, value);
+        }
+
+        bool
+        step(const t_cst& cst) {
+            bool psv = cst.npr.step(m_psv);
+            return cst.npr.step(m_nsv) and psv;
+        }
+
+        node_type
+        node(const t_cst& cst) const {
+            size_type l = m_psv.result == cst.lcp.size() ? 0 : m_psv.result;
+            return node_type(l, m_nsv.result - 1);
+        }
+    };
+
+    //! cst.parent(v)
+    template<class t_cst>
+    class parent_query {
+    private:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+
+        node_search<t_cst> m_node;
+
+    public:
+        node_type result;
+
+        bool
+        start(const t_cst& cst, const node_type& v) {
+            size_type lcp_p_pos, t = cst.top.find(v);
+            if (t != cst.top.size()) {
+                result = cst.top.parent(t);
+                return true;
+            }
+            if (v.second == cst.lcp.size() - 1 or cst.lcp[v.first] > cst.lcp[v.second + 1])
+                lcp_p_pos = v.first;
+            else
+                lcp_p_pos = v.second + 1;
+            m_node.start(cst, lcp_p_pos);
+            return false;
+        }
+
+        bool
+        step(const t_cst& cst) {
+            if (!m_node.step(cst))
+                return false;
+            result = m_node.node(cst);
+            return true;
+        }
+    };
+
+    //! cst.sibling(v)
+    template<class t_cst>
+    class sibling_query {
+    private:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+
+        parent_query<t_cst> m_parent;
+        typename t_cst::npr_type::search_type m_nsv;
+        node_type m_v;
+        bool m_in_parent;
+
+        //! Answers the query from the parent of v, or starts the fwd_nsv of its right end.
+        bool
+        parent_found(const t_cst& cst) {
+            size_type l = m_v.second + 1;
+            node_type p = m_parent.result;
+            m_in_parent = false;
+            if (m_v.second >= p.second) { //no more siblings
+                result = cst.root();
+                return true;
+            }
+            if (l == p.second) { //last sibling is a leaf
+                result = node_type(p.second, p.second);
+                return true;
+            }
+            result = node_type(l, l);
+            cst.npr.start_fwd_nsv(m_nsv, l + 1, cst.lcp[l] + 1);
+            return false;
+        }
+
+    public:
+        node_type result;
+
+        bool
+        start(const t_cst& cst, const node_type& v) {
+            m_v = v;
+            m_in_parent = true;
+            return m_parent.start(cst, v) and parent_found(cst);
+        }
+
+        bool
+        step(const t_cst& cst) {
+            if (m_in_parent)
+                return m_parent.step(cst) and parent_found(cst);
+            if (!cst.npr.step(m_nsv))
+                return false;
+            result.second = m_nsv.result - 1;
+            return true;
+        }
+    };
+
+    //! cst.depth(v)
+    template<class t_cst>
+    class depth_query {
+    private:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+
+        typename t_cst::npr_type::search_type m_rmq;
+
+    public:
+        size_type result;
+
+        bool
+        start(const t_cst& cst, const node_type& v) {
+            size_type t;
+            if (cst.is_leaf(v))
+                result = cst.size() - cst.csa[v.first];
+            else if (v == cst.root())
+                result = 0;
+            else if ((t = cst.top.find(v)) != cst.top.size())
+                result = cst.top.depth(t);
+            else {
+                cst.npr.start_rmq(m_rmq, v.first + 1, v.second);
+                return false;
+            }
+            return true;
+        }
+
+        bool
+        step(const t_cst& cst) {
+            if (!cst.npr.step(m_rmq))
+                return false;
+            result = m_rmq.value;
+            return true;
+        }
+    };
+
+    //! cst.lca(v, w)
+    template<class t_cst>
+    class lca_query {
+    private:
+        typedef typename t_cst::node_type node_type;
+
+        typename t_cst::npr_type::search_type m_rmq;
+        node_search<t_cst> m_node;
+        bool m_in_rmq;
+
+    public:
+        node_type result;
+
+        bool
+        start(const t_cst& cst, const node_type& v, const node_type& w) {
+            if (cst.ancestor(v, w)) {
+                result = v;
+                return true;
+            }
+            if (cst.ancestor(w, v)) {
+                result = w;
+                return true;
+            }
+            if (v.second < w.first)
+                cst.npr.start_rmq(m_rmq, v.second + 1, w.first);
+            else //w.second < v.first
+                cst.npr.start_rmq(m_rmq, w.second + 1, v.first);
+            m_in_rmq = true;
+            return false;
+        }
+
+        bool
+        step(const t_cst& cst) {
+            if (m_in_rmq) {
+                if (!cst.npr.step(m_rmq))
+                    return false;
+                m_in_rmq = false;
+                m_node.start(cst, m_rmq.result);
+                return false;
+            }
+            if (!m_node.step(cst))
+                return false;
+            result = m_node.node(cst);
+            return true;
+        }
+    };
+
+    //! cst.child(v, c), computed as cst_cn::child for the alphabet of the CSA.
+    template<class t_cst>
+    class child_query {
+    private:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+        typedef typename t_cst::char_type char_type;
+        typedef typename t_cst::comp_char_type comp_char_type;
+
+        enum {RMQ, CHILD_END, LAST_CHILD, SIBLING_END}; //search being computed
+
+        typename t_cst::npr_type::search_type m_search;
+        node_type m_v, m_child;
+        std::vector<node_type> m_children; //children of v after the first one (byte alphabet)
+        size_type m_min_pos, m_max_pos; //range of c in the first column of the CSA
+        size_type m_d, m_last_pos, m_left_margin;
+        int m_phase;
+
+        //! Binary searches the leaves of v by their symbol at depth m_d, as cst_cn does over
+        //! an integer alphabet, and starts the fwd_nsv of the right end of the child.
+        bool
+        depth_found(const t_cst& cst, sdsl::int_alphabet_tag) {
+            size_type l_bound = m_v.first, r_bound = m_v.second + 1, mid;
+            while (l_bound < r_bound) {
+                mid = (l_bound + r_bound) >> 1;
+                if (sdsl::get_char_pos(mid, m_d, cst.csa) < m_min_pos)
+                    l_bound = mid + 1;
+                else
+                    r_bound = mid;
+            }
+            result = cst.root();
+            if (l_bound > m_v.second or sdsl::get_char_pos(l_bound, m_d, cst.csa) >= m_max_pos)
+                return true;
+            result = node_type(l_bound, l_bound);
+            if (l_bound == m_v.second) //the child is a leaf
+                return true;
+            m_phase = CHILD_END;
+            cst.npr.start_fwd_nsv(m_search, l_bound + 1, m_d + 1);
+            return false;
+        }
+
+        //! Checks the first and last children of v, as cst_cn does over a byte alphabet, and
+        //! starts the bwd_psv of the last child.
+        bool
+        depth_found(const t_cst& cst, sdsl::byte_alphabet_tag) {
+            size_type char_pos = sdsl::get_char_pos(m_v.first, m_d, cst.csa);
+            result = cst.root();
+            if (char_pos >= m_max_pos)
+                return true;
+            m_child = node_type(m_v.first, m_search.result - 1); //the first child
+            if (char_pos >= m_min_pos) {
+                result = m_child;
+                return true;
+            }
+            char_pos = sdsl::get_char_pos(m_v.second, m_d, cst.csa);
+            if (char_pos < m_min_pos)
+                return true;
+            m_last_pos = char_pos;
+            m_phase = LAST_CHILD;
+            cst.npr.start_bwd_psv(m_search, m_v.second, m_d + 1);
+            return false;
+        }
+
+        //! Lists the next child of v until the last one, starting the fwd_nsv of its right
+        //! end, and then binary searches c among them.
+        bool
+        next_child(const t_cst& cst) {
+            while (m_child.second != m_left_margin) {
+                size_type left = m_child.second + 1;
+                if (left != m_left_margin) {
+                    m_child = node_type(left, left);
+                    m_phase = SIBLING_END;
+                    cst.npr.start_fwd_nsv(m_search, left + 1, m_d + 1);
+                    return false;
+                }
+                m_child = node_type(left, left); //the sibling is a leaf
+                m_children.push_back(m_child);
+            }
+            size_type l_bound = 0, r_bound = m_children.size(), mid, char_pos;
+            result = cst.root();
+            while (l_bound < r_bound) {
+                mid = (l_bound + r_bound) >> 1;
+                char_pos = sdsl::get_char_pos(m_children[mid].first, m_d, cst.csa);
+                if (m_min_pos > char_pos)
+                    l_bound = mid + 1;
+                else if (m_max_pos <= char_pos)
+                    r_bound = mid;
+                else { //found child
+                    result = m_children[mid];
+                    break;
+                }
+            }
+            return true;
+        }
+
+    public:
+        node_type result;
+
+        bool
+        start(const t_cst& cst, const node_type& v, const char_type c) {
+            size_type t = cst.top.find(v);
+            if (t != cst.top.size()) {
+                result = cst.top.child(t, c);
+                return true;
+            }
+            result = cst.root();
+            if (cst.is_leaf(v))
+                return true;
+            comp_char_type cc = cst.csa.char2comp[c];
+            if ((cc == 0 and c != 0) or cc >= cst.csa.sigma)
+                return true;
+            m_max_pos = cst.csa.C[((size_type)1) + cc];
+            m_min_pos = cst.csa.C[cc];
+            m_v = v;
+            m_phase = RMQ;
+            cst.npr.start_rmq(m_search, v.first + 1, v.second); //depth of v and its first child
+            return false;
+        }
+
+        bool
+        step(const t_cst& cst) {
+            if (!cst.npr.step(m_search))
+                return false;
+            switch (m_phase) {
+                case RMQ:
+                    m_d = m_search.value;
+                    return depth_found(cst, typename t_cst::alphabet_category());
+                case CHILD_END:
+                    result.second = m_search.result - 1;
+                    return true;
+                case LAST_CHILD:
+                    if (m_last_pos < m_max_pos) {
+                        result = node_type(m_search.result, m_v.second);
+                        return true;
+                    }
+                    m_left_margin = m_search.result - 1;
+                    m_children.clear();
+                    return next_child(cst);
+                case SIBLING_END:
+                    m_child.second = m_search.result - 1;
+                    m_children.push_back(m_child);
+                    return next_child(cst);
+            }
+            return true;
+        }
+    };
+
+    //! res[i] = cst.parent(v[i])
+    template<class t_cst>
+    void
+    parent_interleaved(const t_cst& cst, const std::vector<typename t_cst::node_type>& v,
+                       std::vector<typename t_cst::node_type>& res, size_t group = 16) {
+        res.resize(v.size());
+        interleave<parent_query<t_cst> >(cst, v.size(), group,
+                   [&](parent_query<t_cst>& q, size_t i) { return q.start(cst, v[i]); },
+                   [&](parent_query<t_cst>& q, size_t i) { res[i] = q.result; });
+    }
+
+    //! res[i] = cst.sibling(v[i])
+    template<class t_cst>
+    void
+    sibling_interleaved(const t_cst& cst, const std::vector<typename t_cst::node_type>& v,
+                        std::vector<typename t_cst::node_type>& res, size_t group = 16) {
+        res.resize(v.size());
+        interleave<sibling_query<t_cst> >(cst, v.size(), group,
+                   [&](sibling_query<t_cst>& q, size_t i) { return q.start(cst, v[i]); },
+                   [&](sibling_query<t_cst>& q, size_t i) { res[i] = q.result; });
+    }
+
+    //! res[i] = cst.depth(v[i])
+    template<class t_cst>
+    void
+    depth_interleaved(const t_cst& cst, const std::vector<typename t_cst::node_type>& v,
+                      std::vector<typename t_cst::size_type>& res, size_t group = 16) {
+        res.resize(v.size());
+        interleave<depth_query<t_cst> >(cst, v.size(), group,
+                   [&](depth_query<t_cst>& q, size_t i) { return q.start(cst, v[i]); },
+                   [&](depth_query<t_cst>& q, size_t i) { res[i] = q.result; });
+    }
+
+    //! res[i] = cst.child(v[i], c[i])
+    template<class t_cst>
+    void
+    child_interleaved(const t_cst& cst, const std::vector<typename t_cst::node_type>& v,
+                      const std::vector<typename t_cst::char_type>& c,
+                      std::vector<typename t_cst::node_type>& res, size_t group = 16) {
+        res.resize(v.size());
+        interleave<child_query<t_cst> >(cst, v.size(), group,
+                   [&](child_query<t_cst>& q, size_t i) { return q.start(cst, v[i], c[i]); },
+                   [&](child_query<t_cst>& q, size_t i) { res[i] = q.result; });
+    }
+
+    //! res[i] = cst.lca(v[i], w[i])
+    template<class t_cst>
+    void
+    lca_interleaved(const t_cst& cst, const std::vector<typename t_cst::node_type>& v,
+                    const std::vector<typename t_cst::node_type>& w,
+                    std::vector<typename t_cst::node_type>& res, size_t group = 16) {
+        res.resize(v.size());
+        interleave<lca_query<t_cst> >(cst, v.size(), group,
+                   [&](lca_query<t_cst>& q, size_t i) { return q.start(cst, v[i], w[i]); },
+                   [&](lca_query<t_cst>& q, size_t i) { res[i] = q.result; });
+    }
+
+}
+
+#endif //CST_CN_INTERLEAVED_OPS_H
@@ -0,0 +1,147 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file lazy_cst_cn.h
+    \brief lazy_cst_cn.h contains a cst_cn stored in sections whose components are loaded on first use.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_LAZY_H
+#define CST_CN_LAZY_H
+
+#include "sectioned_file.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace cstds {
+
+    //! A cst_cn stored by serialize_sectioned whose CSA, LCP and NPR are each loaded the first
+    //! time an operation needs them, so only the header is read when it is opened.
+    /*!
+    * The accessors tell which components an operation needs:
+    * - csa(): backward search, count, locate and extract over the CSA.
+    * - ranges(): operations over the intervals of internal nodes that only use the LCP and
+    *   the NPR, such as parent, sibling, lca and the depth of internal nodes. The LCP of
+    *   lcp_support_sada is read through the CSA, so then the CSA is loaded too.
+    * - tree(): every other operation (e.g. child, sl or the depth of leaves).
+    * The accessors can be called concurrently: each component is loaded only once and the
+    * components loaded before are not modified.
+    */
+    template<class t_cst>
+    class lazy_cst_cn {
+    public:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::csa_type  csa_type;
+
+        //! Components of the index, in the order of their sections.
+        enum component : uint8_t {
+            CSA = 1,
+            LCP = 2,
+            NPR = 4,
+            ALL = 7
+        };
+
+    private:
+        std::string m_file;
+        std::vector<uint64_t> m_offset, m_size;
+        mutable t_cst m_cst;
+        mutable std::atomic<uint8_t> m_loaded{0};
+        mutable std::mutex m_mutex;
+
+        //! Components that the LCP needs to be accessed.
+        static uint8_t
+        lcp_needs() {
+            typedef typename t_cst::lcp_type::lcp_category lcp_category;
+            return std::is_same<lcp_category, sdsl::lcp_plain_tag>::value ? LCP : LCP | CSA;
+        }
+
+    public:
+        lazy_cst_cn() = default;
+        lazy_cst_cn(const lazy_cst_cn&) = delete;
+        lazy_cst_cn& operator=(const lazy_cst_cn&) = delete;
+
+        //! Reads the header of file. Returns false if it is not a sectioned file of t_cst.
+        bool
+        open(const std::string& file) {
+            section_header header;
+            if (!read_section_header(file, t_cst::format_type(), 3, header))
+                return false;
+            m_offset = header.offset;
+            m_size = header.size;
+            m_file = file;
+            m_cst = t_cst();
+            m_loaded = 0;
+            return true;
+        }
+
+        //! Loads the components of the mask that are not loaded yet and returns the index.
+        const t_cst&
+        require(uint8_t components) const {
+            if ((m_loaded.load() & components) == components)
+                return m_cst;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_type k = 0; k < 3; ++k) {
+                uint8_t c = (uint8_t) (1 << k);
+                if ((components & c) and !(m_loaded.load() & c)) {
+                    std::ifstream in(m_file, std::ios::in | std::ios::binary);
+                    in.seekg(m_offset[k]);
+                    m_cst.load_section(k, in);
+                    m_loaded |= c;
+                }
+            }
+            return m_cst;
+        }
+
+        //! The index with its CSA loaded.
+        const csa_type&
+        csa() const {
+            return require(CSA).csa;
+        }
+
+        //! The index with the components needed by the operations over internal nodes.
+        const t_cst&
+        ranges() const {
+            return require(lcp_needs() | NPR);
+        }
+
+        //! The index with all its components.
+        const t_cst&
+        tree() const {
+            return require(ALL);
+        }
+
+        //! Mask of the components loaded.
+        uint8_t
+        loaded() const {
+            return m_loaded.load();
+        }
+
+        //! Bytes of the file read by the components loaded.
+        uint64_t
+        loaded_bytes() const {
+            uint64_t bytes = 0;
+            for (size_type k = 0; k < m_size.size(); ++k)
+                if (m_loaded.load() & (1 << k))
+                    bytes += m_size[k];
+            return bytes;
+        }
+    };
+
+}
+
+#endif //CST_CN_LAZY_H
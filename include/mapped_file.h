@@ -0,0 +1,230 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file mapped_file.h
+    \brief mapped_file.h contains the loading of serialized indexes through a memory mapping of their file.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_MAPPED_FILE_H
+#define CST_CN_MAPPED_FILE_H
+
+#include "sectioned_file.h"
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cstds {
+
+    //! Read only mapping of a whole file, shared with the page cache.
+    class mapped_file {
+    private:
+        const char* m_data = nullptr;
+        size_t m_size = 0;
+
+    public:
+        explicit mapped_file(const std::string& file) {
+            int fd = open(file.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 and st.st_size > 0) {
+                void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED) {
+                    m_data = (const char*) p;
+                    m_size = st.st_size;
+                }
+            }
+            close(fd); //the mapping keeps the file open
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        ~mapped_file() {
+            if (m_data != nullptr)
+                munmap((void*) m_data, m_size);
+        }
+
+        //! Returns false if the file could not be mapped.
+        bool
+        good() const {
+            return m_data != nullptr;
+        }
+
+        const char*
+        data() const {
+            return m_data;
+        }
+
+        size_t
+        size() const {
+            return m_size;
+        }
+
+        //! Gives the kernel an access pattern hint (e.g. MADV_SEQUENTIAL) for the mapping.
+        void
+        advise(int advice) const {
+            if (m_data != nullptr)
+                madvise((void*) m_data, m_size, advice);
+        }
+    };
+
+    //! Stream buffer reading from a range of memory. Its get area is the range itself, so
+    //! reads copy straight from it without an intermediate buffer.
+    /*!
+    * If the range belongs to an owner that keeps it alive (e.g. a mapped_file), the
+    * components that can read their data in place (the levels of npr_cn_tree) keep a
+    * reference to the owner and point into the range instead of copying it.
+    */
+    class memory_streambuf : public std::streambuf {
+    private:
+        std::shared_ptr<const void> m_owner;
+
+    public:
+        memory_streambuf(const char* data, size_t size, std::shared_ptr<const void> owner = nullptr)
+                : m_owner(std::move(owner)) {
+            char* p = const_cast<char*>(data); //the get area is never written
+            setg(p, p, p + size);
+        }
+
+        //! Owner of the range, or nullptr if it may not outlive the stream.
+        const std::shared_ptr<const void>&
+        owner() const {
+            return m_owner;
+        }
+
+        //! Next byte to be read.
+        const char*
+        current() const {
+            return gptr();
+        }
+
+        //! Bytes left to be read.
+        size_t
+        available() const {
+            return egptr() - gptr();
+        }
+
+    protected:
+        pos_type
+        seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+            if (!(which & std::ios_base::in))
+                return pos_type(off_type(-1));
+            char* base = dir == std::ios_base::beg ? eback() : (dir == std::ios_base::cur ? gptr() : egptr());
+            if (base + off < eback() or base + off > egptr())
+                return pos_type(off_type(-1));
+            setg(eback(), base + off, egptr());
+            return pos_type(gptr() - eback());
+        }
+
+        pos_type
+        seekpos(pos_type pos, std::ios_base::openmode which) override {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+    //! Loads idx from the file written by its serialize method through a memory mapping of
+    //! the file instead of an ifstream.
+    /*!
+    * The levels of the NPR (npr_cn_tree, used by npr_support_cn and npr_support_cn_dyn) are
+    * not copied: they are read in place from the mapping, which is kept while the index (or
+    * a copy of it) uses them, so their pages are shared with the page cache and with the
+    * other processes that map the file. The CSA and the LCP are components of sdsl, which
+    * own their memory and cannot be built over a range of a file, so they are still
+    * deserialized, although straight from the page cache (read ahead with MADV_SEQUENTIAL
+    * and MADV_WILLNEED), without the read system calls and the copy into the buffer of a
+    * stream. Returns false if the file could not be mapped or read completely.
+    */
+    template<class t_index>
+    bool
+    load_from_mapped_file(t_index& idx, const std::string& file) {
+        std::shared_ptr<mapped_file> map = std::make_shared<mapped_file>(file);
+        if (!map->good())
+            return false;
+        map->advise(MADV_SEQUENTIAL);
+        map->advise(MADV_WILLNEED);
+        {
+            memory_streambuf buf(map->data(), map->size(), map);
+            std::istream in(&buf);
+            idx.load(in);
+            if (in.fail())
+                return false;
+        }
+        map->advise(MADV_RANDOM); //only the queries read the levels of the NPR from now on
+        return true;
+    }
+
+    //! Loads idx from the sectioned file written by its serialize_sectioned method through a
+    //! memory mapping of the file, each section by its own thread when threads > 1.
+    /*!
+    * The header is validated before any section is read, so a file of another type or
+    * version is rejected in O(1). Every section is then loaded from a stream over its own
+    * range of the mapping, and the levels of the NPR are read in place as with
+    * load_from_mapped_file. Returns false if the file could not be mapped, is not a
+    * sectioned file of t_index, or a section does not end where the header says.
+    */
+    template<class t_index>
+    bool
+    load_sectioned_from_mapped_file(t_index& idx, const std::string& file, uint64_t threads = 3) {
+        std::shared_ptr<mapped_file> map = std::make_shared<mapped_file>(file);
+        if (!map->good())
+            return false;
+        section_header header;
+        {
+            memory_streambuf buf(map->data(), map->size());
+            std::istream in(&buf);
+            if (!read_section_header(in, header) or header.type != t_index::format_type())
+                return false;
+        }
+        uint64_t n = header.offset.size();
+        for (uint64_t k = 0; k < n; ++k)
+            if (header.offset[k] > map->size() or header.size[k] > map->size() - header.offset[k])
+                return false;
+        map->advise(MADV_WILLNEED);
+        std::vector<char> ok(n, 0);
+        auto read_section = [&](uint64_t k) {
+            memory_streambuf buf(map->data() + header.offset[k], header.size[k], map);
+            std::istream in(&buf);
+            idx.load_section(k, in);
+            ok[k] = in and (uint64_t) in.tellg() == header.size[k];
+        };
+        std::vector<std::thread> pool;
+        for (uint64_t k = 1; k < n; ++k) {
+            if (threads > k)
+                pool.emplace_back(read_section, k);
+            else
+                read_section(k);
+        }
+        if (n > 0)
+            read_section(0);
+        for (auto& th : pool)
+            th.join();
+        for (char r : ok)
+            if (!r)
+                return false;
+        return n > 0;
+    }
+
+}
+
+#endif //CST_CN_MAPPED_FILE_H
@@ -0,0 +1,235 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file merge_cst_cn.h
+    \brief merge_cst_cn.h contains the merge of two cst_cn into the cst_cn of their collection.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_MERGE_H
+#define CST_CN_MERGE_H
+
+#include <sdsl/construct.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include "construction_report.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace cstds {
+
+    using namespace sdsl;
+
+    //! Symbol placed between the two texts of a merged index.
+    const uint8_t MERGE_SEPARATOR = 1;
+
+    //! Decodes the text and the suffix array of csa by following LF from the last suffix.
+    template<class t_csa>
+    void
+    decode_text_and_sa(const t_csa& csa, int_vector<8>& text, int_vector<>& sa) {
+        uint64_t n = csa.size();
+        text = int_vector<8>(n, 0);
+        sa = int_vector<>(n, 0, bits::hi(n) + 1);
+        uint64_t p = 0; //the suffix containing only the 0 symbol is the first one
+        sa[0] = n - 1;
+        for (uint64_t pos = n - 1; pos > 0; --pos) {
+            text[pos - 1] = csa.bwt[p];
+            p = csa.lf[p];
+            sa[p] = pos - 1;
+        }
+    }
+
+    //! Computes, for each suffix of text (with its 0 symbol), the number of suffixes of
+    //! csa smaller than it, and counts them in gap (of size csa.size() + 1). `first` tells
+    //! if text is the first one of the collection. On ties the suffix of the second text is
+    //! the smaller one, since its 0 symbol is smaller than the separator that ends the first.
+    template<class t_csa>
+    void
+    compute_gap(const t_csa& csa, const int_vector<8>& text, bool first, int_vector<>& gap) {
+        uint64_t n = csa.size();
+        uint64_t smaller[256]; //number of suffixes of csa starting with a symbol smaller than c
+        for (uint64_t c = 0, k = 0; c < 256; ++c) {
+            while (k < csa.sigma and csa.comp2char[k] < c)
+                ++k;
+            smaller[c] = k < csa.sigma ? csa.C[k] : n;
+        }
+        gap = int_vector<>(n + 1, 0, bits::hi(text.size()) + 1);
+        uint64_t r = first ? 1 : 0; //rank of the suffix with only the end symbol
+        gap[r] = gap[r] + 1;
+        for (uint64_t j = text.size() - 1; j > 0; --j) {
+            uint8_t c = text[j - 1];
+            if (csa.char2comp[c] != 0) //c is in csa
+                r = smaller[c] + csa.rank_bwt(r, c);
+            else
+                r = smaller[c];
+            gap[r] = gap[r] + 1;
+        }
+    }
+
+    //! Builds in idx the cst_cn of the collection {T1, T2}, where idx1 and idx2 are the
+    //! indexes of T1 and T2.
+    /*!
+    * The text of the result is T1, the symbol MERGE_SEPARATOR and T2 (followed by the 0
+    * symbol), so neither text can contain MERGE_SEPARATOR. No suffix is sorted again:
+    * - Both texts and suffix arrays are decoded with LF.
+    * - The suffixes of the smaller text are searched backwards in the index of the other
+    *   one, which gives the position of each of them among the suffixes of the larger text.
+    * - The suffix array, the BWT and the LCP of the result are written to the cache in one
+    *   pass over the merged order. The LCP of two consecutive suffixes of the same text is
+    *   copied from the LCP of its index. Only the pairs coming from different texts are
+    *   compared, in text order as the PHI algorithm does.
+    * - Then the CSA is built from the cache and the NPR from the new LCP, as in
+    *   construct_cst_cn. npr_args are given to the NPR constructor.
+    * Returns false if a text contains MERGE_SEPARATOR.
+    */
+    template<class t_index, class... t_npr_args>
+    bool
+    merge_cst_cn(t_index& idx, const t_index& idx1, const t_index& idx2, cache_config& config,
+                 uint64_t threads = 1, t_npr_args... npr_args) {
+        static_assert(t_index::alphabet_category::WIDTH == 8, "merge_cst_cn needs a byte alphabet");
+        typedef typename t_index::csa_type csa_type;
+        const std::string key_csa = std::string(conf::KEY_CSA) + "_" + util::class_to_hash(csa_type());
+        if (idx1.csa.char2comp[MERGE_SEPARATOR] != 0 or idx2.csa.char2comp[MERGE_SEPARATOR] != 0) {
+            std::cerr << "Error: the texts to merge contain the separator symbol "
+                      << (int) MERGE_SEPARATOR << "." << std::endl;
+            return false;
+        }
+        uint64_t n1 = idx1.size(), n2 = idx2.size(), n = n1 + n2;
+        int_vector<8> text1, text2;
+        int_vector<> sa1, sa2, gap;
+        {
+            auto event = memory_monitor::event("decode texts");
+            construction_report::phase phase("decode texts");
+            decode_text_and_sa(idx1.csa, text1, sa1);
+            decode_text_and_sa(idx2.csa, text2, sa2);
+            text1[n1 - 1] = MERGE_SEPARATOR;
+        }
+        //the smaller text is inserted in the larger one
+        bool insert_second = n2 <= n1;
+        {
+            auto event = memory_monitor::event("gap array");
+            construction_report::phase phase("gap array");
+            if (insert_second)
+                compute_gap(idx1.csa, text2, false, gap);
+            else
+                compute_gap(idx2.csa, text1, true, gap);
+        }
+        auto at = [&](uint64_t pos) -> uint8_t { return pos < n1 ? text1[pos] : text2[pos - n1]; };
+        int_vector<> phi(n, 0, bits::hi(n) + 1);  //previous suffix in the merged order
+        int_vector<> plcp(n, 0, bits::hi(n) + 1); //LCP in text order
+        bit_vector known(n, 0);                   //plcp[i] was copied from idx1 or idx2
+        {
+            auto event = memory_monitor::event("merge SA and BWT");
+            construction_report::phase phase("merge SA and BWT");
+            int_vector_buffer<8> text_buf(cache_file_name(conf::KEY_TEXT, config), std::ios::out);
+            for (uint64_t i = 0; i < n; ++i)
+                text_buf.push_back(at(i));
+            text_buf.close();
+            int_vector_buffer<> sa_buf(cache_file_name(conf::KEY_SA, config), std::ios::out, 1 << 20, bits::hi(n) + 1);
+            int_vector_buffer<8> bwt_buf(cache_file_name(conf::KEY_BWT, config), std::ios::out);
+            uint64_t i1 = 0, i2 = 0, prev = n, src = 0; //src: text of the previous suffix
+            auto emit = [&](uint64_t s, uint64_t from, uint64_t lcp) {
+                sa_buf.push_back(s);
+                bwt_buf.push_back(s > 0 ? at(s - 1) : 0);
+                phi[s] = prev;
+                if (src == from) { //consecutive in its own index
+                    plcp[s] = lcp;
+                    known[s] = 1;
+                } else if (prev == n) { //first suffix
+                    known[s] = 1;
+                }
+                prev = s;
+                src = from;
+            };
+            //gap[r] suffixes of the inserted text go before the r-th suffix of the other one
+            int_vector<>& sa_big = insert_second ? sa1 : sa2;
+            int_vector<>& sa_small = insert_second ? sa2 : sa1;
+            uint64_t small_from = insert_second ? 2 : 1, big_from = 3 - small_from;
+            uint64_t small_off = insert_second ? n1 : 0, big_off = insert_second ? 0 : n1;
+            const t_index& big = insert_second ? idx1 : idx2;
+            const t_index& small = insert_second ? idx2 : idx1;
+            uint64_t& i_big = insert_second ? i1 : i2;
+            uint64_t& i_small = insert_second ? i2 : i1;
+            for (uint64_t r = 0; r < gap.size(); ++r) {
+                for (uint64_t k = 0; k < gap[r]; ++k, ++i_small)
+                    emit(sa_small[i_small] + small_off, small_from, small.lcp[i_small]);
+                if (r < sa_big.size()) {
+                    emit(sa_big[i_big] + big_off, big_from, big.lcp[i_big]);
+                    ++i_big;
+                }
+            }
+            sa_buf.close();
+            bwt_buf.close();
+        }
+        util::clear(sa1); //the suffix arrays of idx1 and idx2 are not needed anymore
+        util::clear(sa2);
+        util::clear(gap);
+        register_cache_file(conf::KEY_TEXT, config);
+        register_cache_file(conf::KEY_SA, config);
+        register_cache_file(conf::KEY_BWT, config);
+        {
+            auto event = memory_monitor::event("merge LCP");
+            construction_report::phase phase("merge LCP");
+            //only the pairs of suffixes of different texts are compared. As in PHI,
+            //plcp[i + 1] >= plcp[i] - 1, and the separator and the 0 symbol are unique
+            uint64_t h = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                if (!known[i]) {
+                    uint64_t j = phi[i];
+                    while (at(i + h) == at(j + h))
+                        ++h;
+                    plcp[i] = h;
+                } else {
+                    h = plcp[i];
+                }
+                if (h > 0)
+                    --h;
+            }
+            util::clear(phi);
+            util::clear(text1);
+            util::clear(text2);
+            int_vector_buffer<> sa_buf(cache_file_name(conf::KEY_SA, config), std::ios::in);
+            int_vector_buffer<> lcp_buf(cache_file_name(conf::KEY_LCP, config), std::ios::out, 1 << 20,
+                                        bits::hi(n) + 1);
+            for (uint64_t k = 0; k < n; ++k)
+                lcp_buf.push_back(plcp[sa_buf[k]]);
+            lcp_buf.close();
+        }
+        register_cache_file(conf::KEY_LCP, config);
+        util::clear(plcp);
+        {
+            auto event = memory_monitor::event("CSA");
+            construction_report::phase phase("CSA");
+            if (!cache_file_exists(key_csa, config)) {
+                csa_type csa(config);
+                store_to_cache(csa, key_csa, config);
+            }
+            register_cache_file(key_csa, config);
+        }
+        {
+            auto event = memory_monitor::event("CST");
+            construction_report::phase phase("CST");
+            t_index tmp(config, threads, false, npr_args...);
+            tmp.swap(idx);
+        }
+        if (config.delete_files) {
+            auto event = memory_monitor::event("delete temporary files");
+            util::delete_all_files(config.file_map);
+        }
+        return true;
+    }
+
+}
+
+#endif //CST_CN_MERGE_H
@@ -21,6 +21,7 @@ along with this program.  If not, see http://www.gnu.org/licenses/ .
 
 #include "npr_support_cn.h"
 #include "npr_support_cnr.h"
+#include "npr_support_cn_dyn.h"
 
 namespace cstds{
 
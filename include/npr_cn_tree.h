@@ -0,0 +1,936 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file npr_cn_tree.h
+    \brief npr_cn_tree.h contains the levels of the NPR of Canovas and Navarro and the searches over them,
+           shared by _npr_support_cn and _npr_support_cn_dyn.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_NPR_CN_TREE_H
+#define CST_CN_NPR_CN_TREE_H
+
+#include "parallel.h"
+#include "construction_report.h"
+#include "int_vector_view.h"
+#include "mapped_file.h"
+#include <sdsl/int_vector.hpp>
+#include <sdsl/io.hpp>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace cstds {
+
+    //! Fanout of an npr_cn_tree that is the constant t_bs in all the levels, so the block
+    //! computations are divisions and products by a constant.
+    template<uint64_t t_bs>
+    struct npr_fanout_fixed {
+        //! Block of level r containing entry i of level r-1 (the LCP for r = 0).
+        static uint64_t
+        block_of(uint64_t i, uint64_t) {
+            return i / t_bs;
+        }
+
+        //! First entry of level r-1 in block b of level r.
+        static uint64_t
+        block_start(uint64_t b, uint64_t) {
+            return b * t_bs;
+        }
+    };
+
+    //! Fanout of an npr_cn_tree that is the power of two 2^shift in all the levels.
+    struct npr_fanout_shift {
+        uint64_t shift;
+
+        uint64_t
+        block_of(uint64_t i, uint64_t) const {
+            return i >> shift;
+        }
+
+        uint64_t
+        block_start(uint64_t b, uint64_t) const {
+            return b << shift;
+        }
+    };
+
+    //! Fanout of an npr_cn_tree that is the power of two 2^shift[r] in each level r.
+    struct npr_fanout_levels {
+        const sdsl::int_vector<8>& shift;
+
+        uint64_t
+        block_of(uint64_t i, uint64_t r) const {
+            return i >> shift[r];
+        }
+
+        uint64_t
+        block_start(uint64_t b, uint64_t r) const {
+            return b << shift[r];
+        }
+    };
+
+    //! The levels of the NPR of Canovas and Navarro and the queries over them.
+    /*!
+    * Level r keeps the minimum, and its local position, of each block of consecutive
+    * entries of level r-1, where level -1 is the LCP array, until a level has a single
+    * block. The size of the blocks of each level (the fanout) is given to the queries by a
+    * policy with block_of(i, r) and block_start(b, r), e.g. npr_fanout_fixed, so each NPR
+    * decides how the block computations are done. The LCP is also given to each query.
+    * The queries read the levels through views (int_vector_view), which point to the
+    * levels built or loaded by this object or, after a load from a mapped file, into the
+    * mapping, so the levels are not copied into memory of the process (see load).
+    * \tparam t_size Type of the positions and values of the queries (see cst_cn).
+    *
+    * The query methods are const and do not use shared scratch space, so they can be
+    * called concurrently from several threads.
+    */
+    template<class t_size = sdsl::int_vector<>::size_type>
+    class npr_cn_tree {
+
+    public:
+        typedef t_size size_type;
+
+    private:
+        enum : uint8_t {NSV, PSV, RMQ}; //kinds of search
+        enum : uint8_t {UP, DOWN, DONE}; //phases of search
+
+        std::vector<sdsl::int_vector<> > m_min_levels; //min value of each block of each level, when they are owned
+        std::vector<sdsl::int_vector<> > m_pos_levels; //local position of the min value of each block of each level
+        std::shared_ptr<const void> m_owner; //owner of the memory of the levels when they are not owned
+        std::vector<int_vector_view> min_array; //min value of each block of each level, read by the queries
+        std::vector<int_vector_view> pos_array; //local position of the min value of each block of each level
+
+        //! Points the views to the levels owned.
+        void
+        set_views() {
+            min_array.clear();
+            pos_array.clear();
+            for (size_type r = 0; r < m_min_levels.size(); ++r) {
+                min_array.emplace_back(m_min_levels[r]);
+                pos_array.emplace_back(m_pos_levels[r]);
+            }
+        }
+
+        //! Points the views to the levels serialized in the memory of in, which must be a
+        //! memory_streambuf with an owner, and moves in past them. Sets the failbit of in if
+        //! they do not fit.
+        void
+        map(std::istream &in, memory_streambuf &buf) {
+            const char* data = buf.current();
+            uint64_t size = buf.available(), levels = 0, used = sizeof(levels);
+            bool ok = size >= sizeof(levels);
+            if (ok) {
+                memcpy(&levels, data, sizeof(levels));
+                ok = levels <= 64;
+            }
+            min_array.assign(ok ? levels : 0, int_vector_view());
+            pos_array.assign(ok ? levels : 0, int_vector_view());
+            for (size_type r = 0; ok and r < levels; ++r) {
+                uint64_t bytes = min_array[r].map(data + used, size - used);
+                used += bytes;
+                ok = bytes > 0 and (bytes = pos_array[r].map(data + used, size - used)) > 0;
+                used += bytes;
+            }
+            if (!ok) {
+                clear();
+                in.setstate(std::ios::failbit);
+                return;
+            }
+            m_owner = buf.owner();
+            in.seekg(used, std::ios::cur);
+        }
+
+    public:
+
+        npr_cn_tree() { }
+
+        npr_cn_tree(const npr_cn_tree &tree) {
+            *this = tree;
+        }
+
+        npr_cn_tree(npr_cn_tree &&tree) {
+            *this = std::move(tree);
+        }
+
+        npr_cn_tree &operator=(const npr_cn_tree &tree) {
+            if (this != &tree) {
+                m_min_levels = tree.m_min_levels;
+                m_pos_levels = tree.m_pos_levels;
+                m_owner = tree.m_owner;
+                min_array = tree.min_array;
+                pos_array = tree.pos_array;
+                if (m_owner == nullptr)
+                    set_views();
+            }
+            return *this;
+        }
+
+        npr_cn_tree &operator=(npr_cn_tree &&tree) {
+            if (this != &tree) {
+                clear();
+                swap(tree);
+            }
+            return *this;
+        }
+
+        //! Number of levels.
+        size_type
+        levels() const {
+            return min_array.size();
+        }
+
+        //! Returns true if the levels are read in place from the memory of another object
+        //! (see load).
+        bool
+        mapped() const {
+            return m_owner != nullptr;
+        }
+
+        //! Swaps the levels. The views keep pointing to the memory of the levels they view.
+        void
+        swap(npr_cn_tree &tree) {
+            m_min_levels.swap(tree.m_min_levels);
+            m_pos_levels.swap(tree.m_pos_levels);
+            m_owner.swap(tree.m_owner);
+            min_array.swap(tree.min_array);
+            pos_array.swap(tree.pos_array);
+        }
+
+        void
+        clear() {
+            m_min_levels.clear();
+            m_pos_levels.clear();
+            m_owner.reset();
+            min_array.clear();
+            pos_array.clear();
+        }
+
+        //! Builds the levels of the LCP of size n, where fanout(r) is the fanout of level r.
+        //! source() returns the values of the LCP used for the first level; it is called once
+        //! per thread so each one can have its own reader. The blocks of each level are
+        //! computed by up to `threads` threads.
+        template<class t_fanout, class t_source>
+        void
+        create_levels(size_type n, size_type threads, t_fanout fanout, t_source source) {
+            size_type bits_min = sdsl::bits::hi(n) + 1;
+            size_type level_size = n, last_level_size;
+            clear();
+            size_type r = 0;
+            do {
+                construction_report::phase phase("NPR level " + std::to_string(r));
+                size_type f = fanout(r);
+                last_level_size = level_size;
+                level_size = (level_size + f - 1) / f;
+                m_min_levels.push_back(sdsl::int_vector<>(level_size, 0, bits_min));
+                m_pos_levels.push_back(sdsl::int_vector<>(level_size, 0, sdsl::bits::hi(f) + 1));
+                if (r == 0) { //the first level reads the LCP
+                    parallel_for(level_size, threads, [&](size_type from, size_type to) {
+                        auto&& values = source();
+                        create_blocks(values, n, last_level_size, f, 0, from, to);
+                    });
+                } else {
+                    parallel_for(level_size, threads, [&](size_type from, size_type to) {
+                        create_blocks(m_min_levels[r - 1], n, last_level_size, f, r, from, to);
+                    });
+                }
+                ++r;
+            } while (level_size > 1);
+            set_views();
+        }
+
+        //! Serializes the levels to the node v of the structure tree.
+        uint64_t
+        serialize(std::ostream &out, sdsl::structure_tree_node *v) const {
+            uint64_t levels = min_array.size();
+            uint64_t written_bytes = 0;
+            written_bytes += sdsl::write_member(levels, out, v, "levels");
+            for (size_type i = 0; i < levels; ++i) {
+                written_bytes += min_array[i].serialize(out, v, "min level");
+                written_bytes += pos_array[i].serialize(out, v, "pos level");
+            }
+            return written_bytes;
+        }
+
+        //! Load from a stream. If in reads from a memory_streambuf with an owner (e.g. the
+        //! mapping of load_from_mapped_file), the levels are not copied: they are read in place
+        //! and the owner is kept while this object (or a copy of it) exists.
+        void
+        load(std::istream &in) {
+            clear();
+            memory_streambuf* buf = dynamic_cast<memory_streambuf*>(in.rdbuf());
+            if (buf != nullptr and buf->owner() != nullptr) {
+                map(in, *buf);
+                return;
+            }
+            uint64_t levels = 0;
+            sdsl::read_member(levels, in);
+            if (!in or levels > 64) {
+                in.setstate(std::ios::failbit);
+                return;
+            }
+            m_min_levels.resize(levels);
+            m_pos_levels.resize(levels);
+            for (size_type i = 0; i < levels; ++i) {
+                m_min_levels[i].load(in);
+                m_pos_levels[i].load(in);
+            }
+            set_views();
+        }
+
+        //! Get the position of the next smaller value than d starting from i.
+        template<class t_lcp, class t_fanout>
+        size_type
+        fwd_nsv(const t_lcp &lcp, const t_fanout &f, size_type i, size_type d, size_type &l_value) const {
+            size_type block, until = 0, value, n = lcp.size();
+            l_value = n; //not found yet
+            if (d == 0 or i > n - 1)
+                return n;
+            block = f.block_of(i, 0);
+            if (min_array[0][block] < d) { //need to search in the first block
+                until = f.block_start(block + 1, 0);
+                if (until > n)
+                    until = n;
+                for (size_type j = i; j < until; ++j) {
+                    value = lcp[j];
+                    if (value < d) {
+                        l_value = value;
+                        return j;
+                    }
+                }
+            }
+            if (until == n)  //last block
+                return n;
+            block = find_nsv_block(f, d, block + 1, 0, l_value); //need to find block containing a value smaller than d
+            if (block == min_array[0].size())
+                return n;
+            until = f.block_start(block, 0) + pos_array[0][block];
+            if (l_value == d - 1) //we already found the position of nsv
+                return until;
+            for (size_type j = f.block_start(block, 0); j < until; ++j) { //look if there is a small value earlier
+                value = lcp[j];
+                if (value < d) {
+                    l_value = value;
+                    return j;
+                }
+            }
+            return until; // it was the last one
+        }
+
+        //! Get the position of the previous smaller value than d starting from i.
+        template<class t_lcp, class t_fanout>
+        size_type
+        bwd_psv(const t_lcp &lcp, const t_fanout &f, size_type i, size_type d, size_type &l_value) const {
+            size_type block, value, n;
+            size_type until = lcp.size();
+            l_value = n = until; // not found yet
+            if (d == 0)
+                return n;
+            block = f.block_of(i, 0);
+            if (min_array[0][block] < d) { //need to search in the first block
+                until = f.block_start(block, 0);
+                for (size_type j = i; j >= until; --j) {
+                    value = lcp[j];
+                    if (value < d) {
+                        l_value = value;
+                        return j;
+                    }
+                }
+            }
+            if (until == 0)
+                return n;
+            block = find_psv_block(f, d, block - 1, 0, l_value); //need to find block containing a value smaller than d
+            if (block == min_array[0].size())
+                return n;
+            until = f.block_start(block, 0) + pos_array[0][block];
+            for (size_type j = f.block_start(block + 1, 0) - 1; j > until; --j) { //look if there is a small value earlier
+                value = lcp[j];
+                if (value < d) {
+                    l_value = value;
+                    return j;
+                }
+            }
+            return until; // the smaller value was the one pointed
+        }
+
+        //! Get the left most position of the minimum value in the interval [i,j].
+        //! We assumed that always 0 <= i <= j < n.
+        template<class t_lcp, class t_fanout>
+        size_type
+        rmq(const t_lcp &lcp, const t_fanout &f, size_type i, size_type j, size_type &l_value) const {
+            size_type r_block, l_block, value, until, min_bpos, block, n = lcp.size();
+            size_type min_rmq = n, min_pos = i, aux_rmq;
+            l_block = f.block_of(i, 0);
+            r_block = f.block_of(j, 0);
+            //compute left block first
+            until = f.block_start(l_block + 1, 0) - 1;
+            if (until > j)
+                until = j;
+            min_bpos = f.block_start(l_block, 0) + pos_array[0][l_block]; //position of the min in the block
+            if (min_bpos >= i and min_bpos <= until) {
+                min_rmq = min_array[0][l_block];
+                min_pos = min_bpos;
+            }
+            else {
+                for (size_type r = i; r <= until; ++r) {
+                    value = lcp[r];
+                    if (value < min_rmq) {
+                        min_rmq = value;
+                        min_pos = r;
+                        if (min_rmq == 0)
+                            break;
+                    }
+                }
+            }
+            if (until == j or min_rmq == 0) {  //case left_block == right_block and if we find a 0
+                l_value = min_rmq;
+                return min_pos;
+            }
+            l_block++;
+            //compute middle blocks
+            if (l_block < r_block) {
+                block = find_rmq_block(f, n, l_block, r_block - 1, aux_rmq, 0);
+                if (aux_rmq < min_rmq) {
+                    min_rmq = aux_rmq;
+                    min_pos = f.block_start(block, 0) + pos_array[0][block];
+                    if (min_rmq == 0) {
+                        l_value = min_rmq;
+                        return min_pos;
+                    }
+                }
+            }
+            //compute min right block
+            until = j;
+            min_bpos = f.block_start(r_block, 0) + pos_array[0][r_block];
+            if (min_array[0][r_block] < min_rmq) {
+                if (min_bpos <= until) {
+                    l_value = min_array[0][r_block];
+                    return min_bpos;
+                } else {
+                    for (size_type r = f.block_start(r_block, 0); r <= until; ++r) {
+                        value = lcp[r];
+                        if (value < min_rmq) {
+                            min_rmq = value;
+                            min_pos = r;
+                            if (min_rmq == 0)
+                                break;
+                        }
+                    }
+                }
+            }
+            l_value = min_rmq;
+            return min_pos;
+        }
+
+        //! State of a fwd_nsv, bwd_psv or rmq that is computed one level of the tree at a
+        //! time by step, so the queries of a batch can be interleaved (see interleaved_ops.h).
+        //! result and value hold the answer and its l_value once step returns true.
+        struct search {
+            size_type result = 0;
+            size_type value = 0;
+            uint8_t kind = NSV;
+            uint8_t phase = DONE;
+            size_type level = 0; //0 is the LCP, r + 1 is min_array[r]
+            size_type i = 0, j = 0, d = 0; //current position (or range of rmq) in the level
+            size_type left_value = 0, left_level = 0, left_pos = 0; //leftmost min of the left parts of rmq
+            size_type right_end[64]; //end of the right part of the range of rmq in each level below
+        };
+
+        //! Starts s as fwd_nsv(i, d). Its first step reads the LCP.
+        template<class t_lcp, class t_fanout>
+        void
+        start_fwd_nsv(search &s, const t_lcp &lcp, const t_fanout &f, size_type i, size_type d) const {
+            size_type n = lcp.size();
+            s.kind = NSV;
+            s.result = s.value = n;
+            s.phase = (d == 0 or i > n - 1) ? DONE : UP;
+            s.level = 0;
+            s.i = i;
+            s.d = d;
+            if (s.phase == UP)
+                prefetch_entry(min_array[0], f.block_of(i, 0));
+        }
+
+        //! Starts s as bwd_psv(i, d).
+        template<class t_lcp, class t_fanout>
+        void
+        start_bwd_psv(search &s, const t_lcp &lcp, const t_fanout &f, size_type i, size_type d) const {
+            s.kind = PSV;
+            s.result = s.value = lcp.size();
+            s.phase = d == 0 ? DONE : UP;
+            s.level = 0;
+            s.i = i;
+            s.d = d;
+            if (s.phase == UP)
+                prefetch_entry(min_array[0], f.block_of(i, 0));
+        }
+
+        //! Starts s as rmq(i, j). We assumed that always 0 <= i <= j < n.
+        template<class t_lcp, class t_fanout>
+        void
+        start_rmq(search &s, const t_lcp &lcp, const t_fanout &f, size_type i, size_type j) const {
+            s.kind = RMQ;
+            s.phase = UP;
+            s.level = 0;
+            s.i = i;
+            s.j = j;
+            s.left_value = lcp.size();
+            prefetch_entry(pos_array[0], f.block_of(i, 0));
+            prefetch_entry(pos_array[0], f.block_of(j, 0));
+        }
+
+        //! Computes one level of s. Before returning false it prefetches the entries of the
+        //! tree that the next step reads, so the caller can work on other queries meanwhile.
+        //! Returns true when s has its answer (also for an s already answered). The answers
+        //! are the ones of fwd_nsv, bwd_psv and rmq.
+        template<class t_lcp, class t_fanout>
+        bool
+        step(search &s, const t_lcp &lcp, const t_fanout &f) const {
+            if (s.phase == UP) {
+                if (s.kind == NSV)
+                    nsv_up(s, lcp, f);
+                else if (s.kind == PSV)
+                    psv_up(s, lcp, f);
+                else
+                    rmq_up(s, lcp, f);
+            } else if (s.phase == DOWN) {
+                down(s, lcp, f);
+            }
+            return s.phase == DONE;
+        }
+
+    private:
+
+        //! Computes the blocks [from,to) of level r, of fanout f, where `values` contains the
+        //! len values of the level below (the LCP of size n for the first level).
+        template<class t_values>
+        void
+        create_blocks(t_values& values, size_type n, size_type len, size_type f, size_type r,
+                      size_type from, size_type to) {
+            size_type tmp_min, min, tmp_pos = 0, tmp_start, b_size = f;
+            for (size_type i = from; i < to; ++i) {
+                min = n;
+                tmp_start = i * f;
+                if (tmp_start + f >= len)
+                    b_size = len - tmp_start;
+                for (size_type j = 0; j < b_size; j++) {
+                    tmp_min = values[tmp_start + j];
+                    if (tmp_min < min) {
+                        min = tmp_min;
+                        tmp_pos = j;
+                    }
+                }
+                m_min_levels[r][i] = min;
+                m_pos_levels[r][i] = tmp_pos;
+            }
+        }
+
+        //! First position in [from,to) of values with a value smaller than d, or to.
+        template<class t_values>
+        static size_type
+        first_smaller(const t_values &values, size_type from, size_type to, size_type d, size_type &value) {
+            for (; from < to; ++from) {
+                value = values[from];
+                if (value < d)
+                    return from;
+            }
+            return to;
+        }
+
+        //! Last position in [from,to) of values with a value smaller than d, or to.
+        template<class t_values>
+        static size_type
+        last_smaller(const t_values &values, size_type from, size_type to, size_type d, size_type &value) {
+            for (size_type j = to; j-- > from;) {
+                value = values[j];
+                if (value < d)
+                    return j;
+            }
+            return to;
+        }
+
+        //! Leftmost position in [from,to) of the min of values if it is smaller than min_value,
+        //! which then becomes the min, or to.
+        template<class t_values>
+        static size_type
+        leftmost_min(const t_values &values, size_type from, size_type to, size_type &min_value) {
+            size_type min_pos = to, value;
+            for (; from < to; ++from) {
+                value = values[from];
+                if (value < min_value) {
+                    min_value = value;
+                    min_pos = from;
+                    if (min_value == 0)
+                        break;
+                }
+            }
+            return min_pos;
+        }
+
+        //! The scans above over level L of a search, where level 0 is the LCP.
+        template<class t_lcp>
+        size_type
+        first_smaller(const t_lcp &lcp, size_type L, size_type from, size_type to, size_type d, size_type &value) const {
+            return L == 0 ? first_smaller(lcp, from, to, d, value) : first_smaller(min_array[L - 1], from, to, d, value);
+        }
+
+        template<class t_lcp>
+        size_type
+        last_smaller(const t_lcp &lcp, size_type L, size_type from, size_type to, size_type d, size_type &value) const {
+            return L == 0 ? last_smaller(lcp, from, to, d, value) : last_smaller(min_array[L - 1], from, to, d, value);
+        }
+
+        template<class t_lcp>
+        size_type
+        leftmost_min(const t_lcp &lcp, size_type L, size_type from, size_type to, size_type &min_value) const {
+            return L == 0 ? leftmost_min(lcp, from, to, min_value) : leftmost_min(min_array[L - 1], from, to, min_value);
+        }
+
+        template<class t_lcp>
+        size_type
+        level_size(const t_lcp &lcp, size_type L) const {
+            return L == 0 ? lcp.size() : min_array[L - 1].size();
+        }
+
+        //! Prefetches entry x of level L of a search (the LCP is read as it is).
+        void
+        prefetch_level(size_type L, size_type x) const {
+            if (L > 0)
+                prefetch_entry(min_array[L - 1], x);
+        }
+
+        //! s found the entry s.i of level s.level, of value s.value: goes down to the LCP.
+        void
+        found(search &s) const {
+            if (s.level == 0) {
+                s.result = s.i;
+                s.phase = DONE;
+                return;
+            }
+            s.phase = DOWN;
+            prefetch_entry(pos_array[s.level - 1], s.i);
+        }
+
+        //! Same as a call of find_nsv_block (fwd_nsv for level 0) before it recurses.
+        template<class t_lcp, class t_fanout>
+        void
+        nsv_up(search &s, const t_lcp &lcp, const t_fanout &f) const {
+            size_type L = s.level, n = level_size(lcp, L), block, until = 0, value, j;
+            if (s.i >= n) { //s.i is past the last block of the level
+                s.phase = DONE;
+                return;
+            }
+            block = f.block_of(s.i, L);
+            if (min_array[L][block] < s.d) { //need to search in the first block
+                until = f.block_start(block + 1, L);
+                if (until > n)
+                    until = n;
+                if ((j = first_smaller(lcp, L, s.i, until, s.d, value)) != until) {
+                    s.i = j;
+                    s.value = value;
+                    found(s);
+                    return;
+                }
+            }
+            if (until == n) { //last block
+                s.phase = DONE;
+                return;
+            }
+            s.i = block + 1; //search following blocks
+            s.level = L + 1;
+            if (s.i < min_array[L].size()) {
+                prefetch_entry(min_array[L + 1], f.block_of(s.i, L + 1));
+                prefetch_level(L + 1, s.i);
+            }
+        }
+
+        //! Same as a call of find_psv_block (bwd_psv for level 0) before it recurses.
+        template<class t_lcp, class t_fanout>
+        void
+        psv_up(search &s, const t_lcp &lcp, const t_fanout &f) const {
+            size_type L = s.level, block, until = level_size(lcp, L), value, j;
+            block = f.block_of(s.i, L);
+            if (min_array[L][block] < s.d) { //need to search in the first block
+                until = f.block_start(block, L);
+                if ((j = last_smaller(lcp, L, until, s.i + 1, s.d, value)) != s.i + 1) {
+                    s.i = j;
+                    s.value = value;
+                    found(s);
+                    return;
+                }
+            }
+            if (until == 0) {
+                s.phase = DONE;
+                return;
+            }
+            s.i = block - 1; //search the other level
+            s.level = L + 1;
+            prefetch_entry(min_array[L + 1], f.block_of(s.i, L + 1));
+            prefetch_level(L + 1, s.i);
+        }
+
+        //! Handles the left partial block of the range [s.i,s.j] of level s.level and moves to
+        //! the blocks in between, which find_rmq_block (rmq for level 0) does by recursion.
+        //! The leftmost min of the left parts is kept, since they are left of everything else,
+        //! and the right parts are handled by rmq_found once there are no blocks in between.
+        template<class t_lcp, class t_fanout>
+        void
+        rmq_up(search &s, const t_lcp &lcp, const t_fanout &f) const {
+            size_type L = s.level, l_block, r_block, until, min_bpos, min_rmq, min_pos;
+            l_block = f.block_of(s.i, L);
+            r_block = f.block_of(s.j, L);
+            //compute left part first
+            until = f.block_start(l_block + 1, L) - 1;
+            if (until > s.j)
+                until = s.j;
+            min_bpos = f.block_start(l_block, L) + pos_array[L][l_block];
+            if (min_bpos >= s.i and min_bpos <= until) {
+                min_rmq = min_array[L][l_block];
+                min_pos = min_bpos;
+            } else {
+                min_rmq = lcp.size();
+                min_pos = leftmost_min(lcp, L, s.i, until + 1, min_rmq);
+            }
+            if (min_rmq < s.left_value) {
+                s.left_value = min_rmq;
+                s.left_level = L;
+                s.left_pos = min_pos;
+            }
+            if (until == s.j or s.left_value == 0) { //case l_block == r_block and if we find a 0
+                rmq_found(s, lcp, f, L);
+                return;
+            }
+            s.right_end[L] = s.j;
+            if (l_block + 1 >= r_block) { //no middle blocks
+                rmq_found(s, lcp, f, L + 1);
+                return;
+            }
+            s.i = l_block + 1;
+            s.j = r_block - 1;
+            s.level = L + 1;
+            prefetch_entry(pos_array[L + 1], f.block_of(s.i, L + 1));
+            prefetch_entry(pos_array[L + 1], f.block_of(s.j, L + 1));
+            prefetch_level(L + 1, s.i);
+        }
+
+        //! Compares the right parts of the levels below `top`, from the top one, which is the
+        //! leftmost, with the min of the left parts, as find_rmq_block does after the recursion,
+        //! and goes down to the LCP from the leftmost min. The entries of the right parts were
+        //! read by rmq_up, so they are not prefetched.
+        template<class t_lcp, class t_fanout>
+        void
+        rmq_found(search &s, const t_lcp &lcp, const t_fanout &f, size_type top) const {
+            size_type min_rmq = s.left_value, r;
+            s.value = s.left_value;
+            s.level = s.left_level;
+            s.i = s.left_pos;
+            for (size_type L = top; L-- > 0 and min_rmq > 0;) {
+                size_type j = s.right_end[L], r_block = f.block_of(j, L), start = f.block_start(r_block, L);
+                if (min_array[L][r_block] >= min_rmq) //the right part has no smaller value
+                    continue;
+                size_type min_bpos = start + pos_array[L][r_block];
+                if (min_bpos <= j) {
+                    min_rmq = min_array[L][r_block];
+                    s.level = L;
+                    s.i = min_bpos;
+                    continue;
+                }
+                if ((r = leftmost_min(lcp, L, start, j + 1, min_rmq)) != j + 1) {
+                    s.level = L;
+                    s.i = r;
+                }
+            }
+            s.value = min_rmq;
+            found(s);
+        }
+
+        //! Moves s from the entry s.i of level s.level to the entry of level s.level - 1
+        //! that the search answers, as fwd_nsv, bwd_psv and rmq do after the recursion.
+        template<class t_lcp, class t_fanout>
+        void
+        down(search &s, const t_lcp &lcp, const t_fanout &f) const {
+            size_type L = s.level - 1, block = s.i, start = f.block_start(block, L), value, j;
+            size_type until = start + pos_array[L][block], end = f.block_start(block + 1, L);
+            s.i = until;
+            if (s.kind == NSV and s.value != s.d - 1) { //look if there is a small value earlier
+                if ((j = first_smaller(lcp, L, start, until, s.d, value)) != until) {
+                    s.i = j;
+                    s.value = value;
+                }
+            } else if (s.kind == PSV) { //look if there is a small value later
+                if ((j = last_smaller(lcp, L, until + 1, end, s.d, value)) != end) {
+                    s.i = j;
+                    s.value = value;
+                }
+            }
+            s.level = L;
+            if (L == 0) {
+                s.result = s.i;
+                s.phase = DONE;
+                return;
+            }
+            prefetch_entry(pos_array[L - 1], s.i);
+            prefetch_level(L - 1, f.block_start(s.i, L - 1));
+        }
+
+        //! Issues a prefetch of the word containing v[idx].
+        static void
+        prefetch_entry(const int_vector_view& v, size_type idx) {
+            __builtin_prefetch(v.data() + (((idx * v.width()) >> 6) << 3));
+        }
+
+        //! Find the first block in the min_array[level] starting from b such
+        //! that contain a value smaller than d.
+        template<class t_fanout>
+        size_type
+        find_nsv_block(const t_fanout &f, size_type d, size_type b, size_type level, size_type &l_value) const {
+            size_type block, until = 0, value, n = min_array[level].size();
+            if (b >= n) //b is past the last block of the level
+                return n;
+            block = f.block_of(b, level + 1); //local block
+            if (min_array[level + 1][block] < d) { //need to search in the first block
+                until = f.block_start(block + 1, level + 1);
+                if (until > n)
+                    until = n;
+                for (size_type j = b; j < until; ++j) {
+                    value = min_array[level][j];
+                    if (value < d) {
+                        l_value = value;
+                        return j;
+                    }
+                }
+            }
+            if (until == n)
+                return n;
+            //search following blocks
+            block = find_nsv_block(f, d, block + 1, level + 1, l_value);
+            if (block == min_array[level + 1].size())
+                return n;
+            until = f.block_start(block, level + 1) + pos_array[level + 1][block];
+            if (l_value == d - 1) //we already found the position of nsv
+                return until;
+            for (size_type j = f.block_start(block, level + 1); j < until; ++j) {
+                value = min_array[level][j];
+                if (value < d) {
+                    l_value = value;
+                    return j;
+                }
+            }
+            return until; // the smaller value was the one pointed
+        }
+
+        //! Find the last block in the min_array[level] between [0,b] such
+        //! that contain a value smaller than d.
+        template<class t_fanout>
+        size_type
+        find_psv_block(const t_fanout &f, size_type d, size_type b, size_type level, size_type &l_value) const {
+            size_type block, until = min_array[level].size(), value, n = min_array[level].size();
+            block = f.block_of(b, level + 1);
+            if (min_array[level + 1][block] < d) { //need to search in the first block
+                until = f.block_start(block, level + 1);
+                for (size_type j = b; j >= until; --j) {
+                    value = min_array[level][j];
+                    if (value < d) {
+                        l_value = value;
+                        return j;
+                    }
+                }
+            }
+            if (until == 0)
+                return n;
+            block = find_psv_block(f, d, block - 1, level + 1, l_value); //search the other level
+            if (block == min_array[level + 1].size())
+                return n;
+            until = f.block_start(block, level + 1) + pos_array[level + 1][block];
+            for (size_type j = f.block_start(block + 1, level + 1) - 1; j > until; --j) {
+                value = min_array[level][j];
+                if (value < d) {
+                    l_value = value;
+                    return j;
+                }
+            }
+            return until; // the smaller value was the one pointed
+        }
+
+        //! Find the minimum value between the blocks i and j at "level", where n is the size of the LCP.
+        template<class t_fanout>
+        size_type
+        find_rmq_block(const t_fanout &f, size_type n, size_type i, size_type j, size_type &l_value, size_type level) const {
+            size_type r_block, l_block, value, until, min_bpos, block;
+            size_type min_rmq = n, min_pos = i, aux_rmq;
+            l_block = f.block_of(i, level + 1);
+            r_block = f.block_of(j, level + 1);
+            //compute left part first
+            until = f.block_start(l_block + 1, level + 1) - 1;
+            if (until > j)
+                until = j;
+            min_bpos = f.block_start(l_block, level + 1) + pos_array[level + 1][l_block];
+            if (min_bpos >= i and min_bpos <= until) {
+                min_rmq = min_array[level + 1][l_block];
+                min_pos = min_bpos;
+            } else {
+                for (size_type r = i; r <= until; ++r) {
+                    value = min_array[level][r];
+                    if (value < min_rmq) {
+                        min_rmq = value;
+                        min_pos = r;
+                        if (min_rmq == 0)
+                            break;
+                    }
+                }
+            }
+            if (until == j or min_rmq == 0) {  //case l_block == r_block and if we find a 0
+                l_value = min_rmq;
+                return min_pos;
+            }
+            l_block++;
+            if (l_block < r_block) { //compute middle section
+                block = find_rmq_block(f, n, l_block, r_block - 1, aux_rmq, level + 1);
+                if (aux_rmq < min_rmq) {
+                    min_rmq = aux_rmq;
+                    min_pos = f.block_start(block, level + 1) + pos_array[level + 1][block];
+                    if (min_rmq == 0) {
+                        l_value = min_rmq;
+                        return min_pos;
+                    }
+                }
+            }
+            //compute min right block
+            until = j;
+            min_bpos = f.block_start(r_block, level + 1) + pos_array[level + 1][r_block];
+            if (min_array[level + 1][r_block] < min_rmq) {
+                if (min_bpos <= until) {
+                    l_value = min_array[level + 1][r_block];
+                    return min_bpos;
+                } else {
+                    for (size_type r = f.block_start(r_block, level + 1); r <= until; ++r) {
+                        value = min_array[level][r];
+                        if (value < min_rmq) {
+                            min_rmq = value;
+                            min_pos = r;
+                            if (min_rmq == 0)
+                                break;
+                        }
+                    }
+                }
+            }
+            l_value = min_rmq;
+            return min_pos;
+        }
+
+    }; //end class
+
+}
+
+#endif //CST_CN_NPR_CN_TREE_H
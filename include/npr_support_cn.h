@@ -16,8 +16,12 @@ along with this program.  If not, see http://www.gnu.org/licenses/ .
 #define CCST_CN_NPR_CN_SUPPORT_H
 
 #include "npr.h"
+#include "npr_cn_tree.h"
+#include "sectioned_file.h"
 #include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
 #include <vector>
+#include <string>
 
 using namespace sdsl;
 
@@ -27,17 +31,23 @@ namespace cstds {
     /*!
     * \tparam t_lcp     Type of the Underlying LCP.
     * \tparam bloc_size Block size used got the npr_cn tree
+    * \tparam t_size    Type of the positions and values of the queries (see cst_cn).
     * \par Reference
     *   Rodrigo Canovas  and Gonzalo Navarro
     *   Practical compressed suffix trees
     *   SEA 2010: 94-105
+    *
+    * The query methods are const and do not use shared scratch space, so they can be
+    * called concurrently from several threads.
     */
-    template<class t_lcp = sdsl::lcp_dac<>, uint8_t block_size = 32, uint8_t sbs = 8>
+    template<class t_lcp = sdsl::lcp_dac<>, uint8_t block_size = 32, uint8_t sbs = 8,
+            class t_size = sdsl::int_vector<>::size_type>
     class _npr_support_cn {
 
     public:
-        typedef sdsl::int_vector<>::size_type size_type;
+        typedef t_size size_type;
         typedef t_lcp lcp_type;
+        typedef typename npr_cn_tree<t_size>::search search_type; //query computed by step
 
         // inner class which is used in CSTs to parametrize npr classes
         // with information about the CST.
@@ -47,16 +57,15 @@ namespace cstds {
         };
 
     private:
-        const lcp_type *m_lcp;
-        std::vector<sdsl::int_vector<> > min_array; //array for each level that contain the min value of each block
-        std::vector<sdsl::int_vector<> > pos_array; //array for each level that contain the local position of the min value of each block
+        typedef npr_fanout_fixed<block_size> fanout_type;
 
+        const lcp_type *m_lcp;
+        npr_cn_tree<t_size> m_tree; //levels of the npr tree, with fanout block_size
 
         void
         copy(const _npr_support_cn &npr_c) {
             m_lcp = npr_c.m_lcp;
-            min_array = npr_c.min_array;
-            pos_array = npr_c.pos_array;
+            m_tree = npr_c.m_tree;
         }
 
     public:
@@ -74,60 +83,19 @@ namespace cstds {
             *this = std::move(npr_c);
         }
 
-        //! Constructor. Note that sbs is not used for this version
-        _npr_support_cn(const t_lcp *f_lcp) {
+        //! Constructor. Note that sbs is not used for this version.
+        //! The blocks of each level are computed by up to `threads` threads.
+        _npr_support_cn(const t_lcp *f_lcp, size_type threads = 1) {
             set_lcp(f_lcp); //assign lcp to be used
-            //construct data
-            size_type tmp_min, min, tmp_pos, tmp_start, b_size = block_size;
-            size_type n = m_lcp->size();
-            size_type n_levels = (size_type) (ceil(log(n) / log(block_size)));
-            size_type level_size = (size_type) ((n + block_size - 1) / block_size);
-            size_type last_level_size = n;
-            size_type bits_pos = bits::hi(block_size) + 1;
-            size_type bits_min = bits::hi(n) + 1;
-            min_array.resize(n_levels);
-            pos_array.resize(n_levels);
-            //create first level
-            min_array[0] = int_vector<>(level_size, 0, bits_min);
-            pos_array[0] = int_vector<>(level_size, 0, bits_pos);
-            for (size_type i = 0; i < level_size; ++i) {
-                min = n;
-                tmp_start = i * block_size;
-                if (tmp_start + block_size >= last_level_size)
-                    b_size = last_level_size - tmp_start;
-                for (size_type j = 0; j < b_size; j++) {
-                    tmp_min = (*m_lcp)[tmp_start + j];
-                    if (tmp_min < min) {
-                        min = tmp_min;
-                        tmp_pos = j;
-                    }
-                }
-                min_array[0][i] = min;
-                pos_array[0][i] = tmp_pos;
-            }
-            //create the other levels
-            for (size_type r = 1; r < n_levels; ++r) {
-                last_level_size = level_size;
-                level_size = (level_size + block_size - 1) / block_size;
-                min_array[r] = int_vector<>(level_size, 0, bits_min);
-                pos_array[r] = int_vector<>(level_size, 0, bits_pos);
-                b_size = block_size;
-                for (size_type i = 0; i < level_size; ++i) {
-                    min = n;
-                    tmp_start = i * block_size;
-                    if (tmp_start + block_size >= last_level_size)
-                        b_size = last_level_size - tmp_start;
-                    for (size_type j = 0; j < b_size; j++) {
-                        tmp_min = min_array[r - 1][tmp_start + j];
-                        if (tmp_min < min) {
-                            min = tmp_min;
-                            tmp_pos = j;
-                        }
-                    }
-                    min_array[r][i] = min;
-                    pos_array[r][i] = tmp_pos;
-                }
-            }
+            create_levels(threads, [&]() -> const t_lcp& { return *m_lcp; });
+        }
+
+        //! Constructor that reads the first level from the plain LCP array stored in lcp_file
+        //! (an int_vector written by sdsl) instead of from *f_lcp. Each thread streams its own
+        //! range of the file, so the LCP is not accessed at random while building.
+        _npr_support_cn(const t_lcp *f_lcp, const std::string& lcp_file, size_type threads = 1) {
+            set_lcp(f_lcp); //assign lcp to be used
+            create_levels(threads, [&]() { return int_vector_buffer<>(lcp_file, std::ios::in); });
         }
 
         void
@@ -144,8 +112,7 @@ namespace cstds {
         //! Swap method for _npr_support_cn
         void
         swap(_npr_support_cn &npr_c) {
-            min_array.swap(npr_c.min_array);
-            pos_array.swap(npr_c.pos_array);
+            m_tree.swap(npr_c.m_tree);
         }
 
         //! Assignment Operator.
@@ -160,23 +127,16 @@ namespace cstds {
         _npr_support_cn &operator=(_npr_support_cn &&npr_c) {
             if (this != &npr_c) {
                 m_lcp = std::move(npr_c.m_lcp);
-                min_array = std::move(npr_c.min_array);
-                pos_array = std::move(npr_c.pos_array);
+                m_tree = std::move(npr_c.m_tree);
             }
             return *this;
         }
 
         //! Serialize to a stream.
-        size_type
+        uint64_t
         serialize(std::ostream &out, structure_tree_node *v = nullptr, std::string name = "") const {
             structure_tree_node *child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
-            size_type levels = min_array.size();
-            size_type written_bytes = 0;
-            written_bytes += write_member(levels, out, child, "levels");
-            for (size_type i = 0; i < levels; ++i) {
-                written_bytes += min_array[i].serialize(out, child, "min level");
-                written_bytes += pos_array[i].serialize(out, child, "pos level");
-            }
+            uint64_t written_bytes = m_tree.serialize(out, child);
             structure_tree::add_size(child, written_bytes);
             //std::cout << "NPR uses: " << (written_bytes * 8.0) / m_lcp->size() << "n bits" << std::endl;
             return written_bytes;
@@ -185,15 +145,8 @@ namespace cstds {
         //! Load from a stream.
         void
         load(std::istream &in, const t_lcp *llcp = nullptr) {
-            size_type levels = 0;
             m_lcp = llcp;
-            read_member(levels, in);
-            min_array.resize(levels);
-            pos_array.resize(levels);
-            for (size_type i = 0; i < levels; ++i) {
-                min_array[i].load(in);
-                pos_array[i].load(in);
-            }
+            m_tree.load(in);
         }
 
 //FUNCTIONS
@@ -209,39 +162,7 @@ namespace cstds {
         //! Get the position of the next smaller value than d starting from i.
         size_type
         fwd_nsv(size_type i,  size_type d, size_type &l_value) const {
-            size_type block, until = 0, value, n = m_lcp->size();
-            l_value = n; //not found yet
-            if (d == 0 or i > n - 1)
-                return n;
-            block = i / block_size;
-            if (min_array[0][block] < d) { //need to search in the first block
-                until = block_size * (block + 1);
-                if (until > n)
-                    until = n;
-                for (size_type j = i; j < until; ++j) {
-                    value = (*m_lcp)[j];
-                    if (value < d) {
-                        l_value = value;
-                        return j;
-                    }
-                }
-            }
-            if (until == n)  //last block
-                return n;
-            block = find_nsv_block(d, block + 1, 0, l_value); //need to find block containing a value smaller than d
-            if (block == min_array[0].size())
-                return n;
-            until = block * block_size + pos_array[0][block];
-            if (l_value == d - 1) //we already found the position of nsv
-                return until;
-            for (size_type j = block * block_size; j < until; ++j) { //look if there is a small value earlier
-                value = (*m_lcp)[j];
-                if (value < d) {
-                    l_value = value;
-                    return j;
-                }
-            }
-            return until; // it was the last one
+            return m_tree.fwd_nsv(*m_lcp, fanout_type(), i, d, l_value);
         }
 
         //! Get the position of the previous smaller value than LCP[i] within [0,i-1]
@@ -260,241 +181,49 @@ namespace cstds {
         //! Get the position of the previous smaller value than d starting from i.
         size_type
         bwd_psv(size_type i,  size_type d, size_type &l_value) const {
-            size_type block, value, n;
-            size_type until = m_lcp->size();
-            l_value = n = until; // not found yet
-            if (d == 0)
-                return n;
-            block = i / block_size;
-            if (min_array[0][block] < d) { //need to search in the first block
-                until = block_size * block;
-                for (size_type j = i; j >= until; --j) {
-                    value = (*m_lcp)[j];
-                    if (value < d) {
-                        l_value = value;
-                        return j;
-                    }
-                }
-            }
-            if (until == 0)
-                return n;
-            block = find_psv_block(d, block - 1, 0, l_value); //need to find block containing a value smaller than d
-            if (block == min_array[0].size())
-                return n;
-            until = block * block_size + pos_array[0][block];
-            for (size_type j = (block + 1) * block_size - 1; j > until; --j) { //look if there is a small value earlier
-                value = (*m_lcp)[j];
-                if (value < d) {
-                    l_value = value;
-                    return j;
-                }
-            }
-            return until; // the smaller value was the one pointed
+            return m_tree.bwd_psv(*m_lcp, fanout_type(), i, d, l_value);
         }
 
         //! Get the left most position of the minimum value in the interval [i,j].
         //! We assumed that always 0 <= i <= j < n.
         size_type
         rmq(size_type i, size_type j, size_type &l_value) const {
-            size_type r_block, l_block, value, until, min_bpos, block;
-            size_type min_rmq = m_lcp->size(), min_pos, aux_rmq;
-            l_block = i / block_size;
-            r_block = j / block_size;
-            //compute left block first
-            until = (l_block + 1) * block_size - 1;
-            if (until > j)
-                until = j;
-            min_bpos = l_block * block_size + pos_array[0][l_block]; //position of the min in the block
-            if (min_bpos >= i and min_bpos <= until) {
-                min_rmq = min_array[0][l_block];
-                min_pos = min_bpos;
-            }
-            else {
-                for (size_type r = i; r <= until; ++r) {
-                    value = (*m_lcp)[r];
-                    if (value < min_rmq) {
-                        min_rmq = value;
-                        min_pos = r;
-                        if (min_rmq == 0)
-                            break;
-                    }
-                }
-            }
-            if (until == j or min_rmq == 0) {  //case left_block == right_block and if we find a 0
-                l_value = min_rmq;
-                return min_pos;
-            }
-            l_block++;
-            //compute middle blocks
-            if (l_block < r_block) {
-                block = find_rmq_block(l_block, r_block - 1, aux_rmq, 0);
-                if (aux_rmq < min_rmq) {
-                    min_rmq = aux_rmq;
-                    min_pos = block * block_size + pos_array[0][block];
-                    if (min_rmq == 0) {
-                        l_value = min_rmq;
-                        return min_pos;
-                    }
-                }
-            }
-            //compute min right block
-            until = j;
-            min_bpos = r_block * block_size + pos_array[0][r_block];
-            if (min_array[0][r_block] < min_rmq) {
-                if (min_bpos <= until) {
-                    l_value = min_array[0][r_block];
-                    return min_bpos;
-                } else {
-                    for (size_type r = r_block * block_size; r <= until; ++r) {
-                        value = (*m_lcp)[r];
-                        if (value < min_rmq) {
-                            min_rmq = value;
-                            min_pos = r;
-                            if (min_rmq == 0)
-                                break;
-                        }
-                    }
-                }
-            }
-            l_value = min_rmq;
-            return min_pos;
+            return m_tree.rmq(*m_lcp, fanout_type(), i, j, l_value);
         }
 
-    private:
+        //! Starts s as fwd_nsv(i, d), answered by calls of step.
+        void
+        start_fwd_nsv(search_type &s, size_type i, size_type d) const {
+            m_tree.start_fwd_nsv(s, *m_lcp, fanout_type(), i, d);
+        }
 
-        //! Find the first block in the min_array[level] starting from b such
-        //! that contain a value smaller than d.
-        size_type
-        find_nsv_block(size_type  d, size_type b, size_type level, size_type &l_value) const {
-            size_type block, until = 0, value, n = min_array[level].size();
-            block = b / block_size; //local block
-            if (min_array[level + 1][block] < d) { //need to search in the first block
-                until = block_size * (block + 1);
-                if (until > n)
-                    until = n;
-                for (size_type j = b; j < until; ++j) {
-                    value = min_array[level][j];
-                    if (value < d) {
-                        l_value = value;
-                        return j;
-                    }
-                }
-            }
-            if (until == n)
-                return n;
-            //search following blocks
-            block = find_nsv_block(d, block + 1, level + 1, l_value);
-            if (block == min_array[level + 1].size())
-                return n;
-            until = block * block_size + pos_array[level + 1][block];
-            if (l_value == d - 1) //we already found the position of nsv
-                return until;
-            for (size_type j = block * block_size; j < until; ++j) {
-                value = min_array[level][j];
-                if (value < d) {
-                    l_value = value;
-                    return j;
-                }
-            }
-            return until; // the smaller value was the one pointed
+        //! Starts s as bwd_psv(i, d), answered by calls of step.
+        void
+        start_bwd_psv(search_type &s, size_type i, size_type d) const {
+            m_tree.start_bwd_psv(s, *m_lcp, fanout_type(), i, d);
         }
 
-        //! Find the last block in the min_array[level] between [0,b] such
-        //! that contain a value smaller than d.
-        size_type
-        find_psv_block(size_type  d, size_type b, size_type level, size_type &l_value) const {
-            size_type block, until = min_array[level].size(), value, n = min_array[level].size();
-            block = b / block_size;
-            if (min_array[level + 1][block] < d) { //need to search in the first block
-                until = block_size * block;
-                for (size_type j = b; j >= until; --j) {
-                    value = min_array[level][j];
-                    if (value < d) {
-                        l_value = value;
-                        return j;
-                    }
-                }
-            }
-            if (until == 0)
-                return n;
-            block = find_psv_block(d, block - 1, level + 1, l_value); //search the other level
-            if (block == min_array[level + 1].size())
-                return n;
-            until = block * block_size + pos_array[level + 1][block];
-            for (size_type j = (block + 1) * block_size - 1; j > until; --j) {
-                value = min_array[level][j];
-                if (value < d) {
-                    l_value = value;
-                    return j;
-                }
-            }
-            return until; // the smaller value was the one pointed
+        //! Starts s as rmq(i, j), answered by calls of step.
+        void
+        start_rmq(search_type &s, size_type i, size_type j) const {
+            m_tree.start_rmq(s, *m_lcp, fanout_type(), i, j);
         }
 
+        //! Computes one level of the search s and prefetches what the next step reads.
+        //! Returns true when s.result and s.value hold its answer.
+        bool
+        step(search_type &s) const {
+            return m_tree.step(s, *m_lcp, fanout_type());
+        }
 
-        //! Find the minimum value between the blocks i and j at "level"
-        size_type
-        find_rmq_block(size_type i, size_type j, size_type &l_value, size_type level) const {
-            size_type r_block, l_block, value, until, min_bpos, block;
-            size_type min_rmq = m_lcp->size(), min_pos, aux_rmq;
-            l_block = i / block_size;
-            r_block = j / block_size;
-            //compute left part first
-            until = (l_block + 1) * block_size - 1;
-            if (until > j)
-                until = j;
-            min_bpos = l_block * block_size + pos_array[level + 1][l_block];
-            if (min_bpos >= i and min_bpos <= until) {
-                min_rmq = min_array[level + 1][l_block];
-                min_pos = min_bpos;
-            } else {
-                for (size_type r = i; r <= until; ++r) {
-                    value = min_array[level][r];
-                    if (value < min_rmq) {
-                        min_rmq = value;
-                        min_pos = r;
-                        if (min_rmq == 0)
-                            break;
-                    }
-                }
-            }
-            if (until == j or min_rmq == 0) {  //case l_block == r_block and if we find a 0
-                l_value = min_rmq;
-                return min_pos;
-            }
-            l_block++;
-            if (l_block < r_block) { //compute middle section
-                block = find_rmq_block(l_block, r_block - 1, aux_rmq, level + 1);
-                if (aux_rmq < min_rmq) {
-                    min_rmq = aux_rmq;
-                    min_pos = block * block_size + pos_array[level + 1][block];
-                    if (min_rmq == 0) {
-                        l_value = min_rmq;
-                        return min_pos;
-                    }
-                }
-            }
-            //compute min right block
-            until = j;
-            min_bpos = r_block * block_size + pos_array[level + 1][r_block];
-            if (min_array[level + 1][r_block] < min_rmq) {
-                if (min_bpos <= until) {
-                    l_value = min_array[level + 1][r_block];
-                    return min_bpos;
-                } else {
-                    for (size_type r = r_block * block_size; r <= until; ++r) {
-                        value = min_array[level][r];
-                        if (value < min_rmq) {
-                            min_rmq = value;
-                            min_pos = r;
-                            if (min_rmq == 0)
-                                break;
-                        }
-                    }
-                }
-            }
-            l_value = min_rmq;
-            return min_pos;
+    private:
+
+        //! Builds all the levels. source() returns the values of the LCP used for the first
+        //! level; it is called once per thread so each one can have its own reader.
+        template<class t_source>
+        void
+        create_levels(size_type threads, t_source source) {
+            m_tree.create_levels(m_lcp->size(), threads, [](size_type) { return (size_type) block_size; }, source);
         }
 
     }; //end class
@@ -502,7 +231,15 @@ namespace cstds {
     //! Helper class which provides _npr_support_cn the context of a LCP.
     struct npr_support_cn {
         template<class t_cst, uint8_t block_size, uint8_t sbs>
-        using type = _npr_support_cn<typename t_cst::lcp_type, block_size, sbs>;
+        using type = _npr_support_cn<typename t_cst::lcp_type, block_size, sbs, typename t_cst::size_type>;
+    };
+
+    template<>
+    struct format_tag<npr_support_cn> {
+        static std::string
+        name() {
+            return "npr_cn";
+        }
     };
 
 }
@@ -0,0 +1,378 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+#ifndef CCST_CN_NPR_CN_DYN_SUPPORT_H
+#define CCST_CN_NPR_CN_DYN_SUPPORT_H
+
+#include "npr_cn_tree.h"
+#include "sectioned_file.h"
+#include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace sdsl;
+
+namespace cstds {
+
+    //! The NPR of Canovas and Navarro with the fanout of each level chosen when it is built.
+    /*!
+    * Same structure as _npr_support_cn, but the block size of each level (its fanout) is a
+    * power of two stored in the serialized index, so one binary can build and load any of
+    * them. Level r keeps the minimum (and its local position) of each block of fanout[r]
+    * consecutive entries of level r-1, where level -1 is the LCP array. The fanouts are
+    * given as a list, e.g. {8, 8, 16, 64}, and the levels above the end of the list reuse
+    * its last fanout, so a single block size gives the same tree as _npr_support_cn. Small
+    * fanouts at the bottom levels reduce the LCP accesses of each query, while large fanouts
+    * at the top, which are small, reduce the number of levels visited.
+    * The queries of npr_cn_tree are dispatched once to a version specialized for a single
+    * block size of 8, 16, 32 or 64, where the block computations are constants; the other
+    * trees use a version based on the shift of each level.
+    * \tparam t_lcp          Type of the Underlying LCP.
+    * \tparam t_default_bs   Block size used when none is given to the constructor.
+    * \tparam t_size         Type of the positions and values of the queries (see cst_cn).
+    *
+    * The query methods are const and do not use shared scratch space, so they can be
+    * called concurrently from several threads.
+    */
+    template<class t_lcp = sdsl::lcp_dac<>, uint8_t t_default_bs = 32,
+            class t_size = sdsl::int_vector<>::size_type>
+    class _npr_support_cn_dyn {
+
+    public:
+        typedef t_size size_type;
+        typedef t_lcp lcp_type;
+        typedef typename npr_cn_tree<t_size>::search search_type; //query computed by step
+
+        // inner class which is used in CSTs to parametrize npr classes
+        // with information about the CST.
+        template<class Cst>
+        struct type {
+            typedef _npr_support_cn_dyn npr_type;
+        };
+
+    private:
+        const lcp_type *m_lcp;
+        sdsl::int_vector<8> m_shift; //log2 of the fanout of each level
+        uint64_t m_bs = 0; //fanout of all the levels, or 0 if they do not have the same one
+        npr_cn_tree<t_size> m_tree; //levels of the npr tree
+
+        void
+        copy(const _npr_support_cn_dyn &npr_c) {
+            m_lcp = npr_c.m_lcp;
+            m_shift = npr_c.m_shift;
+            m_bs = npr_c.m_bs;
+            m_tree = npr_c.m_tree;
+        }
+
+    public:
+
+        //! Default Constructor
+        _npr_support_cn_dyn() {}
+
+        //! Copy constructor
+        _npr_support_cn_dyn(const _npr_support_cn_dyn &npr_c) {
+            copy(npr_c);
+        }
+
+        //! Move constructor
+        _npr_support_cn_dyn(_npr_support_cn_dyn &&npr_c) {
+            *this = std::move(npr_c);
+        }
+
+        //! Constructor with the same block_size in all the levels. block_size must be a power
+        //! of two in [2,256] (see valid_block_size), otherwise std::invalid_argument is thrown.
+        //! The blocks of each level are computed by up to `threads` threads.
+        _npr_support_cn_dyn(const t_lcp *f_lcp, size_type threads = 1, size_type block_size = t_default_bs) {
+            set_lcp(f_lcp); //assign lcp to be used
+            create_levels(threads, {block_size}, [&]() -> const t_lcp& { return *m_lcp; });
+        }
+
+        //! Constructor with the fanout of each level, from the bottom one. It throws
+        //! std::invalid_argument if fanout is empty or has a value that is not a valid block size.
+        _npr_support_cn_dyn(const t_lcp *f_lcp, size_type threads, const std::vector<uint64_t>& fanout) {
+            set_lcp(f_lcp); //assign lcp to be used
+            create_levels(threads, fanout, [&]() -> const t_lcp& { return *m_lcp; });
+        }
+
+        //! Constructor that reads the first level from the plain LCP array stored in lcp_file.
+        _npr_support_cn_dyn(const t_lcp *f_lcp, const std::string& lcp_file, size_type threads = 1,
+                            size_type block_size = t_default_bs) {
+            set_lcp(f_lcp); //assign lcp to be used
+            create_levels(threads, {block_size}, [&]() { return int_vector_buffer<>(lcp_file, std::ios::in); });
+        }
+
+        //! Constructor with the fanout of each level that reads the first level from lcp_file.
+        _npr_support_cn_dyn(const t_lcp *f_lcp, const std::string& lcp_file, size_type threads,
+                            const std::vector<uint64_t>& fanout) {
+            set_lcp(f_lcp); //assign lcp to be used
+            create_levels(threads, fanout, [&]() { return int_vector_buffer<>(lcp_file, std::ios::in); });
+        }
+
+        void
+        set_lcp(const t_lcp *f_lcp) {
+            m_lcp = f_lcp;
+        }
+
+        //! Block size of the first level of the NPR tree.
+        size_type
+        block_size() const {
+            return m_shift.empty() ? t_default_bs : (size_type)1 << m_shift[0];
+        }
+
+        //! Fanout of each level of the NPR tree, from the bottom one.
+        std::vector<uint64_t>
+        fanout() const {
+            std::vector<uint64_t> res;
+            for (size_type r = 0; r < m_shift.size(); ++r)
+                res.push_back((uint64_t)1 << m_shift[r]);
+            return res;
+        }
+
+        //! Returns true if block_size can be used: a power of two in [2,256].
+        static bool
+        valid_block_size(uint64_t block_size) {
+            return block_size >= 2 and block_size <= 256 and (block_size & (block_size - 1)) == 0;
+        }
+
+        //! Returns if the data structure is empty.
+        bool
+        empty() const {
+            return m_lcp->empty();
+        }
+
+        //! Swap method for _npr_support_cn_dyn
+        void
+        swap(_npr_support_cn_dyn &npr_c) {
+            m_shift.swap(npr_c.m_shift);
+            std::swap(m_bs, npr_c.m_bs);
+            m_tree.swap(npr_c.m_tree);
+        }
+
+        //! Assignment Operator.
+        _npr_support_cn_dyn &operator=(const _npr_support_cn_dyn &npr_c) {
+            if (this != &npr_c) {
+                copy(npr_c);
+            }
+            return *this;
+        }
+
+        //! Assignment Move Operator.
+        _npr_support_cn_dyn &operator=(_npr_support_cn_dyn &&npr_c) {
+            if (this != &npr_c) {
+                m_lcp = std::move(npr_c.m_lcp);
+                m_shift = std::move(npr_c.m_shift);
+                m_bs = npr_c.m_bs;
+                m_tree = std::move(npr_c.m_tree);
+            }
+            return *this;
+        }
+
+        //! Serialize to a stream.
+        uint64_t
+        serialize(std::ostream &out, structure_tree_node *v = nullptr, std::string name = "") const {
+            structure_tree_node *child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+            uint64_t written_bytes = 0;
+            written_bytes += m_shift.serialize(out, child, "shift");
+            written_bytes += m_tree.serialize(out, child);
+            structure_tree::add_size(child, written_bytes);
+            return written_bytes;
+        }
+
+        //! Load from a stream. If the stored fanouts are not valid (e.g. the stream is not
+        //! placed at a _npr_support_cn_dyn) or do not match the levels, the failbit of in is set.
+        void
+        load(std::istream &in, const t_lcp *llcp = nullptr) {
+            m_lcp = llcp;
+            m_shift.load(in);
+            bool valid = in and !m_shift.empty() and m_shift.size() <= 64;
+            for (size_type r = 0; valid and r < m_shift.size(); ++r)
+                valid = m_shift[r] >= 1 and m_shift[r] <= 8;
+            if (!valid) {
+                m_shift = int_vector<8>();
+                m_tree.clear();
+                in.setstate(std::ios::failbit);
+                return;
+            }
+            m_tree.load(in);
+            if (m_tree.levels() != m_shift.size())
+                in.setstate(std::ios::failbit);
+            set_block_size();
+        }
+
+//FUNCTIONS
+        //! Get the position of the next smaller value than LCP[i] within [i+1,n]
+        //! Also returns the value found in l_value.
+        size_type
+        nsv(size_type i, size_type &l_value) const {
+            size_type value_v = (*m_lcp)[i];
+            return fwd_nsv(i + 1,  value_v, l_value);
+        }
+
+        //! Get the position of the next smaller value than d starting from i.
+        size_type
+        fwd_nsv(size_type i,  size_type d, size_type &l_value) const {
+            switch (m_bs) {
+                case 8:  return m_tree.fwd_nsv(*m_lcp, npr_fanout_fixed<8>(), i, d, l_value);
+                case 16: return m_tree.fwd_nsv(*m_lcp, npr_fanout_fixed<16>(), i, d, l_value);
+                case 32: return m_tree.fwd_nsv(*m_lcp, npr_fanout_fixed<32>(), i, d, l_value);
+                case 64: return m_tree.fwd_nsv(*m_lcp, npr_fanout_fixed<64>(), i, d, l_value);
+                default: return m_tree.fwd_nsv(*m_lcp, npr_fanout_levels{m_shift}, i, d, l_value);
+            }
+        }
+
+        //! Get the position of the previous smaller value than LCP[i] within [0,i-1]
+        //! Also returns the value found in l_value.
+        size_type
+        psv(size_type i, size_type &l_value) const {
+            size_type value = m_lcp->size();
+            if (i == 0) {
+                l_value = value;
+                return value;
+            }
+            value = (*m_lcp)[i];
+            return bwd_psv(i - 1,  value, l_value);
+        }
+
+        //! Get the position of the previous smaller value than d starting from i.
+        size_type
+        bwd_psv(size_type i,  size_type d, size_type &l_value) const {
+            switch (m_bs) {
+                case 8:  return m_tree.bwd_psv(*m_lcp, npr_fanout_fixed<8>(), i, d, l_value);
+                case 16: return m_tree.bwd_psv(*m_lcp, npr_fanout_fixed<16>(), i, d, l_value);
+                case 32: return m_tree.bwd_psv(*m_lcp, npr_fanout_fixed<32>(), i, d, l_value);
+                case 64: return m_tree.bwd_psv(*m_lcp, npr_fanout_fixed<64>(), i, d, l_value);
+                default: return m_tree.bwd_psv(*m_lcp, npr_fanout_levels{m_shift}, i, d, l_value);
+            }
+        }
+
+        //! Get the left most position of the minimum value in the interval [i,j].
+        //! We assumed that always 0 <= i <= j < n.
+        size_type
+        rmq(size_type i, size_type j, size_type &l_value) const {
+            switch (m_bs) {
+                case 8:  return m_tree.rmq(*m_lcp, npr_fanout_fixed<8>(), i, j, l_value);
+                case 16: return m_tree.rmq(*m_lcp, npr_fanout_fixed<16>(), i, j, l_value);
+                case 32: return m_tree.rmq(*m_lcp, npr_fanout_fixed<32>(), i, j, l_value);
+                case 64: return m_tree.rmq(*m_lcp, npr_fanout_fixed<64>(), i, j, l_value);
+                default: return m_tree.rmq(*m_lcp, npr_fanout_levels{m_shift}, i, j, l_value);
+            }
+        }
+
+        //! Starts s as fwd_nsv(i, d), answered by calls of step.
+        void
+        start_fwd_nsv(search_type &s, size_type i, size_type d) const {
+            switch (m_bs) {
+                case 8:  return m_tree.start_fwd_nsv(s, *m_lcp, npr_fanout_fixed<8>(), i, d);
+                case 16: return m_tree.start_fwd_nsv(s, *m_lcp, npr_fanout_fixed<16>(), i, d);
+                case 32: return m_tree.start_fwd_nsv(s, *m_lcp, npr_fanout_fixed<32>(), i, d);
+                case 64: return m_tree.start_fwd_nsv(s, *m_lcp, npr_fanout_fixed<64>(), i, d);
+                default: return m_tree.start_fwd_nsv(s, *m_lcp, npr_fanout_levels{m_shift}, i, d);
+            }
+        }
+
+        //! Starts s as bwd_psv(i, d), answered by calls of step.
+        void
+        start_bwd_psv(search_type &s, size_type i, size_type d) const {
+            switch (m_bs) {
+                case 8:  return m_tree.start_bwd_psv(s, *m_lcp, npr_fanout_fixed<8>(), i, d);
+                case 16: return m_tree.start_bwd_psv(s, *m_lcp, npr_fanout_fixed<16>(), i, d);
+                case 32: return m_tree.start_bwd_psv(s, *m_lcp, npr_fanout_fixed<32>(), i, d);
+                case 64: return m_tree.start_bwd_psv(s, *m_lcp, npr_fanout_fixed<64>(), i, d);
+                default: return m_tree.start_bwd_psv(s, *m_lcp, npr_fanout_levels{m_shift}, i, d);
+            }
+        }
+
+        //! Starts s as rmq(i, j), answered by calls of step.
+        void
+        start_rmq(search_type &s, size_type i, size_type j) const {
+            switch (m_bs) {
+                case 8:  return m_tree.start_rmq(s, *m_lcp, npr_fanout_fixed<8>(), i, j);
+                case 16: return m_tree.start_rmq(s, *m_lcp, npr_fanout_fixed<16>(), i, j);
+                case 32: return m_tree.start_rmq(s, *m_lcp, npr_fanout_fixed<32>(), i, j);
+                case 64: return m_tree.start_rmq(s, *m_lcp, npr_fanout_fixed<64>(), i, j);
+                default: return m_tree.start_rmq(s, *m_lcp, npr_fanout_levels{m_shift}, i, j);
+            }
+        }
+
+        //! Computes one level of the search s and prefetches what the next step reads.
+        //! Returns true when s.result and s.value hold its answer.
+        bool
+        step(search_type &s) const {
+            switch (m_bs) {
+                case 8:  return m_tree.step(s, *m_lcp, npr_fanout_fixed<8>());
+                case 16: return m_tree.step(s, *m_lcp, npr_fanout_fixed<16>());
+                case 32: return m_tree.step(s, *m_lcp, npr_fanout_fixed<32>());
+                case 64: return m_tree.step(s, *m_lcp, npr_fanout_fixed<64>());
+                default: return m_tree.step(s, *m_lcp, npr_fanout_levels{m_shift});
+            }
+        }
+
+    private:
+
+        //! Sets m_bs from m_shift.
+        void
+        set_block_size() {
+            m_bs = (uint64_t)1 << m_shift[0];
+            for (size_type r = 1; r < m_shift.size(); ++r)
+                if (m_shift[r] != m_shift[0])
+                    m_bs = 0;
+        }
+
+        //! Builds the levels until one of them has a single block, taking the fanout of
+        //! level r from fanout[r] (or the last one). source() returns the values of the LCP
+        //! used for the first level; it is called once per thread so each one can have its own reader.
+        template<class t_source>
+        void
+        create_levels(size_type threads, const std::vector<uint64_t>& fanout, t_source source) {
+            if (fanout.empty())
+                throw std::invalid_argument("npr_support_cn_dyn: the list of fanouts is empty");
+            for (uint64_t f : fanout) {
+                if (!valid_block_size(f))
+                    throw std::invalid_argument("npr_support_cn_dyn: the fanout " + std::to_string(f) +
+                                                " is not a power of two in [2,256]");
+            }
+            std::vector<uint8_t> shift;
+            m_tree.create_levels(m_lcp->size(), threads, [&](size_type r) {
+                shift.push_back(bits::hi(fanout[std::min<size_type>(r, fanout.size() - 1)]));
+                return (size_type)1 << shift.back();
+            }, source);
+            m_shift = int_vector<8>(shift.size());
+            for (size_type r = 0; r < shift.size(); ++r)
+                m_shift[r] = shift[r];
+            set_block_size();
+        }
+
+    }; //end class
+
+    //! Helper class which provides _npr_support_cn_dyn the context of a LCP. The block size
+    //! given to cst_cn is only the default one, see _npr_support_cn_dyn.
+    struct npr_support_cn_dyn {
+        template<class t_cst, uint8_t block_size, uint8_t sbs>
+        using type = _npr_support_cn_dyn<typename t_cst::lcp_type, block_size, typename t_cst::size_type>;
+    };
+
+    template<>
+    struct format_tag<npr_support_cn_dyn> {
+        static std::string
+        name() {
+            return "npr_cn_dyn";
+        }
+    };
+
+}
+
+#endif //CCST_CN_NPR_CN_DYN_SUPPORT_H
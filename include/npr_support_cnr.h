@@ -17,21 +17,42 @@ along with this program.  If not, see http://www.gnu.org/licenses/ .
 #define CCST_CN_NPR_CNR_SUPPORT_H
 
 #include "npr.h"
+#include "parallel.h"
+#include "construction_report.h"
+#include "sectioned_file.h"
 #include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
 #include <vector>
+#include <string>
 
 using namespace sdsl;
 
 namespace cstds {
 
     //! A class to represent the NPR operations over a LCP array in compressed form.
-    template<class t_lcp = sdsl::lcp_dac<>, uint8_t block_size = 32, uint8_t sbs = 8>
+    /*!
+    * The query methods are const and do not use shared scratch space, so they can be
+    * called concurrently from several threads.
+    */
+    template<class t_lcp = sdsl::lcp_dac<>, uint8_t block_size = 32, uint8_t sbs = 8,
+            class t_size = sdsl::int_vector<>::size_type>
     class _npr_support_cnr {
 
     public:
-        typedef sdsl::int_vector<>::size_type size_type;
+        typedef t_size size_type;
         typedef t_lcp lcp_type;
 
+        //! Query computed by step. The levels of _npr_support_cnr depend on each other in
+        //! more ways than the ones of npr_cn_tree, so it is not computed one level at a time:
+        //! start prefetches its first two levels and the first step answers it.
+        struct search_type {
+            size_type result = 0;
+            size_type value = 0;
+            uint8_t kind = 0; //0 fwd_nsv, 1 bwd_psv, 2 rmq
+            bool done = true;
+            size_type i = 0, j = 0;
+        };
+
         // inner class which is used in CSTs to parametrize npr classes
         // with information about the CST.
         template<class Cst>
@@ -67,25 +88,18 @@ namespace cstds {
             *this = std::move(npr_c);
         }
 
-        //! Constructor
-        _npr_support_cnr(const t_lcp *f_lcp) {
+        //! Constructor. The blocks of each level are computed by up to `threads` threads.
+        _npr_support_cnr(const t_lcp *f_lcp, size_type threads = 1) {
             set_lcp(f_lcp); //assign lcp to be used
-            //construct data
-            size_type tmp_min, min, tmp_pos, tmp_start, b_size = block_size;
-            size_type n = m_lcp->size();
-            size_type n_levels = calculate_number_of_levels(n);
-            pos_array.resize(n_levels);
-            min_array.resize(n_levels - 1);
-            if (n_levels > 0) {
-                pos_array.resize(n_levels);
-                min_array.resize(n_levels - 1);
-                create_first_level(n);
-                if (n_levels > 1) {
-                    create_second_level(n);
-                    if (n_levels > 2)
-                        create_other_levels(n, n_levels);
-                }
-            }
+            create_levels(threads, [&]() -> const t_lcp& { return *m_lcp; });
+        }
+
+        //! Constructor that reads the first level from the plain LCP array stored in lcp_file
+        //! (an int_vector written by sdsl) instead of from *f_lcp. Each thread streams its own
+        //! range of the file, so the LCP is not accessed at random while building.
+        _npr_support_cnr(const t_lcp *f_lcp, const std::string& lcp_file, size_type threads = 1) {
+            set_lcp(f_lcp); //assign lcp to be used
+            create_levels(threads, [&]() { return int_vector_buffer<>(lcp_file, std::ios::in); });
         }
 
         void
@@ -126,11 +140,11 @@ namespace cstds {
         }
 
         //! Serialize to a stream.
-        size_type
+        uint64_t
         serialize(std::ostream &out, structure_tree_node *v = nullptr, std::string name = "") const {
             structure_tree_node *child = structure_tree::add_child(v, name, sdsl::util::class_name(*this));
-            size_type levels = pos_array.size();
-            size_type written_bytes = 0;
+            uint64_t levels = pos_array.size();
+            uint64_t written_bytes = 0;
             written_bytes += write_member(levels, out, child, "levels");
             if (levels > 0) {
                  written_bytes += pos_array[0].serialize(out, child, "pos level");
@@ -147,7 +161,7 @@ namespace cstds {
         //! Load from a stream.
         void
         load(std::istream &in, const t_lcp *llcp = nullptr) {
-            size_type levels = 0;
+            uint64_t levels = 0;
             m_lcp = llcp;
             read_member(levels, in);
             if (levels > 0) {
@@ -330,8 +344,72 @@ namespace cstds {
             return min_pos;
         }
 
+        //! Starts s as fwd_nsv(i, d), answered by step.
+        void
+        start_fwd_nsv(search_type &s, size_type i, size_type d) const {
+            start(s, 0, i, d);
+        }
+
+        //! Starts s as bwd_psv(i, d), answered by step.
+        void
+        start_bwd_psv(search_type &s, size_type i, size_type d) const {
+            start(s, 1, i, d);
+        }
+
+        //! Starts s as rmq(i, j), answered by step.
+        void
+        start_rmq(search_type &s, size_type i, size_type j) const {
+            start(s, 2, i, j);
+            prefetch(j);
+        }
+
+        //! Answers s. Returns true (s.result and s.value hold its answer).
+        bool
+        step(search_type &s) const {
+            if (!s.done) {
+                if (s.kind == 0)
+                    s.result = fwd_nsv(s.i, s.j, s.value);
+                else if (s.kind == 1)
+                    s.result = bwd_psv(s.i, s.j, s.value);
+                else
+                    s.result = rmq(s.i, s.j, s.value);
+                s.done = true;
+            }
+            return true;
+        }
+
+        //! Prefetches the entries of the first two levels of the npr tree that cover
+        //! position i of the LCP.
+        void
+        prefetch(size_type i) const {
+            size_type block = i / sbs;
+            if (pos_array.size() > 0)
+                prefetch_entry(pos_array[0], block);
+            if (pos_array.size() > 1) {
+                block /= sbs;
+                prefetch_entry(min_array[0], block);
+                prefetch_entry(pos_array[1], block);
+            }
+        }
+
     private:
 
+        void
+        start(search_type &s, uint8_t kind, size_type i, size_type j) const {
+            s.kind = kind;
+            s.done = false;
+            s.i = i;
+            s.j = j;
+            if (i < m_lcp->size())
+                prefetch(i);
+        }
+
+        //! Issues a prefetch of the word containing v[idx].
+        static void
+        prefetch_entry(const sdsl::int_vector<>& v, size_type idx) {
+            __builtin_prefetch(v.data() + ((idx * v.width()) >> 6));
+        }
+
         //! Computes the number of levels of the npr tree
         size_type
         calculate_number_of_levels(size_type n) {
@@ -350,85 +428,118 @@ namespace cstds {
             return levels;
         }
 
+        //! Builds all the levels. source() returns the values of the LCP used for the first
+        //! level; it is called once per thread so each one can have its own reader.
+        template<class t_source>
         void
-        create_first_level(size_type n) {
+        create_levels(size_type threads, t_source source) {
+            //construct data
+            size_type n = m_lcp->size();
+            size_type n_levels = calculate_number_of_levels(n);
+            pos_array.resize(n_levels);
+            min_array.resize(n_levels - 1);
+            if (n_levels > 0) {
+                pos_array.resize(n_levels);
+                min_array.resize(n_levels - 1);
+                create_first_level(n, threads, source);
+                if (n_levels > 1) {
+                    create_second_level(n, threads);
+                    if (n_levels > 2)
+                        create_other_levels(n, n_levels, threads);
+                }
+            }
+        }
+
+        template<class t_source>
+        void
+        create_first_level(size_type n, size_type threads, t_source source) {
+            construction_report::phase phase("NPR level 0");
             size_type level_size = (size_type) ((n + sbs - 1) / sbs);
             size_type bits_pos = bits::hi(sbs) + 1;
-            size_type min, tmp_start, b_size, tmp_pos, tmp_min;
             pos_array[0] = int_vector<>(level_size, 0, bits_pos);
-            b_size = sbs;
-            for (size_type i = 0; i < level_size; ++ i) {
-                min = n;
-                tmp_start = i * sbs;
-                if (tmp_start + sbs >= n)
-                    b_size = n - tmp_start;
-                for (size_type j = 0; j < b_size; j++) {
-                    tmp_min = (*m_lcp)[tmp_start + j];
-                    if (tmp_min < min) {
-                        min = tmp_min;
-                        tmp_pos = j;
+            parallel_for(level_size, threads, [&](size_type from, size_type to) {
+                auto&& values = source();
+                size_type min, tmp_start, b_size, tmp_pos = 0, tmp_min;
+                b_size = sbs;
+                for (size_type i = from; i < to; ++ i) {
+                    min = n;
+                    tmp_start = i * sbs;
+                    if (tmp_start + sbs >= n)
+                        b_size = n - tmp_start;
+                    for (size_type j = 0; j < b_size; j++) {
+                        tmp_min = values[tmp_start + j];
+                        if (tmp_min < min) {
+                            min = tmp_min;
+                            tmp_pos = j;
+                        }
                     }
+                    pos_array[0][i] = tmp_pos;
                 }
-                pos_array[0][i] = tmp_pos;
-            }
+            });
         }
 
         void
-        create_second_level(size_type n) {
+        create_second_level(size_type n, size_type threads) {
+            construction_report::phase phase("NPR level 1");
             size_type last_level_size = pos_array[0].size();
             size_type level_size = (last_level_size + sbs - 1) / sbs;
             size_type bits_pos = bits::hi(sbs) + 1;
             size_type bits_min = bits::hi(n) + 1;
-            size_type min, tmp_start, b_size, tmp_pos, tmp_min, pos_level_0;
             min_array[0] = int_vector<>(level_size, 0, bits_min);
             pos_array[1] = int_vector<>(level_size, 0, bits_pos);
-            b_size = sbs;
-            for (size_type i = 0; i < level_size; ++i) {
-                min = n;
-                tmp_start = i * sbs;
-                if (tmp_start + sbs >= last_level_size)
-                    b_size = last_level_size - tmp_start;
-                for (size_type j = 0; j < b_size; j++) {
-                    pos_level_0 = sbs * (tmp_start + j) + pos_array[0][tmp_start + j];
-                    tmp_min = (*m_lcp)[pos_level_0];
-                    if (tmp_min < min) {
-                        min = tmp_min;
-                        tmp_pos = j;
+            parallel_for(level_size, threads, [&](size_type from, size_type to) {
+                size_type min, tmp_start, b_size, tmp_pos = 0, tmp_min, pos_level_0;
+                b_size = sbs;
+                for (size_type i = from; i < to; ++i) {
+                    min = n;
+                    tmp_start = i * sbs;
+                    if (tmp_start + sbs >= last_level_size)
+                        b_size = last_level_size - tmp_start;
+                    for (size_type j = 0; j < b_size; j++) {
+                        pos_level_0 = sbs * (tmp_start + j) + pos_array[0][tmp_start + j];
+                        tmp_min = (*m_lcp)[pos_level_0];
+                        if (tmp_min < min) {
+                            min = tmp_min;
+                            tmp_pos = j;
+                        }
                     }
+                    min_array[0][i] = min;
+                    pos_array[1][i] = tmp_pos;
                 }
-                min_array[0][i] = min;
-                pos_array[1][i] = tmp_pos;
-            }
+            });
         }
 
         void
-        create_other_levels(size_type n, size_type n_levels) {
+        create_other_levels(size_type n, size_type n_levels, size_type threads) {
             size_type last_level_size = 0;
             size_type level_size = pos_array[1].size();
             size_type bits_pos = bits::hi(block_size) + 1;
             size_type bits_min = bits::hi(n) + 1;
-            size_type min, tmp_start, b_size, tmp_pos, tmp_min;
             for (size_type r = 2; r < n_levels; ++ r) {
+                construction_report::phase phase("NPR level " + std::to_string(r));
                 last_level_size = level_size;
                 level_size = (level_size + block_size - 1) / block_size;
                 min_array[r - 1] = int_vector<>(level_size, 0, bits_min);
                 pos_array[r] = int_vector<>(level_size, 0, bits_pos);
-                b_size = block_size;
-                for (size_type i = 0; i < level_size; ++i) {
-                    min = n;
-                    tmp_start = i * block_size;
-                    if (tmp_start + block_size >= last_level_size)
-                        b_size = last_level_size - tmp_start;
-                    for (size_type j = 0; j < b_size; j++) {
-                        tmp_min = min_array[r - 2][tmp_start + j];
-                        if (tmp_min < min) {
-                            min = tmp_min;
-                            tmp_pos = j;
+                parallel_for(level_size, threads, [&](size_type from, size_type to) {
+                    size_type min, tmp_start, b_size, tmp_pos = 0, tmp_min;
+                    b_size = block_size;
+                    for (size_type i = from; i < to; ++i) {
+                        min = n;
+                        tmp_start = i * block_size;
+                        if (tmp_start + block_size >= last_level_size)
+                            b_size = last_level_size - tmp_start;
+                        for (size_type j = 0; j < b_size; j++) {
+                            tmp_min = min_array[r - 2][tmp_start + j];
+                            if (tmp_min < min) {
+                                min = tmp_min;
+                                tmp_pos = j;
+                            }
                         }
+                        min_array[r - 1][i] = min;
+                        pos_array[r][i] = tmp_pos;
                     }
-                    min_array[r - 1][i] = min;
-                    pos_array[r][i] = tmp_pos;
-                }
+                });
             }
         }
 
@@ -438,6 +549,8 @@ namespace cstds {
         find_nsv_block(size_type  d, size_type b, size_type &l_value) const {
             size_type block, until = 0, value, n = pos_array[0].size();
             size_type pos_level_0;
+            if (b >= n) //b is past the last block of the level
+                return n;
             block = b / sbs; //local block
             if (min_array[0][block] < d) { //need to search in the first block
                 until = sbs * (block + 1);
@@ -478,6 +591,8 @@ namespace cstds {
         size_type
         find_nsv_block_2(size_type  d, size_type b, size_type level, size_type &l_value) const {
             size_type block, until = 0, value, n = pos_array[level].size();
+            if (b >= n) //b is past the last block of the level
+                return n;
             block = b / block_size; //local block
             if (min_array[level][block] < d) { //need to search in the first block
                 until = block_size * (block + 1);
@@ -717,7 +832,15 @@ namespace cstds {
     //! Helper class which provides _npr_support_cn the context of a LCP.
     struct npr_support_cnr {
         template<class t_cst, uint8_t block_size, uint8_t sbs>
-        using type = _npr_support_cnr<typename t_cst::lcp_type, block_size, sbs>;
+        using type = _npr_support_cnr<typename t_cst::lcp_type, block_size, sbs, typename t_cst::size_type>;
+    };
+
+    template<>
+    struct format_tag<npr_support_cnr> {
+        static std::string
+        name() {
+            return "npr_cnr";
+        }
     };
 
 }
@@ -0,0 +1,182 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file numa_replicas.h
+    \brief numa_replicas.h contains the hosting of a read only index on the NUMA nodes of the machine.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_NUMA_REPLICAS_H
+#define CST_CN_NUMA_REPLICAS_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace cstds {
+
+    //! How an index is placed on the NUMA nodes.
+    enum numa_mode : uint8_t {
+        numa_none = 0,      //!< where the loading thread runs (first touch)
+        numa_replicate = 1, //!< one copy on each node, used by the threads of that node
+        numa_interleave = 2 //!< one copy whose pages are spread over all the nodes
+    };
+
+    //! Returns the CPUs of each NUMA node with CPUs and, in ids, the number of each of these
+    //! nodes (a single node 0 with every CPU if the machine does not expose its topology).
+    inline std::vector<std::vector<int>>
+    numa_node_cpus(std::vector<int>& ids) {
+        std::vector<std::vector<int>> nodes;
+        ids.clear();
+        for (int node = 0; node < 1024; ++node) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!in)
+                continue;
+            std::vector<int> cpus;
+            std::string range;
+            while (std::getline(in, range, ',')) {
+                int first = 0, last = 0;
+                char dash = 0;
+                std::istringstream r(range);
+                if (!(r >> first))
+                    continue;
+                last = (r >> dash >> last) ? last : first;
+                for (int cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) {
+                nodes.push_back(cpus);
+                ids.push_back(node);
+            }
+        }
+        if (nodes.empty()) {
+            nodes.emplace_back();
+            ids.push_back(0);
+            for (int cpu = 0; cpu < (int) std::thread::hardware_concurrency(); ++cpu)
+                nodes.back().push_back(cpu);
+        }
+        return nodes;
+    }
+
+    //! Runs the calling thread on the CPUs of cpus only.
+    inline bool
+    bind_to_cpus(const std::vector<int>& cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+    //! Sets the memory policy of the calling thread (e.g. MPOL_BIND or MPOL_INTERLEAVE over
+    //! the nodes of ids, or MPOL_DEFAULT) for the pages it touches from now on.
+    inline bool
+    set_memory_policy(int mode, const std::vector<int>& ids) {
+        unsigned long mask[1024 / 64] = {0};
+        for (int node : ids)
+            mask[node / 64] |= 1UL << (node % 64);
+        if (mode == MPOL_DEFAULT)
+            return syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) == 0;
+        return syscall(SYS_set_mempolicy, mode, mask, 1024 + 1) == 0;
+    }
+
+    //! A read only index hosted on the NUMA nodes of the machine.
+    /*!
+    * With numa_replicate, each replica is loaded by a thread bound to the CPUs of its node
+    * with a memory policy of that node, so all its pages are local to it, and a query
+    * thread bound by bind_thread(k) reads the replica of its own node. With
+    * numa_interleave there is a single copy whose pages (including the levels of the NPR)
+    * are spread over all the nodes, so every thread sees the same average latency instead
+    * of the remote one of the nodes without the index. The replicas are never modified.
+    */
+    template<class t_index>
+    class numa_replicas {
+    private:
+        std::vector<int> m_ids; //number of each node
+        std::vector<std::vector<int>> m_cpus; //CPUs of each node
+        std::vector<std::unique_ptr<t_index>> m_replica;
+        numa_mode m_mode = numa_none;
+
+    public:
+        numa_replicas() : m_cpus(numa_node_cpus(m_ids)) { }
+
+        numa_replicas(const numa_replicas&) = delete;
+        numa_replicas& operator=(const numa_replicas&) = delete;
+
+        //! Number of NUMA nodes with CPUs.
+        size_t
+        nodes() const {
+            return m_cpus.size();
+        }
+
+        //! Number of copies of the index loaded.
+        size_t
+        replicas() const {
+            return m_replica.size();
+        }
+
+        //! Loads the index with load(idx), which returns false if it fails, placing it as
+        //! mode says. The replicas are loaded at the same time, one thread per node.
+        template<class t_load>
+        bool
+        load(numa_mode mode, t_load load) {
+            m_mode = mode;
+            m_replica.clear();
+            size_t copies = mode == numa_replicate ? m_cpus.size() : 1;
+            for (size_t k = 0; k < copies; ++k)
+                m_replica.emplace_back(new t_index());
+            std::vector<char> ok(copies, 0);
+            std::vector<std::thread> loaders;
+            for (size_t k = 0; k < copies; ++k) {
+                loaders.emplace_back([&, k]() {
+                    if (mode == numa_replicate) {
+                        bind_to_cpus(m_cpus[k]);
+                        set_memory_policy(MPOL_BIND, std::vector<int>(1, m_ids[k]));
+                    } else if (mode == numa_interleave) {
+                        set_memory_policy(MPOL_INTERLEAVE, m_ids);
+                    }
+                    ok[k] = load(*m_replica[k]);
+                    set_memory_policy(MPOL_DEFAULT, m_ids);
+                });
+            }
+            for (auto& t : loaders)
+                t.join();
+            for (char r : ok)
+                if (!r)
+                    return false;
+            return true;
+        }
+
+        //! Binds the calling thread, the k-th query thread, to the CPUs of node k % nodes()
+        //! and returns the replica it must query.
+        const t_index&
+        bind_thread(size_t k) const {
+            size_t node = k % m_cpus.size();
+            if (m_mode != numa_none)
+                bind_to_cpus(m_cpus[node]);
+            return *m_replica[m_mode == numa_replicate ? node : 0];
+        }
+    };
+
+}
+
+#endif //CST_CN_NUMA_REPLICAS_H
@@ -0,0 +1,136 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file parallel.h
+    \brief parallel.h contains the helpers used to split loops and independent tasks among threads.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_PARALLEL_H
+#define CST_CN_PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace cstds {
+
+    //! Calls f(from, to) over a partition of [0,n) using up to `threads` threads.
+    /*!
+    * The limits of the ranges are multiples of 64, so threads writing consecutive
+    * elements of the same bit-compressed int_vector never share a 64-bit word.
+    */
+    template<class t_func>
+    void
+    parallel_for(uint64_t n, uint64_t threads, t_func f) {
+        uint64_t chunk = threads > 1 ? (n + threads - 1) / threads : n;
+        chunk = ((chunk + 63) / 64) * 64;
+        if (threads <= 1 or chunk >= n) {
+            if (n > 0)
+                f((uint64_t)0, n);
+            return;
+        }
+        std::vector<std::thread> pool;
+        for (uint64_t from = chunk; from < n; from += chunk)
+            pool.emplace_back(f, from, std::min(from + chunk, n));
+        f((uint64_t)0, chunk);
+        for (auto& th : pool)
+            th.join();
+    }
+
+    //! A fixed set of threads that runs jobs of independent tasks (e.g. one per shard of an
+    //! index), so the threads are not created again for every query.
+    /*!
+    * run(n, f) calls f(0), ..., f(n-1) over the threads of the pool and returns when all of
+    * them are done. Jobs given by several threads at the same time are run one after the other.
+    */
+    class task_pool {
+    private:
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex, m_run_mutex;
+        std::condition_variable m_start, m_done;
+        std::function<void(uint64_t)> m_task;
+        uint64_t m_n = 0, m_next = 0, m_pending = 0;
+        bool m_stop = false;
+
+        void
+        work() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true) {
+                m_start.wait(lock, [&]() { return m_stop or m_next < m_n; });
+                if (m_stop)
+                    return;
+                uint64_t i = m_next++;
+                lock.unlock();
+                m_task(i);
+                lock.lock();
+                if (--m_pending == 0)
+                    m_done.notify_all();
+            }
+        }
+
+    public:
+        //! With threads <= 1 the tasks are run by the thread that calls run.
+        explicit task_pool(uint64_t threads) {
+            for (uint64_t t = 0; threads > 1 and t < threads; ++t)
+                m_threads.emplace_back(&task_pool::work, this);
+        }
+
+        task_pool(const task_pool&) = delete;
+        task_pool& operator=(const task_pool&) = delete;
+
+        ~task_pool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_start.notify_all();
+            for (auto& th : m_threads)
+                th.join();
+        }
+
+        //! Number of threads of the pool (0 if the tasks are run by the caller).
+        uint64_t
+        threads() const {
+            return m_threads.size();
+        }
+
+        //! Calls f(i) for every i in [0,n) and waits for all of them.
+        template<class t_func>
+        void
+        run(uint64_t n, t_func f) {
+            if (m_threads.empty() or n <= 1) {
+                for (uint64_t i = 0; i < n; ++i)
+                    f(i);
+                return;
+            }
+            std::lock_guard<std::mutex> run_lock(m_run_mutex);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_task = f;
+            m_n = n;
+            m_next = 0;
+            m_pending = n;
+            m_start.notify_all();
+            m_done.wait(lock, [&]() { return m_pending == 0; });
+            m_n = m_next = 0;
+        }
+    };
+
+}
+
+#endif //CST_CN_PARALLEL_H
@@ -0,0 +1,151 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file query_engine.h
+    \brief query_engine.h contains a multi-threaded executor of CST operations.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_QUERY_ENGINE_H
+#define CST_CN_QUERY_ENGINE_H
+
+#include <sdsl/suffix_trees.hpp>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+namespace cstds {
+
+    //! Operations supported by the query_engine.
+    enum query_op : uint8_t {
+        q_parent = 0,  // parent(v)
+        q_child  = 1,  // child(v, c)
+        q_depth  = 2,  // depth(v)
+        q_lca    = 3,  // lca(v, w)
+        q_sl     = 4,  // sl(v)
+        q_count  = 5   // number of occurrences of pattern[0..m-1]
+    };
+
+    //! A class that executes a vector of mixed CST operations over several threads.
+    /*!
+    * The CST is shared by all the threads and only its const methods are used, so it
+    * must not be modified while run() is executing. The queries are split in chunks that
+    * the threads claim dynamically, so a thread that finishes its chunk early keeps taking
+    * work from the remaining ones. Every thread writes only the results of its own chunks.
+    * \tparam t_cst  Type of the CST (cst_cn or any sdsl CST).
+    */
+    template<class t_cst>
+    class query_engine {
+
+    public:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+        typedef typename t_cst::char_type char_type;
+
+        //! A query. Fields not used by the operation are ignored.
+        struct query_type {
+            query_op op;
+            node_type v;
+            node_type w;
+            char_type c;
+            const char_type* pattern;
+            size_type m;
+        };
+
+        //! A result. Node operations fill `node`, depth and count fill `value`.
+        struct result_type {
+            node_type node;
+            size_type value;
+        };
+
+    private:
+        const t_cst* m_cst;
+        size_type m_threads;
+        size_type m_chunk;
+
+    public:
+
+        //! Constructor
+        /*!
+        * \param cst      CST to be queried.
+        * \param threads  Number of threads used (0 uses the number of hardware threads).
+        * \param chunk    Number of queries claimed by a thread at once.
+        */
+        query_engine(const t_cst& cst, size_type threads = 0, size_type chunk = 256)
+                : m_cst(&cst), m_threads(threads), m_chunk(chunk) {
+            if (m_threads == 0)
+                m_threads = std::max((size_type)std::thread::hardware_concurrency(), (size_type)1);
+            if (m_chunk == 0)
+                m_chunk = 1;
+        }
+
+        //! Number of threads used.
+        size_type
+        threads() const {
+            return m_threads;
+        }
+
+        //! Executes all the queries, results[i] is the answer of queries[i].
+        void
+        run(const std::vector<query_type>& queries, std::vector<result_type>& results) const {
+            results.resize(queries.size());
+            std::atomic<size_type> next(0);
+            size_type n_threads = std::min<size_type>(m_threads, (queries.size() + m_chunk - 1) / m_chunk);
+            if (n_threads <= 1) {
+                work(queries, results, next);
+                return;
+            }
+            std::vector<std::thread> pool;
+            for (size_type t = 0; t < n_threads; ++t)
+                pool.emplace_back(&query_engine::work, this, std::cref(queries), std::ref(results), std::ref(next));
+            for (auto& th : pool)
+                th.join();
+        }
+
+        //! Executes a single query.
+        result_type
+        execute(const query_type& q) const {
+            result_type res;
+            res.node = m_cst->root();
+            res.value = 0;
+            switch (q.op) {
+                case q_parent: res.node = m_cst->parent(q.v); break;
+                case q_child:  res.node = m_cst->child(q.v, q.c); break;
+                case q_depth:  res.value = m_cst->depth(q.v); break;
+                case q_lca:    res.node = m_cst->lca(q.v, q.w); break;
+                case q_sl:     res.node = m_cst->sl(q.v); break;
+                case q_count:  res.value = sdsl::count(m_cst->csa, q.pattern, q.pattern + q.m); break;
+            }
+            return res;
+        }
+
+    private:
+
+        void
+        work(const std::vector<query_type>& queries, std::vector<result_type>& results,
+             std::atomic<size_type>& next) const {
+            size_type n = queries.size(), start, end;
+            while ((start = next.fetch_add(m_chunk)) < n) {
+                end = std::min(start + m_chunk, n);
+                for (size_type i = start; i < end; ++i)
+                    results[i] = execute(queries[i]);
+            }
+        }
+
+    }; //end class
+
+}
+
+#endif //CST_CN_QUERY_ENGINE_H
@@ -0,0 +1,87 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file query_sample.h
+    \brief query_sample.h contains the random samples of nodes used to time the operations of a CST.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_QUERY_SAMPLE_H
+#define CST_CN_QUERY_SAMPLE_H
+
+#include <sdsl/suffix_tree_helper.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace cstds {
+
+    //! Takes `leaves` random leaves of cst and adds to nodes the path from the parent of each
+    //! one to the root (excluded), and to symbols a symbol of a random position of T for each
+    //! node. Based on the experiments done by Simon Gog in his PhD thesis. The generators
+    //! have fixed seeds, so every run takes the same sample.
+    template<class t_cst>
+    void
+    sample_parent_paths(const t_cst& cst, uint64_t leaves, std::vector<typename t_cst::node_type>& nodes,
+                        std::vector<typename t_cst::char_type>& symbols) {
+        std::default_random_engine generator;
+        std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
+        std::default_random_engine generator2;
+        std::uniform_real_distribution<double> let(0.0, 1.0 * cst.csa.size() - 1);
+        auto root = cst.root();
+        for (uint64_t i = 0; i < leaves; ++ i) {
+            auto node = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+            while (node != root) {
+                nodes.push_back(node);
+                symbols.push_back(sdsl::first_row_symbol((uint64_t)let(generator2), cst.csa));
+                node = cst.parent(node);
+            }
+        }
+    }
+
+    //! Takes `leaves` random leaves of cst and adds to nodes the nodes visited by suffix links
+    //! from the parent of each one until the root (excluded).
+    template<class t_cst>
+    void
+    sample_sl_paths(const t_cst& cst, uint64_t leaves, std::vector<typename t_cst::node_type>& nodes) {
+        std::default_random_engine generator;
+        std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
+        auto root = cst.root();
+        for (uint64_t i = 0; i < leaves; ++ i) {
+            auto node = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+            while (node != root) {
+                nodes.push_back(node);
+                node = cst.sl(node);
+            }
+        }
+    }
+
+    //! Adds to nodes `pairs` pairs of random leaves of cst, the leftmost one first.
+    template<class t_cst>
+    void
+    sample_leaf_pairs(const t_cst& cst, uint64_t pairs, std::vector<typename t_cst::node_type>& nodes) {
+        std::default_random_engine generator;
+        std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
+        for (uint64_t i = 0; i < pairs; ++ i) {
+            uint64_t pos1 = (uint64_t)dist(generator);
+            uint64_t pos2 = (uint64_t)dist(generator);
+            nodes.push_back(cst.select_leaf(std::min(pos1, pos2)));
+            nodes.push_back(cst.select_leaf(std::max(pos1, pos2)));
+        }
+    }
+
+}
+
+#endif //CST_CN_QUERY_SAMPLE_H
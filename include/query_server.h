@@ -0,0 +1,551 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file query_server.h
+    \brief query_server.h contains a server of cst_cn queries over a Unix domain socket.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_QUERY_SERVER_H
+#define CST_CN_QUERY_SERVER_H
+
+#include "query_engine.h"
+#include "parallel.h"
+#include "batch_lca.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace cstds {
+
+    //! Operations of the query_server protocol.
+    /*!
+    * A request is a frame: a uint32 with the number of bytes that follow, the operation
+    * (uint8) and its arguments. The answer is a frame with a uint32 size, a server_status
+    * (uint8) and the result. All the integers are in the byte order of the host. Nodes are
+    * sent as their interval [lb, rb] of leaves (two uint64), the root is [0, n-1].
+    */
+    enum server_op : uint8_t {
+        s_count  = 0, // pattern -> uint64 number of occurrences
+        s_locate = 1, // uint64 limit, pattern -> uint64 k, k increasing positions (k <= limit)
+        s_child  = 2, // node, uint8 c -> child of the node by c (the root if there is none)
+        s_lca    = 3, // node, node -> their lca
+        s_ms     = 4, // pattern -> one uint64 per symbol i, the longest prefix of pattern[i..] in T
+        s_stats  = 5  // -> uint64 n, requests, batches, queries/sec, p50 and p99 latency (microsec)
+    };
+
+    //! First byte of an answer.
+    enum server_status : uint8_t {
+        s_ok          = 0,
+        s_bad_request = 1  //!< unknown operation or wrong arguments
+    };
+
+    //! Longest frame accepted. A larger one closes the connection.
+    const uint32_t SERVER_MAX_FRAME = 1U << 26;
+
+    //! The requests of a connection are not read while it has more bytes of answers than
+    //! this waiting for the client to read them.
+    const uint64_t SERVER_MAX_OUTPUT = 1ULL << 26;
+
+    //! The child and lca requests of a batch are answered in chunks of this many requests,
+    //! one chunk per task of the pool.
+    const uint64_t SERVER_NODE_CHUNK = 256;
+
+    //! The lca requests of a batch are answered with one sweep over the LCP (lca_batch) when
+    //! the range of the LCP that they cover has at most this many entries per request.
+    const uint64_t SERVER_LCA_SWEEP = 32;
+
+    //! Computes the matching statistics of pattern: ms[i] is the length of the longest prefix
+    //! of pattern[i..] that occurs in T. It extends backwards from the end of pattern and,
+    //! when a symbol cannot be added, moves to the parent of the current node (cst_cn nodes
+    //! are the intervals of the CSA, so the current interval is its node).
+    template<class t_cst>
+    void
+    matching_statistics(const t_cst& cst, const std::string& pattern, std::vector<uint64_t>& ms) {
+        typedef typename t_cst::csa_type::size_type csa_size_type;
+        typedef typename t_cst::node_type node_type;
+        ms.assign(pattern.size(), 0);
+        csa_size_type l = 0, r = cst.csa.size() - 1, l_res = 0, r_res = 0;
+        uint64_t q = 0;
+        for (uint64_t i = pattern.size(); i-- > 0;) {
+            typename t_cst::char_type c = (uint8_t) pattern[i];
+            while (sdsl::backward_search(cst.csa, l, r, c, l_res, r_res) == 0 and q > 0) {
+                node_type v = cst.parent(node_type(l, r));
+                q = cst.depth(v);
+                l = cst.lb(v);
+                r = cst.rb(v);
+            }
+            if (l_res <= r_res and r_res < cst.csa.size()) {
+                ++q;
+                l = l_res;
+                r = r_res;
+            } else { //c does not occur in T
+                q = 0;
+                l = 0;
+                r = cst.csa.size() - 1;
+            }
+            ms[i] = q;
+        }
+    }
+
+    //! A long-lived server of count, locate, child, lca and matching statistics queries over
+    //! a cst_cn loaded once, on a Unix domain socket (see server_op for the protocol).
+    /*!
+    * A single thread reads the requests of all the connections. The requests that arrive
+    * within `window` microseconds of the first pending one (or until `max_batch` of them
+    * are pending) form a batch, which is answered by the threads of a task_pool, and then
+    * the answers are written in the order of the requests of each connection, so a client
+    * can pipeline its requests. The child requests of a batch are answered in chunks, one
+    * per task of the pool, and so are its lca requests, unless they are dense in the LCP:
+    * then they are answered with one sweep (lca_batch). The other requests are answered
+    * one by one. The
+    * sockets do not block: the answers that a client does not read yet wait in the server,
+    * and a client that shuts down its side of the connection still gets all of them.
+    * The latency of a request goes from the moment it is read to the moment its batch is
+    * answered and handed to the sockets. run writes the queries/sec and the p50 and p99 latency of each period of
+    * report_secs seconds to its log. The cst is never modified.
+    * \tparam t_cst  A cst_cn over a byte alphabet.
+    */
+    template<class t_cst>
+    class query_server {
+        static_assert(t_cst::alphabet_category::WIDTH == 8, "query_server needs a byte alphabet");
+
+    public:
+        typedef typename t_cst::size_type size_type;
+        typedef typename t_cst::node_type node_type;
+        typedef typename t_cst::char_type char_type;
+        typedef std::chrono::steady_clock clock_type;
+
+    private:
+        struct connection {
+            int fd;
+            std::string in;  //bytes of the requests not complete yet
+            std::string out; //answers not written yet
+            bool eof = false;     //the client sent all its requests
+            bool closing = false; //the connection failed or the client sent a wrong frame
+        };
+
+        struct request {
+            uint64_t conn;
+            std::string frame; //operation and arguments
+            clock_type::time_point arrival;
+        };
+
+        const t_cst& m_cst;
+        query_engine<t_cst> m_engine;
+        task_pool m_pool;
+        uint64_t m_max_batch;
+        uint64_t m_window; //microseconds
+        int m_listen = -1;
+        std::string m_path;
+        std::map<uint64_t, connection> m_conn;
+        uint64_t m_next_conn = 0;
+        std::vector<request> m_pending;
+        //statistics of the current period and of the whole run
+        std::vector<uint64_t> m_latency; //nanoseconds
+        clock_type::time_point m_period_start;
+        uint64_t m_requests = 0, m_batches = 0, m_period_batches = 0;
+
+        template<class t_value>
+        static void
+        put(std::string& out, t_value x) {
+            out.append((const char*) &x, sizeof(x));
+        }
+
+        template<class t_value>
+        static bool
+        get(const std::string& in, uint64_t& pos, t_value& x) {
+            if (pos + sizeof(x) > in.size())
+                return false;
+            memcpy(&x, in.data() + pos, sizeof(x));
+            pos += sizeof(x);
+            return true;
+        }
+
+        bool
+        get_node(const std::string& in, uint64_t& pos, node_type& v) const {
+            uint64_t lb = 0, rb = 0;
+            if (!get(in, pos, lb) or !get(in, pos, rb) or lb > rb or rb >= m_cst.csa.size())
+                return false;
+            v = node_type(lb, rb);
+            return true;
+        }
+
+        void
+        put_node(std::string& out, const node_type& v) const {
+            put(out, (uint64_t) m_cst.lb(v));
+            put(out, (uint64_t) m_cst.rb(v));
+        }
+
+        //! Arguments of a child request. Returns false if they are wrong.
+        bool
+        get_child(const std::string& frame, node_type& v, char_type& c) const {
+            uint64_t pos = 1;
+            return get_node(frame, pos, v) and get(frame, pos, c) and pos == frame.size();
+        }
+
+        //! Arguments of a lca request. Returns false if they are wrong.
+        bool
+        get_lca(const std::string& frame, node_type& v, node_type& w) const {
+            uint64_t pos = 1;
+            return get_node(frame, pos, v) and get_node(frame, pos, w) and pos == frame.size();
+        }
+
+        //! Answer of a child or lca request, without its size.
+        std::string
+        node_answer(const node_type& v) const {
+            std::string out;
+            put(out, (uint8_t) s_ok);
+            put_node(out, v);
+            return out;
+        }
+
+        //! Latency in nanoseconds of the fraction f of the requests of the period.
+        uint64_t
+        percentile(double f) const {
+            if (m_latency.empty())
+                return 0;
+            std::vector<uint64_t> sorted(m_latency);
+            uint64_t k = std::min<uint64_t>((uint64_t) (f * sorted.size()), sorted.size() - 1);
+            std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+            return sorted[k];
+        }
+
+        double
+        period_qps(clock_type::time_point now) const {
+            double secs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_period_start).count() / 1e9;
+            return secs > 0 ? m_latency.size() / secs : 0;
+        }
+
+        //! Answer of the request in frame, without its size. The child and lca requests with
+        //! right arguments are answered by run_batch.
+        std::string
+        answer(const std::string& frame) const {
+            std::string out;
+            uint64_t pos = 1;
+            put(out, (uint8_t) s_ok);
+            typename query_engine<t_cst>::query_type q;
+            q.op = q_count;
+            q.m = 0;
+            q.pattern = nullptr;
+            switch (frame.empty() ? 0xff : (uint8_t) frame[0]) {
+                case s_count:
+                    q.pattern = (const char_type*) frame.data() + 1;
+                    q.m = frame.size() - 1;
+                    put(out, (uint64_t) m_engine.execute(q).value);
+                    return out;
+                case s_locate: {
+                    uint64_t limit = 0;
+                    if (!get(frame, pos, limit))
+                        break;
+                    typename t_cst::csa_type::size_type l = 0, r = 0;
+                    uint64_t k = sdsl::backward_search(m_cst.csa, 0, m_cst.csa.size() - 1, frame.begin() + pos,
+                                                       frame.end(), l, r);
+                    std::vector<uint64_t> occ(std::min(k, limit));
+                    for (uint64_t i = 0; i < occ.size(); ++i)
+                        occ[i] = m_cst.csa[l + i];
+                    std::sort(occ.begin(), occ.end());
+                    put(out, (uint64_t) occ.size());
+                    out.append((const char*) occ.data(), occ.size() * sizeof(uint64_t));
+                    return out;
+                }
+                case s_ms: {
+                    std::vector<uint64_t> ms;
+                    matching_statistics(m_cst, frame.substr(1), ms);
+                    out.append((const char*) ms.data(), ms.size() * sizeof(uint64_t));
+                    return out;
+                }
+                case s_stats: {
+                    if (frame.size() != 1)
+                        break;
+                    put(out, (uint64_t) m_cst.size());
+                    put(out, m_requests);
+                    put(out, m_batches);
+                    put(out, (uint64_t) period_qps(clock_type::now()));
+                    put(out, percentile(0.5) / 1000);
+                    put(out, percentile(0.99) / 1000);
+                    return out;
+                }
+            }
+            out.assign(1, (char) s_bad_request);
+            return out;
+        }
+
+        //! Writes the answers of c that the socket accepts without blocking.
+        static void
+        write_answers(connection& c) {
+            uint64_t pos = 0;
+            while (pos < c.out.size()) {
+                ssize_t w = send(c.fd, c.out.data() + pos, c.out.size() - pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (w < 0 and errno == EINTR)
+                    continue;
+                if (w < 0 and (errno == EAGAIN or errno == EWOULDBLOCK))
+                    break;
+                if (w <= 0) { //the client closed the connection
+                    c.closing = true;
+                    break;
+                }
+                pos += w;
+            }
+            c.out.erase(0, pos);
+        }
+
+        //! Reads what is available in connection id and queues its complete requests.
+        void
+        read_requests(uint64_t id) {
+            connection& c = m_conn[id];
+            char buf[1 << 16];
+            ssize_t r = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r < 0 and (errno == EINTR or errno == EAGAIN or errno == EWOULDBLOCK))
+                return;
+            if (r == 0) { //its pending answers are still written
+                c.eof = true;
+                return;
+            }
+            if (r < 0) {
+                c.closing = true;
+                return;
+            }
+            c.in.append(buf, r);
+            auto now = clock_type::now();
+            uint64_t pos = 0;
+            uint32_t size = 0;
+            while (get(c.in, pos, size)) {
+                if (size > SERVER_MAX_FRAME) {
+                    c.closing = true;
+                    break;
+                }
+                if (pos + size > c.in.size()) {
+                    pos -= sizeof(size);
+                    break;
+                }
+                m_pending.push_back(request{id, c.in.substr(pos, size), now});
+                pos += size;
+            }
+            c.in.erase(0, pos);
+        }
+
+        //! Answers the pending requests and writes their answers.
+        void
+        run_batch() {
+            uint64_t n = m_pending.size();
+            std::vector<std::string> answers(n);
+            std::vector<uint64_t> single, child_id, lca_id;
+            std::vector<node_type> child_v, child_res, lca_v, lca_w, lca_res;
+            std::vector<char_type> child_c;
+            uint64_t lca_lb = m_cst.csa.size(), lca_rb = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                const std::string& frame = m_pending[i].frame;
+                uint8_t op = frame.empty() ? 0xff : (uint8_t) frame[0];
+                node_type v, w;
+                char_type c;
+                if (op == s_child and get_child(frame, v, c)) {
+                    child_id.push_back(i);
+                    child_v.push_back(v);
+                    child_c.push_back(c);
+                } else if (op == s_lca and get_lca(frame, v, w)) {
+                    lca_id.push_back(i);
+                    lca_v.push_back(v);
+                    lca_w.push_back(w);
+                    lca_lb = std::min<uint64_t>(lca_lb, std::min(m_cst.lb(v), m_cst.lb(w)));
+                    lca_rb = std::max<uint64_t>(lca_rb, std::max(m_cst.rb(v), m_cst.rb(w)));
+                } else
+                    single.push_back(i);
+            }
+            child_res.resize(child_id.size());
+            lca_res.resize(lca_id.size());
+            bool sweep = !lca_id.empty() and lca_rb - lca_lb <= SERVER_LCA_SWEEP * lca_id.size();
+            uint64_t chunk = SERVER_NODE_CHUNK;
+            uint64_t child_tasks = (child_id.size() + chunk - 1) / chunk;
+            uint64_t lca_tasks = sweep ? 0 : (lca_id.size() + chunk - 1) / chunk;
+            m_pool.run(single.size() + child_tasks + lca_tasks, [&](uint64_t t) {
+                if (t < single.size()) {
+                    answers[single[t]] = answer(m_pending[single[t]].frame);
+                    return;
+                }
+                t -= single.size();
+                bool child = t < child_tasks;
+                uint64_t from = (child ? t : t - child_tasks) * chunk;
+                uint64_t to = std::min(from + chunk, child ? child_id.size() : lca_id.size());
+                for (uint64_t k = from; k < to; ++k) {
+                    if (child)
+                        child_res[k] = m_cst.child(child_v[k], child_c[k]);
+                    else
+                        lca_res[k] = m_cst.lca(lca_v[k], lca_w[k]);
+                }
+            });
+            if (sweep)
+                lca_batch(m_cst, lca_v, lca_w, lca_res, std::max<uint64_t>(m_pool.threads(), 1));
+            for (uint64_t k = 0; k < child_id.size(); ++k)
+                answers[child_id[k]] = node_answer(child_res[k]);
+            for (uint64_t k = 0; k < lca_id.size(); ++k)
+                answers[lca_id[k]] = node_answer(lca_res[k]);
+            for (uint64_t i = 0; i < m_pending.size(); ++i) {
+                connection& c = m_conn[m_pending[i].conn];
+                put(c.out, (uint32_t) answers[i].size());
+                c.out += answers[i];
+            }
+            for (auto& c : m_conn)
+                if (!c.second.out.empty() and !c.second.closing)
+                    write_answers(c.second);
+            auto now = clock_type::now();
+            for (uint64_t i = 0; i < m_pending.size(); ++i)
+                m_latency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        now - m_pending[i].arrival).count());
+            m_requests += m_pending.size();
+            ++m_batches;
+            ++m_period_batches;
+            m_pending.clear();
+        }
+
+        void
+        report(std::ostream& log, clock_type::time_point now) {
+            log << "Requests: " << m_latency.size() << ", batches: " << m_period_batches << ", "
+                << period_qps(now) << " queries/sec, p50: " << percentile(0.5) / 1000.0 << " microsec, p99: "
+                << percentile(0.99) / 1000.0 << " microsec" << std::endl;
+            m_latency.clear();
+            m_period_batches = 0;
+            m_period_start = now;
+        }
+
+    public:
+        //! Constructor
+        /*!
+        * \param cst        Index served.
+        * \param threads    Threads that answer each batch.
+        * \param max_batch  Largest number of requests of a batch.
+        * \param window     Microseconds that the first request of a batch waits for others.
+        */
+        query_server(const t_cst& cst, uint64_t threads, uint64_t max_batch, uint64_t window)
+                : m_cst(cst), m_engine(cst, 1), m_pool(threads), m_max_batch(std::max<uint64_t>(max_batch, 1)),
+                  m_window(window) { }
+
+        query_server(const query_server&) = delete;
+        query_server& operator=(const query_server&) = delete;
+
+        ~query_server() {
+            for (auto& c : m_conn)
+                close(c.second.fd);
+            if (m_listen >= 0) {
+                close(m_listen);
+                unlink(m_path.c_str());
+            }
+        }
+
+        //! Creates the socket at path (replacing an old one). Returns false if it fails.
+        bool
+        listen(const std::string& path) {
+            sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(addr.sun_path))
+                return false;
+            strcpy(addr.sun_path, path.c_str());
+            m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (m_listen < 0)
+                return false;
+            unlink(path.c_str());
+            if (bind(m_listen, (sockaddr*) &addr, sizeof(addr)) != 0 or ::listen(m_listen, 128) != 0) {
+                close(m_listen);
+                m_listen = -1;
+                return false;
+            }
+            m_path = path;
+            return true;
+        }
+
+        //! Serves the requests until stop is set (e.g. by a signal handler), reporting the
+        //! statistics of each period of report_secs seconds (0 only at the end) to log.
+        template<class t_flag>
+        void
+        run(const t_flag& stop, uint64_t report_secs, std::ostream& log) {
+            m_period_start = clock_type::now();
+            auto last_report = m_period_start;
+            std::vector<pollfd> fds;
+            std::vector<uint64_t> ids;
+            while (!stop) {
+                fds.assign(1, pollfd{m_listen, POLLIN, 0});
+                ids.assign(1, 0);
+                for (auto& c : m_conn) {
+                    short events = (c.second.out.size() < SERVER_MAX_OUTPUT and !c.second.eof ? POLLIN : 0) |
+                                   (c.second.out.empty() ? 0 : POLLOUT);
+                    if (!c.second.closing and events != 0) {
+                        fds.push_back(pollfd{c.second.fd, events, 0});
+                        ids.push_back(c.first);
+                    }
+                }
+                int64_t wait = 100000; //microseconds
+                if (!m_pending.empty()) {
+                    int64_t waited = std::chrono::duration_cast<std::chrono::microseconds>(
+                            clock_type::now() - m_pending.front().arrival).count();
+                    wait = std::max<int64_t>((int64_t) m_window - waited, 0);
+                }
+                timespec timeout{(time_t) (wait / 1000000), (long) (wait % 1000000) * 1000};
+                int ready = ppoll(fds.data(), fds.size(), &timeout, nullptr);
+                if (ready < 0 and errno != EINTR)
+                    break;
+                for (uint64_t k = 1; ready > 0 and k < fds.size(); ++k) {
+                    connection& c = m_conn[ids[k]];
+                    if (fds[k].revents & (c.eof ? POLLOUT | POLLHUP | POLLERR : POLLOUT))
+                        write_answers(c); //a failed write closes c
+                    if (!c.eof and (fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+                        read_requests(ids[k]);
+                }
+                if (ready > 0 and (fds[0].revents & POLLIN)) {
+                    int fd = accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd >= 0)
+                        m_conn[++m_next_conn].fd = fd;
+                }
+                if (!m_pending.empty() and
+                    (m_pending.size() >= m_max_batch or
+                     std::chrono::duration_cast<std::chrono::microseconds>(
+                             clock_type::now() - m_pending.front().arrival).count() >= (int64_t) m_window))
+                    run_batch();
+                if (m_pending.empty()) { //no answer refers to them
+                    for (auto it = m_conn.begin(); it != m_conn.end();) {
+                        if (it->second.closing or (it->second.eof and it->second.out.empty())) {
+                            close(it->second.fd);
+                            it = m_conn.erase(it);
+                        } else
+                            ++it;
+                    }
+                }
+                auto now = clock_type::now();
+                if (report_secs > 0 and now - last_report >= std::chrono::seconds(report_secs)) {
+                    report(log, now);
+                    last_report = now;
+                }
+            }
+            if (!m_pending.empty())
+                run_batch();
+            report(log, clock_type::now());
+            log << "Total requests: " << m_requests << ", batches: " << m_batches << std::endl;
+        }
+    };
+
+}
+
+#endif //CST_CN_QUERY_SERVER_H
@@ -0,0 +1,357 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file sectioned_file.h
+    \brief sectioned_file.h contains the versioned header, with the checksum of each section, of the files that store the components of an index separately.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_SECTIONED_FILE_H
+#define CST_CN_SECTIONED_FILE_H
+
+#include <sdsl/io.hpp>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cstds {
+
+    //! First word of a sectioned file ("CSTCNSEC").
+    const uint64_t SECTIONED_MAGIC = 0x4345534e43545343ULL;
+
+    //! Version of the layout written by section_writer. The files written before the layout
+    //! had a version hold the number of sections (3) in its place, and the ones of version 2
+    //! hold the type of the index as named by the compiler; neither is read.
+    const uint64_t SECTIONED_VERSION = 3;
+
+    //! Limits of the header, so a damaged one is rejected before anything is allocated.
+    const uint64_t SECTIONED_MAX_SECTIONS = 64;
+    const uint64_t SECTIONED_MAX_STRING = 1 << 16;
+
+    //! Stable name of a component of an index, from which the type stored in the header of a
+    //! sectioned file is built (see cst_cn::format_type).
+    /*!
+    * Unlike the name given by typeid, it does not change with the compiler or with the
+    * namespaces of the library, so a file is read by every build of the programs with the
+    * same components. A component gives its name with a specialization whose static method
+    * name() returns it. The CSAs and LCPs of sdsl used by cst_cn are named in cst_cn.h.
+    */
+    template<class t_component>
+    struct format_tag;
+
+    //! Initial value of checksum.
+    const uint64_t CHECKSUM_SEED = 0xcbf29ce484222325ULL;
+
+    //! Adds n bytes of data to the checksum h (64-bit FNV-1a).
+    inline uint64_t
+    checksum(uint64_t h, const char* data, uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i)
+            h = (h ^ (uint8_t) data[i]) * 0x100000001b3ULL;
+        return h;
+    }
+
+    //! Header of a sectioned file.
+    /*!
+    * The file starts with SECTIONED_MAGIC, the version, the type of the index stored (see
+    * cst_cn::format_type and format_tag), the options given by the program that wrote it (createCST stores
+    * its -w, -c, -l, -b, -s and -x), the number of sections, the offset, size and checksum of
+    * each section, and the checksum of all the previous bytes of the header. Strings are
+    * stored as their length followed by their bytes and the integers as uint64. Reading the
+    * header validates the file in O(1): the checksums of the sections are only computed by
+    * verify_sections.
+    */
+    struct section_header {
+        uint64_t version = 0;
+        std::string type;
+        std::string options;
+        std::vector<uint64_t> offset;
+        std::vector<uint64_t> size;
+        std::vector<uint64_t> checksum;
+
+        //! Returns in value the value of the option -flag of options (false if it is not there).
+        bool
+        option(char flag, int& value) const {
+            std::istringstream in(options);
+            std::string name;
+            int v = 0;
+            while (in >> name >> v) {
+                if (name.size() == 2 and name[0] == '-' and name[1] == flag) {
+                    value = v;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    //! Stream buffer that writes to another one and keeps the checksum of what it writes.
+    class checksum_streambuf : public std::streambuf {
+    private:
+        std::streambuf* m_dst;
+        uint64_t m_checksum = CHECKSUM_SEED;
+
+    public:
+        explicit checksum_streambuf(std::streambuf* dst) : m_dst(dst) { }
+
+        uint64_t
+        value() const {
+            return m_checksum;
+        }
+
+        void
+        reset() {
+            m_checksum = CHECKSUM_SEED;
+        }
+
+    protected:
+        int_type
+        overflow(int_type c) override {
+            if (traits_type::eq_int_type(c, traits_type::eof()))
+                return traits_type::not_eof(c);
+            char ch = traits_type::to_char_type(c);
+            m_checksum = cstds::checksum(m_checksum, &ch, 1);
+            return m_dst->sputc(ch);
+        }
+
+        std::streamsize
+        xsputn(const char* s, std::streamsize n) override {
+            std::streamsize w = m_dst->sputn(s, n);
+            m_checksum = cstds::checksum(m_checksum, s, w);
+            return w;
+        }
+
+        int
+        sync() override {
+            return m_dst->pubsync();
+        }
+    };
+
+    //! Writes a sectioned file: its header (see section_header) followed by the sections.
+    /*!
+    * The header is written with empty entries first and filled by close(), so out must be
+    * seekable (e.g. an ofstream). Offsets are relative to the position of out when the
+    * writer is created. Each section is written to the stream returned by next(), which
+    * writes to out and computes its checksum.
+    */
+    class section_writer {
+    private:
+        std::ostream& m_out;
+        std::ostream::pos_type m_start;
+        section_header m_header;
+        checksum_streambuf m_buf;
+        std::ostream m_section;
+
+        //! end is the size of the whole file
+        void
+        write_header(uint64_t end) {
+            std::ostringstream header;
+            uint64_t sections = m_header.offset.size();
+            sdsl::write_member(SECTIONED_MAGIC, header);
+            sdsl::write_member(SECTIONED_VERSION, header);
+            sdsl::write_member((uint64_t) m_header.type.size(), header);
+            header.write(m_header.type.data(), m_header.type.size());
+            sdsl::write_member((uint64_t) m_header.options.size(), header);
+            header.write(m_header.options.data(), m_header.options.size());
+            sdsl::write_member(sections, header);
+            for (uint64_t i = 0; i < sections; ++i) {
+                uint64_t offset = m_header.offset[i] > 0 ? m_header.offset[i] : end;
+                uint64_t next = i + 1 < sections and m_header.offset[i + 1] > 0 ? m_header.offset[i + 1] : end;
+                sdsl::write_member(offset, header);
+                sdsl::write_member(next - offset, header);
+                sdsl::write_member(m_header.checksum[i], header);
+            }
+            std::string bytes = header.str();
+            sdsl::write_member(checksum(CHECKSUM_SEED, bytes.data(), bytes.size()), header);
+            bytes = header.str();
+            m_out.write(bytes.data(), bytes.size());
+        }
+
+        //! Stores the checksum of the section being written.
+        void
+        end_section() {
+            for (uint64_t i = m_header.offset.size(); i-- > 0;) {
+                if (m_header.offset[i] > 0) {
+                    m_section.flush();
+                    m_header.checksum[i] = m_buf.value();
+                    return;
+                }
+            }
+        }
+
+    public:
+        //! type and options are stored in the header (see section_header).
+        section_writer(std::ostream& out, uint64_t sections, const std::string& type, const std::string& options = "")
+                : m_out(out), m_start(out.tellp()), m_buf(out.rdbuf()), m_section(&m_buf) {
+            m_header.version = SECTIONED_VERSION;
+            m_header.type = type;
+            m_header.options = options;
+            m_header.offset.assign(sections, 0);
+            m_header.size.assign(sections, 0);
+            m_header.checksum.assign(sections, CHECKSUM_SEED);
+            write_header(0);
+        }
+
+        //! Starts the next section at the current position of out and returns the stream
+        //! where it has to be written.
+        std::ostream&
+        next() {
+            end_section();
+            for (uint64_t i = 0; i < m_header.offset.size(); ++i) {
+                if (m_header.offset[i] == 0) {
+                    m_out.flush();
+                    m_header.offset[i] = m_out.tellp() - m_start;
+                    break;
+                }
+            }
+            m_buf.reset();
+            return m_section;
+        }
+
+        //! Fills the header and returns the size of the whole file.
+        uint64_t
+        close() {
+            end_section();
+            m_out.flush();
+            uint64_t end = m_out.tellp() - m_start;
+            m_out.seekp(m_start);
+            write_header(end);
+            m_out.seekp(m_start + (std::streamoff) end);
+            return end;
+        }
+    };
+
+    //! Returns true if file starts with SECTIONED_MAGIC, whether its header is valid or not.
+    inline bool
+    is_sectioned_file(const std::string& file) {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+        uint64_t magic = 0;
+        sdsl::read_member(magic, in);
+        return in and magic == SECTIONED_MAGIC;
+    }
+
+    //! Loads idx from file, a sectioned file of its type (see section_writer) or, when file has
+    //! no header, a file written by its serialize method (legacy). legacy tells which one it
+    //! was: the type of a legacy file cannot be checked, so the caller should warn about it.
+    //! Returns false if file could not be read or is a sectioned file of another type.
+    template<class t_index>
+    bool
+    load_index_file(t_index& idx, const std::string& file, bool& legacy, uint64_t threads = 3) {
+        legacy = !is_sectioned_file(file);
+        if (!legacy)
+            return idx.load_sectioned(file, threads);
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+        if (!in)
+            return false;
+        idx.load(in);
+        return !in.fail();
+    }
+
+    //! Reads the header of a sectioned file from in. Returns false if in does not start with
+    //! SECTIONED_MAGIC, has another version or its header is damaged.
+    inline bool
+    read_section_header(std::istream& in, section_header& header) {
+        uint64_t magic = 0, sections = 0, length = 0, stored = 0;
+        std::string bytes;
+        auto read = [&](uint64_t& x) {
+            sdsl::read_member(x, in);
+            bytes.append((const char*) &x, sizeof(x));
+            return (bool) in;
+        };
+        auto read_string = [&](std::string& s) {
+            if (!read(length) or length > SECTIONED_MAX_STRING)
+                return false;
+            s.resize(length);
+            in.read(&s[0], length);
+            bytes += s;
+            return (bool) in;
+        };
+        if (!read(magic) or magic != SECTIONED_MAGIC or !read(header.version) or
+            header.version != SECTIONED_VERSION or !read_string(header.type) or !read_string(header.options) or
+            !read(sections) or sections > SECTIONED_MAX_SECTIONS)
+            return false;
+        header.offset.resize(sections);
+        header.size.resize(sections);
+        header.checksum.resize(sections);
+        for (uint64_t i = 0; i < sections; ++i)
+            if (!read(header.offset[i]) or !read(header.size[i]) or !read(header.checksum[i]))
+                return false;
+        sdsl::read_member(stored, in);
+        return in and stored == checksum(CHECKSUM_SEED, bytes.data(), bytes.size());
+    }
+
+    //! Reads the header of the sectioned file file (see read_section_header). Also returns
+    //! false if a section does not fit in the file (e.g. a truncated copy).
+    inline bool
+    read_section_header(const std::string& file, section_header& header) {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+        if (!read_section_header(in, header))
+            return false;
+        in.seekg(0, std::ios::end);
+        uint64_t end = in.tellg();
+        for (uint64_t i = 0; i < header.offset.size(); ++i)
+            if (header.offset[i] > end or header.size[i] > end - header.offset[i])
+                return false;
+        return (bool) in;
+    }
+
+    //! Reads the header of file and checks that it stores `sections` sections of an index
+    //! of the given type. Returns false otherwise, without reading any section.
+    inline bool
+    read_section_header(const std::string& file, const std::string& type, uint64_t sections,
+                        section_header& header) {
+        return read_section_header(file, header) and header.type == type and header.offset.size() == sections;
+    }
+
+    //! Reads the sections of file, each one by its own thread (up to `threads` at the same
+    //! time), and compares their checksums with the ones of header. Returns false if one
+    //! differs or cannot be read.
+    inline bool
+    verify_sections(const std::string& file, const section_header& header, uint64_t threads = 1) {
+        uint64_t n = header.offset.size();
+        std::vector<char> ok(n, 0);
+        auto verify = [&](uint64_t k) {
+            std::ifstream in(file, std::ios::in | std::ios::binary);
+            in.seekg(header.offset[k]);
+            std::vector<char> buf(1 << 20);
+            uint64_t h = CHECKSUM_SEED, left = header.size[k];
+            while (left > 0 and in) {
+                in.read(buf.data(), std::min<uint64_t>(buf.size(), left));
+                h = checksum(h, buf.data(), in.gcount());
+                left -= in.gcount();
+            }
+            ok[k] = left == 0 and h == header.checksum[k];
+        };
+        for (uint64_t from = 0; from < n; from += std::max<uint64_t>(threads, 1)) {
+            std::vector<std::thread> pool;
+            for (uint64_t k = from + 1; k < std::min(from + std::max<uint64_t>(threads, 1), n); ++k)
+                pool.emplace_back(verify, k);
+            verify(from);
+            for (auto& th : pool)
+                th.join();
+        }
+        for (char r : ok)
+            if (!r)
+                return false;
+        return true;
+    }
+
+}
+
+#endif //CST_CN_SECTIONED_FILE_H
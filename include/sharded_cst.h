@@ -0,0 +1,298 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file sharded_cst.h
+    \brief sharded_cst.h contains an index of a text split in shards, one CST per shard, queried in parallel.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_SHARDED_CST_H
+#define CST_CN_SHARDED_CST_H
+
+#include <sdsl/io.hpp>
+#include <sdsl/suffix_array_algorithm.hpp>
+#include "parallel.h"
+#include "text_input.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cstds {
+
+    //! First word of the file of a sharded index ("CSTCNSHD").
+    const uint64_t SHARDED_MAGIC = 0x4448534e43545343ULL;
+
+    //! Name of the file of shard i of the sharded index stored in file.
+    inline std::string
+    shard_file_name(const std::string& file, uint64_t i) {
+        return file + ".shard_" + std::to_string(i);
+    }
+
+    //! An index of a text T split in shards, each one indexed by its own CST, that answers
+    //! count, locate and longest_match by querying all the shards in parallel.
+    /*!
+    * Shard i owns the positions [start_i, start_i+1) of T, but its CST indexes them followed
+    * by the next `overlap` symbols of T (its overlap region), so every occurrence of a pattern
+    * of up to overlap + 1 symbols that starts in shard i is found in shard i, even if it
+    * crosses the end of the shard. The occurrences that start in the overlap region belong to
+    * the next shard and are discarded when the results are merged. Longer patterns only miss
+    * the occurrences that cross a boundary.
+    *
+    * The file of the index stores SHARDED_MAGIC, the number of shards, the overlap, |T| and
+    * the start of each shard; the CST of shard i is stored in shard_file_name(file, i).
+    * The CSTs must be over a byte alphabet and are never modified by the queries, so the
+    * query methods can be called from several threads (a job at a time runs on the pool).
+    */
+    template<class t_cst>
+    class sharded_cst {
+        static_assert(t_cst::csa_type::alphabet_category::WIDTH == 8, "sharded_cst needs a byte alphabet");
+
+    public:
+        typedef t_cst cst_type;
+
+    private:
+        std::vector<std::unique_ptr<t_cst>> m_shard;
+        std::vector<uint64_t> m_start; //start of each shard in T, followed by |T|
+        std::vector<std::string> m_tail; //overlap region of each shard
+        uint64_t m_overlap = 0;
+        std::unique_ptr<task_pool> m_pool;
+
+        //! Occurrences of pattern, possibly overlapping, inside text.
+        static uint64_t
+        occurrences(const std::string& text, const std::string& pattern) {
+            uint64_t count = 0;
+            if (pattern.empty())
+                return 0;
+            for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+                ++count;
+            return count;
+        }
+
+        //! Number of symbols of T owned by shard i.
+        uint64_t
+        owned(uint64_t i) const {
+            return m_start[i + 1] - m_start[i];
+        }
+
+    public:
+        sharded_cst() = default;
+        sharded_cst(const sharded_cst&) = delete;
+        sharded_cst& operator=(const sharded_cst&) = delete;
+
+        //! Splits the plain file in `shards` shards of the same size with `overlap` extra
+        //! symbols each and builds their CSTs, up to `threads` shards at the same time, with
+        //! build_shard(cst, shard_text_file, config) (e.g. calling construct_cst_cn), which
+        //! returns false if the shard could not be built. The texts of the shards are written
+        //! to tmp_dir while they are built. Returns false if the file cannot be split or a
+        //! shard could not be built or written.
+        template<class t_build>
+        static bool
+        build(const std::string& file, const std::string& out_file, uint64_t shards, uint64_t overlap,
+              const std::string& tmp_dir, uint64_t threads, t_build build_shard) {
+            if (!is_plain_input(file)) {
+                std::cerr << "Error: the shards are cut from a regular file that is not compressed" << std::endl;
+                return false;
+            }
+            std::ifstream in(file, std::ios::in | std::ios::binary | std::ios::ate);
+            uint64_t n = in.tellg();
+            if (shards == 0 or n < shards) {
+                std::cerr << "Error: " << file << " cannot be split in " << shards << " shards" << std::endl;
+                return false;
+            }
+            std::vector<uint64_t> start(shards + 1);
+            for (uint64_t i = 0; i <= shards; ++i)
+                start[i] = n / shards * i + std::min(i, n % shards);
+            std::vector<char> ok(shards, 0);
+            task_pool pool(std::min(threads, shards));
+            pool.run(shards, [&](uint64_t i) {
+                std::string id = sdsl::util::basename(file) + "_shard_" + std::to_string(i);
+                std::string text_file = tmp_dir + "/" + id;
+                {
+                    std::ifstream src(file, std::ios::in | std::ios::binary);
+                    std::ofstream dst(text_file, std::ios::out | std::ios::binary);
+                    std::vector<char> buf(1 << 20);
+                    uint64_t pos = start[i], end = std::min(start[i + 1] + overlap, n);
+                    src.seekg(pos);
+                    while (pos < end and src) {
+                        uint64_t len = std::min<uint64_t>(buf.size(), end - pos);
+                        src.read(buf.data(), len);
+                        dst.write(buf.data(), src.gcount());
+                        pos += src.gcount();
+                    }
+                    if (pos != end or !dst)
+                        return;
+                }
+                sdsl::cache_config config(true, tmp_dir, id);
+                t_cst cst;
+                bool built = build_shard(cst, text_file, config);
+                std::remove(text_file.c_str());
+                if (!built)
+                    return;
+                std::ofstream out(shard_file_name(out_file, i), std::ios::out | std::ios::binary);
+                cst.serialize(out);
+                ok[i] = (bool) out;
+            });
+            for (char r : ok)
+                if (!r)
+                    return false;
+            std::ofstream out(out_file, std::ios::out | std::ios::binary);
+            sdsl::write_member(SHARDED_MAGIC, out);
+            sdsl::write_member(shards, out);
+            sdsl::write_member(overlap, out);
+            for (uint64_t i = 0; i <= shards; ++i)
+                sdsl::write_member(start[i], out);
+            return (bool) out;
+        }
+
+        //! Loads the index stored in file by build, up to `threads` shards at the same time.
+        //! The same threads answer the queries later. Returns false if it cannot be read.
+        bool
+        load(const std::string& file, uint64_t threads) {
+            std::ifstream in(file, std::ios::in | std::ios::binary);
+            uint64_t magic = 0, shards = 0;
+            sdsl::read_member(magic, in);
+            sdsl::read_member(shards, in);
+            sdsl::read_member(m_overlap, in);
+            if (!in or magic != SHARDED_MAGIC or shards == 0)
+                return false;
+            m_start.resize(shards + 1);
+            for (uint64_t i = 0; i <= shards; ++i)
+                sdsl::read_member(m_start[i], in);
+            if (!in)
+                return false;
+            m_pool.reset(new task_pool(threads));
+            m_shard.clear();
+            m_tail.assign(shards, std::string());
+            std::vector<char> ok(shards, 0);
+            for (uint64_t i = 0; i < shards; ++i)
+                m_shard.emplace_back(new t_cst());
+            m_pool->run(shards, [&](uint64_t i) {
+                std::ifstream shard_in(shard_file_name(file, i), std::ios::in | std::ios::binary);
+                if (!shard_in)
+                    return;
+                m_shard[i]->load(shard_in);
+                const auto& csa = m_shard[i]->csa;
+                if (!shard_in or csa.size() < owned(i) + 1)
+                    return;
+                if (csa.size() > owned(i) + 1) { //the last symbol of the text is the 0 one
+                    auto tail = sdsl::extract(csa, owned(i), csa.size() - 2);
+                    m_tail[i].assign(tail.begin(), tail.end());
+                }
+                ok[i] = 1;
+            });
+            for (char r : ok)
+                if (!r)
+                    return false;
+            return true;
+        }
+
+        //! Number of shards.
+        uint64_t
+        shards() const {
+            return m_shard.size();
+        }
+
+        //! The CST of shard i.
+        const t_cst&
+        shard(uint64_t i) const {
+            return *m_shard[i];
+        }
+
+        //! Position of T where shard i starts.
+        uint64_t
+        start(uint64_t i) const {
+            return m_start[i];
+        }
+
+        //! Length of T.
+        uint64_t
+        size() const {
+            return m_start.empty() ? 0 : m_start.back();
+        }
+
+        //! Longest pattern whose occurrences are all found.
+        uint64_t
+        max_pattern_length() const {
+            return m_overlap + 1;
+        }
+
+        //! Number of occurrences of pattern in T.
+        uint64_t
+        count(const std::string& pattern) const {
+            std::vector<uint64_t> counts(shards(), 0);
+            m_pool->run(shards(), [&](uint64_t i) {
+                uint64_t c = sdsl::count(m_shard[i]->csa, pattern.begin(), pattern.end());
+                counts[i] = c - occurrences(m_tail[i], pattern);
+            });
+            uint64_t total = 0;
+            for (uint64_t c : counts)
+                total += c;
+            return total;
+        }
+
+        //! Positions of T where pattern occurs, in increasing order.
+        std::vector<uint64_t>
+        locate(const std::string& pattern) const {
+            std::vector<std::vector<uint64_t>> found(shards());
+            m_pool->run(shards(), [&](uint64_t i) {
+                auto occ = sdsl::locate(m_shard[i]->csa, pattern.begin(), pattern.end());
+                for (uint64_t k = 0; k < occ.size(); ++k)
+                    if (occ[k] < owned(i))
+                        found[i].push_back(m_start[i] + occ[k]);
+                std::sort(found[i].begin(), found[i].end());
+            });
+            std::vector<uint64_t> res;
+            for (auto& f : found) //the shards are in text order
+                res.insert(res.end(), f.begin(), f.end());
+            return res;
+        }
+
+        //! Longest prefix of pattern that occurs in T, as its length and one of its positions
+        //! (the smallest position among the shards that have it). The length is exact up to
+        //! max_pattern_length(). Returns (0, 0) if not even the first symbol occurs.
+        std::pair<uint64_t, uint64_t>
+        longest_match(const std::string& pattern) const {
+            std::vector<std::pair<uint64_t, uint64_t>> best(shards(), std::make_pair(0, 0));
+            m_pool->run(shards(), [&](uint64_t i) {
+                const auto& csa = m_shard[i]->csa;
+                typename t_cst::csa_type::size_type l = 0, r = 0;
+                uint64_t lo = 0, hi = pattern.size(), pos = 0; //the prefix of lo symbols occurs
+                while (lo < hi) {
+                    uint64_t mid = lo + (hi - lo + 1) / 2;
+                    if (sdsl::backward_search(csa, 0, csa.size() - 1, pattern.begin(), pattern.begin() + mid,
+                                              l, r) > 0) {
+                        lo = mid;
+                        pos = csa[l];
+                    } else
+                        hi = mid - 1;
+                }
+                best[i] = std::make_pair(lo, lo > 0 ? m_start[i] + pos : 0);
+            });
+            std::pair<uint64_t, uint64_t> res(0, 0);
+            for (auto& b : best)
+                if (b.first > res.first)
+                    res = b;
+            return res;
+        }
+    };
+
+}
+
+#endif //CST_CN_SHARDED_CST_H
@@ -0,0 +1,194 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file text_input.h
+    \brief text_input.h contains the readers of the input text: files, stdin, gzip/zstd streams and lists of files.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_TEXT_INPUT_H
+#define CST_CN_TEXT_INPUT_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace cstds {
+
+    //! Name of the input that is read from the standard input.
+    const std::string STDIN_INPUT = "-";
+
+    //! Symbol placed between the texts of a list of files (the one used by merge_cst_cn).
+    const uint8_t INPUT_SEPARATOR = 1;
+
+    //! Returns the program that decompresses a file starting with the len bytes of magic
+    //! (gzip or zstd), or nullptr if it is not compressed.
+    inline const char*
+    decompressor_of(const unsigned char* magic, int64_t len) {
+        if (len >= 2 and magic[0] == 0x1f and magic[1] == 0x8b)
+            return "gzip";
+        if (len >= 4 and magic[0] == 0x28 and magic[1] == 0xb5 and magic[2] == 0x2f and magic[3] == 0xfd)
+            return "zstd";
+        return nullptr;
+    }
+
+    //! Sequential reader of one input: a file, the standard input ("-"), or a gzip or zstd
+    //! file, which is decompressed on the fly by gzip -dc or zstd -dc in a child process.
+    //! The format of a file is taken from its first bytes, not from its name.
+    class text_source {
+    private:
+        int m_fd = -1;
+        pid_t m_pid = 0; //decompressor, 0 if none
+
+        //! Starts decompressor reading from fd and keeps the read end of its output.
+        bool
+        start_decompressor(int fd, const char* decompressor) {
+            int out[2];
+            if (pipe(out) != 0)
+                return false;
+            m_pid = fork();
+            if (m_pid < 0) {
+                m_pid = 0;
+                ::close(out[0]);
+                ::close(out[1]);
+                return false;
+            }
+            if (m_pid == 0) { //child
+                dup2(fd, STDIN_FILENO);
+                dup2(out[1], STDOUT_FILENO);
+                ::close(fd);
+                ::close(out[0]);
+                ::close(out[1]);
+                execlp(decompressor, decompressor, "-dc", (char*) nullptr);
+                _exit(127);
+            }
+            ::close(fd);
+            ::close(out[1]);
+            m_fd = out[0];
+            return true;
+        }
+
+    public:
+        explicit text_source(const std::string& name) {
+            if (name == STDIN_INPUT) {
+                m_fd = STDIN_FILENO;
+                return;
+            }
+            int fd = open(name.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            unsigned char magic[4] = {0, 0, 0, 0};
+            const char* decompressor = decompressor_of(magic, pread(fd, magic, 4, 0));
+            if (decompressor == nullptr)
+                m_fd = fd;
+            else if (!start_decompressor(fd, decompressor))
+                ::close(fd);
+        }
+
+        text_source(const text_source&) = delete;
+        text_source& operator=(const text_source&) = delete;
+
+        ~text_source() {
+            close();
+        }
+
+        //! Returns false if the input could not be opened.
+        bool
+        good() const {
+            return m_fd >= 0;
+        }
+
+        //! Reads up to len bytes into buf. Returns 0 at the end of the input and -1 on errors.
+        ssize_t
+        read(char* buf, size_t len) {
+            ssize_t r;
+            do {
+                r = ::read(m_fd, buf, len);
+            } while (r < 0 and errno == EINTR);
+            return r;
+        }
+
+        //! Closes the input. Returns false if the decompressor failed.
+        bool
+        close() {
+            bool ok = true;
+            if (m_fd > STDIN_FILENO)
+                ::close(m_fd);
+            m_fd = -1;
+            if (m_pid > 0) {
+                int status = 0;
+                waitpid(m_pid, &status, 0);
+                ok = WIFEXITED(status) and WEXITSTATUS(status) == 0;
+                m_pid = 0;
+            }
+            return ok;
+        }
+    };
+
+    //! Returns the inputs named by spec: "@list_file" names the files listed in list_file,
+    //! one per line, and any other spec is a single input (a file or "-").
+    inline std::vector<std::string>
+    input_files(const std::string& spec) {
+        std::vector<std::string> files;
+        if (spec.empty() or spec[0] != '@') {
+            files.push_back(spec);
+            return files;
+        }
+        std::ifstream list(spec.substr(1));
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() and line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                files.push_back(line);
+        }
+        return files;
+    }
+
+    //! Returns true if spec is one regular file that is not compressed, which sdsl can load
+    //! by itself.
+    inline bool
+    is_plain_input(const std::string& spec) {
+        struct stat st;
+        if (spec == STDIN_INPUT or (!spec.empty() and spec[0] == '@') or stat(spec.c_str(), &st) != 0 or
+            !S_ISREG(st.st_mode))
+            return false;
+        unsigned char magic[4] = {0, 0, 0, 0};
+        std::ifstream in(spec, std::ios::binary);
+        in.read((char*) magic, 4);
+        return decompressor_of(magic, in.gcount()) == nullptr;
+    }
+
+    //! Name used for the cache files and the default output of spec.
+    inline std::string
+    input_name(const std::string& spec) {
+        if (spec == STDIN_INPUT)
+            return "stdin";
+        if (!spec.empty() and spec[0] == '@')
+            return spec.substr(1);
+        return spec;
+    }
+
+}
+
+#endif //CST_CN_TEXT_INPUT_H
@@ -0,0 +1,189 @@
+/* cstds - compressed suffix tree data structure
+Copyright (C)2016-2017 Rodrigo Canovas
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+
+/*! \file top_tree.h
+    \brief top_tree.h contains an explicit representation of the upper part of a suffix tree.
+    \author Rodrigo Canovas
+*/
+
+#ifndef CST_CN_TOP_TREE_H
+#define CST_CN_TOP_TREE_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace cstds {
+
+    //! A class that stores explicitly the nodes of a CST having at least `threshold` leaves.
+    /*!
+    * The nodes are kept in preorder together with their string depth, their parent
+    * and the list of all their children (sorted by the first character of the edge).
+    * Node ids within the top tree are the preorder ranks.
+    * \tparam t_size  Type used for positions.
+    * \tparam t_char  Type of the characters of the text.
+    */
+    template<class t_size = uint64_t, class t_char = uint8_t>
+    class top_tree {
+
+    public:
+        typedef t_size                          size_type;
+        typedef t_char                          char_type;
+        typedef std::pair<size_type, size_type> node_type;
+
+    private:
+        size_type m_threshold = 0;
+        std::vector<node_type> m_nodes;       //top nodes in preorder
+        std::vector<size_type> m_depth;       //string depth of each top node
+        std::vector<size_type> m_parent;      //preorder rank of the parent of each top node
+        std::vector<size_type> m_first_child; //start of the children of each top node in m_children
+        std::vector<node_type> m_children;    //children of the top nodes
+        std::vector<char_type> m_child_char;  //first character of the edge label of each child
+
+    public:
+
+        //! Default constructor
+        top_tree() {}
+
+        //! Constructor. Traverses `cst` from the root and keeps every node with at least threshold leaves.
+        template<class t_cst>
+        top_tree(const t_cst& cst, size_type threshold) {
+            m_threshold = threshold;
+            if (cst.size() == 0 or threshold == 0)
+                return;
+            std::vector<std::pair<node_type, size_type> > stack; //(node, parent rank)
+            std::vector<node_type> ch;
+            stack.push_back(std::make_pair(cst.root(), (size_type)0));
+            while (!stack.empty()) {
+                node_type v = stack.back().first;
+                size_type p = stack.back().second, rank = m_nodes.size();
+                size_type d = cst.depth(v);
+                stack.pop_back();
+                m_nodes.push_back(v);
+                m_depth.push_back(d);
+                m_parent.push_back(p);
+                m_first_child.push_back(m_children.size());
+                ch.clear();
+                for (node_type w = cst.select_child(v, 1); w != cst.root(); w = cst.sibling(w)) {
+                    ch.push_back(w);
+                    m_children.push_back(w);
+                    m_child_char.push_back(cst.edge(w, d + 1));
+                }
+                for (size_type i = ch.size(); i > 0; --i) { //reverse order to keep the preorder
+                    if (!cst.is_leaf(ch[i - 1]) and cst.size(ch[i - 1]) >= threshold)
+                        stack.push_back(std::make_pair(ch[i - 1], rank));
+                }
+            }
+            m_first_child.push_back(m_children.size());
+        }
+
+        //! Swap method for top_tree
+        void
+        swap(top_tree& tt) {
+            std::swap(m_threshold, tt.m_threshold);
+            m_nodes.swap(tt.m_nodes);
+            m_depth.swap(tt.m_depth);
+            m_parent.swap(tt.m_parent);
+            m_first_child.swap(tt.m_first_child);
+            m_children.swap(tt.m_children);
+            m_child_char.swap(tt.m_child_char);
+        }
+
+        //! Returns if the top tree is empty.
+        bool
+        empty() const {
+            return m_nodes.empty();
+        }
+
+        //! Number of nodes stored.
+        size_type
+        size() const {
+            return m_nodes.size();
+        }
+
+        //! Minimum number of leaves of the nodes stored.
+        size_type
+        threshold() const {
+            return m_threshold;
+        }
+
+        //! Returns the preorder rank of v within the top tree, or size() if v is not stored.
+        size_type
+        find(const node_type& v) const {
+            if (m_nodes.empty() or v.second - v.first + 1 < m_threshold)
+                return m_nodes.size();
+            auto it = std::lower_bound(m_nodes.begin(), m_nodes.end(), v,
+                                       [](const node_type& a, const node_type& b) {
+                                           return a.first < b.first or (a.first == b.first and a.second > b.second);
+                                       });
+            if (it == m_nodes.end() or *it != v)
+                return m_nodes.size();
+            return it - m_nodes.begin();
+        }
+
+        //! Node with preorder rank t.
+        node_type
+        node(size_type t) const {
+            return m_nodes[t];
+        }
+
+        //! String depth of the node with preorder rank t.
+        size_type
+        depth(size_type t) const {
+            return m_depth[t];
+        }
+
+        //! Parent of the node with preorder rank t (the root is its own parent).
+        node_type
+        parent(size_type t) const {
+            return m_nodes[m_parent[t]];
+        }
+
+        //! Number of children of the node with preorder rank t.
+        size_type
+        degree(size_type t) const {
+            return m_first_child[t + 1] - m_first_child[t];
+        }
+
+        //! The i-th child (1-based) of the node with preorder rank t. Returns m_nodes[0] (the root) if it does not exist.
+        node_type
+        select_child(size_type t, size_type i) const {
+            if (i > degree(t))
+                return m_nodes[0];
+            return m_children[m_first_child[t] + i - 1];
+        }
+
+        //! Child of the node with preorder rank t whose edge label starts with c. Returns the root if it does not exist.
+        node_type
+        child(size_type t, const char_type c) const {
+            auto first = m_child_char.begin() + m_first_child[t];
+            auto last = m_child_char.begin() + m_first_child[t + 1];
+            auto it = std::lower_bound(first, last, c);
+            if (it == last or *it != c)
+                return m_nodes[0];
+            return m_children[it - m_child_char.begin()];
+        }
+
+        //! Approximate size in bytes of the top tree.
+        size_type
+        size_in_bytes() const {
+            return m_nodes.size() * (sizeof(node_type) + 3 * sizeof(size_type)) +
+                   m_children.size() * (sizeof(node_type) + sizeof(char_type));
+        }
+
+    }; //end class
+
+}
+
+#endif //CST_CN_TOP_TREE_H
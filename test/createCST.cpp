@@ -14,23 +14,236 @@
 
 
 #include <iostream>
+#include <sstream>
 #include <sdsl/suffix_trees.hpp>
 #include "../include/cst_cn.h"
+#include "../include/construct_cst_cn.h"
+#include "../include/merge_cst_cn.h"
+#include "../include/sharded_cst.h"
 
 using namespace std;
 
+//! CSAs over an integer alphabet (-x option)
+typedef csa_wt<wt_int<>, 32, 64, sa_order_sa_sampling<>, isa_sampling<>, int_alphabet<> > csa_wt_int;
+typedef csa_sada<enc_vector<>, 32, 64, sa_order_sa_sampling<>, isa_sampling<>, int_alphabet<> > csa_sada_int;
+
+template<class idx_type, class src_type, class... t_npr_args>
+bool
+convert_index(idx_type& idx, string src_file, sdsl::cache_config& config, uint64_t threads, std::true_type,
+              t_npr_args... npr_args) {
+    src_type src;
+    if (!load_from_file(src, src_file)) {
+        cout << "Error: the index " << src_file << " could not be loaded" << endl;
+        return false;
+    }
+    idx_type tmp(src, config, threads, npr_args...);
+    tmp.swap(idx);
+    if (config.delete_files)
+        sdsl::util::delete_all_files(config.file_map);
+    return true;
+}
+
+template<class idx_type, class src_type, class... t_npr_args>
+bool
+convert_index(idx_type&, string, sdsl::cache_config&, uint64_t, std::false_type, t_npr_args...) {
+    cout << "Error: the CSA chosen with -c must be the one of the source index" << endl;
+    return false;
+}
+
+//! Builds idx from an index created by this program with -w 2 or 3. Its type is taken from
+//! the extension of src_file.
+template<class idx_type, class src_csa, class... t_npr_args>
+bool
+convert_from_file(idx_type& idx, string src_file, sdsl::cache_config& config, uint64_t threads, t_npr_args... npr_args) {
+    typedef typename idx_type::csa_type csa_type;
+    std::is_same<csa_type, src_csa> same_csa;
+    if (src_file.find(".cst_sada_") != string::npos and src_file.find("_dac") != string::npos)
+        return convert_index<idx_type, sdsl::cst_sada<csa_type, lcp_dac<> > >(idx, src_file, config, threads, same_csa,
+                                                                                       npr_args...);
+    else if (src_file.find(".cst_sada_") != string::npos and src_file.find("_t2") != string::npos)
+        return convert_index<idx_type, sdsl::cst_sada<csa_type, lcp_support_tree2<> > >(idx, src_file, config, threads, same_csa,
+                                                                                       npr_args...);
+    else if (src_file.find(".cst_sct3_") != string::npos and src_file.find("_dac") != string::npos)
+        return convert_index<idx_type, sdsl::cst_sct3<csa_type, lcp_dac<> > >(idx, src_file, config, threads, same_csa,
+                                                                                       npr_args...);
+    else if (src_file.find(".cst_sct3_") != string::npos and src_file.find("_t2") != string::npos)
+        return convert_index<idx_type, sdsl::cst_sct3<csa_type, lcp_support_tree2<> > >(idx, src_file, config, threads, same_csa,
+                                                                                       npr_args...);
+    cout << "Error: " << src_file << " is not a CST_SADA or CST_SCT3 index created by this program" << endl;
+    return false;
+}
+
+//! Options of the command line that choose how the index is built and stored.
+struct build_options {
+    string file;
+    string tmp_dir = "/tmp";                //-t
+    string out_file;                        //-o
+    uint64_t threads = 1;                   //-p
+    uint64_t mem_hint = 0;                //-m, in bytes
+    bool convert = false;                   //-i
+    string merge_file;                      //-a
+    bool sectioned = true;                  //-S (false: legacy format, with no header)
+    string options;                         //stored in the header of a sectioned index
+    uint64_t shards = 0;                    //-k
+    uint64_t overlap = 64;                  //-O
+    uint64_t npr_bs = 0;                    //-b, for NPR-CN-DYN
+    vector<uint64_t> npr_fanout;            //-f, for NPR-CN-DYN
+    uint8_t num_bytes = 1;                  //-x
+};
+
+//! Builds idx as opt says. Returns false if it could not be built.
+template<class idx_type>
+bool
+build_index(idx_type& idx, const build_options& opt, sdsl::cache_config& config) {
+    if (opt.convert or !opt.merge_file.empty()) {
+        cout << "Error: only CST_CN can be built from another index" << endl;
+        return false;
+    }
+    if (!cstds::is_plain_input(opt.file)) {
+        cout << "Error: only CST_CN can be built from stdin, compressed files or lists of files" << endl;
+        return false;
+    }
+    construct(idx, opt.file, config, 1);
+    return idx.size() > 0; //construct leaves idx empty if the text cannot be parsed
+}
+
+//! Builds idx from the indexes stored in file and merge_file, created by this program with
+//! the same options. Returns false if they could not be loaded or merged.
+template<class idx_type, class... t_npr_args>
+bool
+merge_indexes(idx_type& idx, string file, string merge_file, sdsl::cache_config& config, uint64_t threads,
+              std::true_type, t_npr_args... npr_args) {
+    idx_type idx1, idx2;
+    bool legacy1 = false, legacy2 = false;
+    if (!cstds::load_index_file(idx1, file, legacy1) or !cstds::load_index_file(idx2, merge_file, legacy2)) {
+        cout << "Error: the indexes " << file << " and " << merge_file << " could not be loaded" << endl;
+        return false;
+    }
+    if (legacy1 or legacy2)
+        cout << "Warning: " << (legacy1 ? file : merge_file)
+             << " has no header (legacy format), so its type is not checked against -w, -c, -l, -b and -s" << endl;
+    return cstds::merge_cst_cn(idx, idx1, idx2, config, threads, npr_args...);
+}
+
+template<class idx_type, class... t_npr_args>
+bool
+merge_indexes(idx_type&, string, string, sdsl::cache_config&, uint64_t, std::false_type, t_npr_args...) {
+    cout << "Error: only indexes over a byte alphabet can be merged" << endl;
+    return false;
+}
+
+template<class idx_type, class... t_npr_args>
+bool
+build_cst_cn(idx_type& idx, const build_options& opt, sdsl::cache_config& config, t_npr_args... npr_args) {
+    std::integral_constant<bool, idx_type::alphabet_category::WIDTH == 8> byte_alphabet;
+    if (!opt.merge_file.empty() and opt.convert) {
+        cout << "Error: the -i and -a options cannot be used together" << endl;
+        return false;
+    }
+    if (!opt.merge_file.empty())
+        return merge_indexes(idx, opt.file, opt.merge_file, config, opt.threads, byte_alphabet, npr_args...);
+    if (!opt.convert)
+        return cstds::construct_cst_cn(idx, opt.file, config, opt.num_bytes, opt.threads, opt.mem_hint,
+                                       npr_args...);
+    if (opt.file.find("_wt_") != string::npos)
+        return convert_from_file<idx_type, csa_wt<> >(idx, opt.file, config, opt.threads, npr_args...);
+    return convert_from_file<idx_type, csa_sada<> >(idx, opt.file, config, opt.threads, npr_args...);
+}
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs>
+bool
+build_index(cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs>& idx, const build_options& opt, sdsl::cache_config& config) {
+    return build_cst_cn(idx, opt, config);
+}
+
+//! The block size, or the fanout of each level, of NPR-CN-DYN is chosen at construction time
+template<class t_csa, class t_lcp, uint8_t bs, uint8_t sbs>
+bool
+build_index(cstds::cst_cn<t_csa, t_lcp, cstds::npr_support_cn_dyn, bs, sbs>& idx, const build_options& opt,
+            sdsl::cache_config& config) {
+    if (opt.npr_fanout.empty())
+        return build_cst_cn(idx, opt, config, opt.npr_bs);
+    return build_cst_cn(idx, opt, config, opt.npr_fanout);
+}
+
+template<class idx_type>
+uint64_t
+serialize_index(const idx_type& idx, ostream& out, bool sectioned, const string&) {
+    if (sectioned)
+        cout << "Error: only CST_CN can be stored in sections, the index is stored as usual" << endl;
+    return idx.serialize(out);
+}
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs>
+uint64_t
+serialize_index(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs>& idx, ostream& out, bool sectioned,
+                const string& options) {
+    return sectioned ? idx.serialize_sectioned(out, options) : idx.serialize(out);
+}
+
+//! Builds an index of each shard of opt.file, up to opt.threads shards at the same time, and
+//! the file of the sharded index (see cstds::sharded_cst). The memory hint is split among
+//! the shards built at the same time.
+template<class idx_type>
+bool
+build_sharded(const build_options& opt, std::true_type) {
+    uint64_t concurrent = std::max<uint64_t>(1, std::min(opt.threads, opt.shards));
+    return cstds::sharded_cst<idx_type>::build(opt.file, opt.out_file, opt.shards, opt.overlap, opt.tmp_dir,
+                                               opt.threads,
+                                               [&](idx_type& idx, const string& shard_file, sdsl::cache_config& config) {
+                                                   build_options shard = opt;
+                                                   shard.file = shard_file;
+                                                   shard.threads = 1;
+                                                   shard.mem_hint = opt.mem_hint / concurrent;
+                                                   return build_index(idx, shard, config);
+                                               });
+}
+
+template<class idx_type>
+bool
+build_sharded(const build_options&, std::false_type) {
+    cout << "Error: only indexes over a byte alphabet can be sharded" << endl;
+    return false;
+}
+
 template<class idx_type>
 void
-create_index(string file, string tmp_dir, string out_file) {
+create_index(const build_options& opt) {
     using timer = std::chrono::high_resolution_clock;
     auto start = timer::now();
+    if (opt.shards > 0) {
+        std::integral_constant<bool, idx_type::csa_type::alphabet_category::WIDTH == 8> byte_alphabet;
+        if (opt.convert or !opt.merge_file.empty() or opt.sectioned)
+            cout << "Error: the -k option cannot be used with -i, -a or -S 1" << endl;
+        else if (build_sharded<idx_type>(opt, byte_alphabet)) {
+            auto elapsed = timer::now() - start;
+            cout << "Shards: " << opt.shards << " (overlap " << opt.overlap << ")" << endl;
+            cout << "Construction time: " << (chrono::duration_cast<chrono::seconds>(elapsed).count() * 1.0) << " seconds"
+                 << endl;
+        } else
+            cout << "Error: the sharded index could not be built" << endl;
+        return;
+    }
     idx_type idx;
-    string id = sdsl::util::basename(file);
-    sdsl::cache_config config(true, tmp_dir, id); //true -->erase tmp
-    construct(idx, file, config, 1);
-    ofstream out(out_file);
+    string id = sdsl::util::basename(cstds::input_name(opt.file));
+    sdsl::cache_config config(true, opt.tmp_dir, id); //true -->erase tmp
+    bool built;
+    {
+        cstds::construction_report::phase phase("build");
+        built = build_index(idx, opt, config);
+    }
+    if (!built) {
+        cout << "Error: the index could not be built, " << opt.out_file << " is not written" << endl;
+        return;
+    }
+    ofstream out(opt.out_file);
     std::cout << "Size Text: " << idx.size() << std::endl;
-    uint64_t bytes_size = idx.serialize(out);
+    uint64_t bytes_size;
+    {
+        cstds::construction_report::phase phase("serialize");
+        bytes_size = serialize_index(idx, out, opt.sectioned, opt.options);
+        out.flush();
+    }
     auto stop = timer::now();
     auto elapsed = stop - start;
     cout << "Construction time: " << ((chrono::duration_cast<chrono::seconds>(elapsed).count() * 1.0)) << " seconds" << endl;
@@ -42,6 +255,7 @@ int main(int argc, char* argv[]) {
 
     if(argc < 2) {
         cout << "Usage: " << argv[0] << " file_name <opt>" << endl;
+        cout << "file_name: Text to index. For CST_CN it can also be - (stdin), a gzip or zstd file, or @list_file to index the files listed in list_file (one per line) separated by the symbol 1, which they cannot contain." << endl;
         cout << "opt: " << endl;
         cout << "-t temporal_folder:  String containing the name of the temporal folder used. Default /tmp" << endl;
         cout << "-o output_name:  String containing the name of the output file. Default file_name.cst_type" << endl;
@@ -51,6 +265,7 @@ int main(int argc, char* argv[]) {
         cout << "     1 | CST_CN with NPR-CNR" << endl;
         cout << "     2 | CST_SADA" << endl;
         cout << "     3 | CST_SCT3" << endl;
+        cout << "     4 | CST_CN with NPR-CN-DYN (block size -b, or fanout of each level -f, chosen at construction time)" << endl;
         cout << "-c suffix array: CSA used within the CST chosen. Default = 0 " << endl;
         cout << "    ---+--------------------" << endl;
         cout << "     0 | CSA_WT" << endl;
@@ -60,17 +275,35 @@ int main(int argc, char* argv[]) {
         cout << "     0 | LCP_DAC" << endl;
         cout << "     1 | LCP_SUPPORT_SADA (for CST-CN) and LCP_SUPPORT_TREE2 (for CST-SCT3 and CST_SADA)" << endl;
         cout << "-b block_size:  Block size for NPR of CN and CNR (values accepted in this test: 32, 16, 8). Default = 32 " << endl;
+        cout << "                For NPR-CN-DYN any power of two in [2,256]" << endl;
         cout << "-s small block_size:  Small Block size for NPR of CNR (values accepted in this test: 8, 4). Default = 8 " << endl;
+        cout << "-f fanouts:  Comma separated fanouts of the levels of NPR-CN-DYN, from the bottom one (powers of two in [2,256]), instead of the block size -b in all of them. The last one is used for the remaining levels. Default = none " << endl;
+        cout << "-i 1:  file_name is a CST_SADA or CST_SCT3 index created by this program (-w 2 or 3). Builds the CST_CN chosen with -w, -c, -l, -b and -s reusing its CSA and LCP. Default = 0 " << endl;
+        cout << "-a index_file:  file_name and index_file are CST_CN indexes of texts T1 and T2 created by this program with the same -w, -c, -l, -b and -s (and without the symbol 1). Builds the index of T1, the separator 1 and T2 by merging them. Default = none " << endl;
+        cout << "-x num_bytes:  Builds CST_CN with NPR-CN-DYN (-w 4) over an integer alphabet. file_name holds one symbol every num_bytes bytes (1-8), or is an sdsl int_vector if num_bytes is 0. Symbols must be greater than 0. Default = none (byte alphabet) " << endl;
+        cout << "-S 0:  Store CST_CN in the legacy format, the sdsl serialization with no header, which testOps and queryServer load only when given the right -w, -c, -l, -b and -s, without any check. Default = 1: CST_CN is stored in sections (CSA, LCP and NPR after a versioned header with the index type, the options -w, -c, -l, -b, -s and -x, and the offset and checksum of each section) that testOps loads in parallel without needing those options. The other indexes and the shards of -k are always stored with no header. " << endl;
+        cout << "-k shards:  Split file_name in this number of shards of the same size and build an index of each one, up to -p at the same time, which share the hint of -m. output_name stores the start of each shard and output_name.shard_i the index of shard i. Only for a plain file over a byte alphabet. Default = 0 (no shards) " << endl;
+        cout << "-O overlap:  Symbols of the next shard also indexed at the end of each shard with -k. testOps -K finds every occurrence of the patterns up to overlap + 1 symbols. Default = 64 " << endl;
+        cout << "-m megabytes:  Peak memory hint for building CST_CN, not a limit. Larger arrays are built semi-externally in the temporal folder. It reduces the peak memory, but the BWT, the LCP and the CSA still need about n bytes, so the text must fit in memory. Default = 0 (no hint) " << endl;
+        cout << "-j report_file:  Write the wall time, CPU time, peak RSS and bytes written of each construction phase to report_file as JSON. Not with -k. Default = none " << endl;
+        cout << "-p threads:  Number of threads used to build CST_CN. The suffix array uses one thread; without -m the BWT and the LCP are built in parallel, the LCP at the same time as the CSA. NPR levels in parallel. Default = 1 " << endl;
         return 1;
     }
 
     string file = argv[1];
-    string out_file = file;
+    string out_file = cstds::input_name(file);
     string tmp_dir = "/tmp";
-    int w = 0, c = 0, l = 0, b = 32, s = 8;
+    int w = 0, c = 0, l = 0, b = 32, s = 8, p = 1;
+    uint64_t m = 0, k = 0, O = 64;
+    bool i = false;
+    int S = -1; //-1: sections for CST_CN, the legacy format otherwise
+    string a;
+    string report_file;
+    int x = -1;
+    vector<uint64_t> f;
 
     int o;
-    while((o = getopt (argc, argv, "o:w:t:c:l:b:s:")) != -1){
+    while((o = getopt (argc, argv, "o:w:t:c:l:b:s:p:m:i:j:f:a:x:S:k:O:")) != -1){
         switch (o) {
             case 'o': out_file = optarg;  break;
             case 'w': w = atoi(optarg); break;
@@ -79,9 +312,28 @@ int main(int argc, char* argv[]) {
             case 'l': l = atoi(optarg); break;
             case 'b': b = atoi(optarg); break;
             case 's': s = atoi(optarg); break;
+            case 'p': p = atoi(optarg); break;
+            case 'm': m = atoll(optarg); break;
+            case 'i': i = atoi(optarg) != 0; break;
+            case 'j': report_file = optarg; break;
+            case 'a': a = optarg; break;
+            case 'x': x = atoi(optarg); break;
+            case 'S': S = atoi(optarg) != 0; break;
+            case 'k': k = atoll(optarg); break;
+            case 'O': O = atoll(optarg); break;
+            case 'f': {
+                f.clear();
+                stringstream ss(optarg);
+                string item;
+                while (getline(ss, item, ','))
+                    f.push_back(atoll(item.c_str()));
+                break;
+            }
             case '?':
                 if(optopt == 'o' || optopt == 'w' || optopt == 't' ||
-                         optopt == 'c' || optopt == 'l' || optopt == 'b' ||  optopt == 's')
+                         optopt == 'c' || optopt == 'l' || optopt == 'b' ||  optopt == 's' || optopt == 'p' ||
+                         optopt == 'm' || optopt == 'i' || optopt == 'j' || optopt == 'f' || optopt == 'a' ||
+                         optopt == 'x' || optopt == 'S' || optopt == 'k' || optopt == 'O')
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 else
                     fprintf(stderr,"Unknown option character `\\x%x'.\n",	optopt);
@@ -92,6 +344,38 @@ int main(int argc, char* argv[]) {
     }
 
 
+    //the report measures the whole process, so it cannot tell apart the shards built at once
+    if (!report_file.empty() and k > 0) {
+        cout << "Error: the -j option cannot be used with -k" << endl;
+        return 1;
+    }
+    if (!report_file.empty())
+        cstds::construction_report::instance().enable();
+
+    if (x != -1 and (w != 4 or x > 8)) {
+        cout << "Error: the -x option needs -w 4 and a value in [0,8]" << endl;
+        return 1;
+    }
+    //stored in the header of a sectioned index, so testOps can load it without them
+    string options = "-w " + to_string(w) + " -c " + to_string(c) + " -l " + to_string(l) + " -b " + to_string(b) +
+                     " -s " + to_string(s) + (x != -1 ? " -x 1" : "");
+
+    build_options opt;
+    opt.file = file;
+    opt.tmp_dir = tmp_dir;
+    opt.out_file = out_file;
+    opt.threads = p;
+    opt.mem_hint = m << 20;
+    opt.convert = i;
+    opt.merge_file = a;
+    opt.sectioned = S == 1 or (S == -1 and w != 2 and w != 3 and k == 0);
+    opt.options = options;
+    opt.shards = k;
+    opt.overlap = O;
+    opt.npr_bs = b;
+    opt.npr_fanout = f;
+    opt.num_bytes = x != -1 ? x : 1;
+
     switch (w) {
         case 0:  //CST-CN with NPR-CN
             switch (c) {
@@ -100,21 +384,21 @@ int main(int argc, char* argv[]) {
                         switch (b) {
                             case 8:
                                 cout << "index: cst_cn<csa_wt, lcp_dac, 8>" << std::endl;
-                                out_file += ".cst_cn_wt_dac_8";
+                                opt.out_file += ".cst_cn_wt_dac_8";
                                 create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cn, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_wt, lcp_dac, 16>" << std::endl;
-                                out_file += ".cst_cn_wt_dac_16";
+                                opt.out_file += ".cst_cn_wt_dac_16";
                                 create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cn, 16> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_wt, lcp_dac, 32>" << std::endl;
-                                out_file += ".cst_cn_wt_dac_32";
+                                opt.out_file += ".cst_cn_wt_dac_32";
                                 create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cn, 32> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -124,21 +408,21 @@ int main(int argc, char* argv[]) {
                         switch (b) {
                             case 8:
                                 cout << "index: cst_cn<csa_wt, lcp_support_sada, 8>" << std::endl;
-                                out_file += ".cst_cn_wt_sa_8";
+                                opt.out_file += ".cst_cn_wt_sa_8";
                                 create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cn, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_wt, lcp_support_sada, 16>" << std::endl;
-                                out_file += ".cst_cn_wt_sa_16";
+                                opt.out_file += ".cst_cn_wt_sa_16";
                                 create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cn, 16> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_wt, lcp_support_sada, 32>" << std::endl;
-                                out_file += ".cst_cn_wt_sa_32";
+                                opt.out_file += ".cst_cn_wt_sa_32";
                                 create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cn, 32> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -152,21 +436,21 @@ int main(int argc, char* argv[]) {
                         switch (b) { //LCP-DAC
                             case 8:
                                 cout << "index: cst_cn<csa_sada, lcp_dac, 8>" << std::endl;
-                                out_file += ".cst_cn_sa_dac_8";
+                                opt.out_file += ".cst_cn_sa_dac_8";
                                 create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cn, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_sada, lcp_dac, 16>" << std::endl;
-                                out_file += ".cst_cn_sa_dac_16";
+                                opt.out_file += ".cst_cn_sa_dac_16";
                                 create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cn, 16> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_sada, lcp_dac, 32>" << std::endl;
-                                out_file += ".cst_cn_sa_dac_32";
+                                opt.out_file += ".cst_cn_sa_dac_32";
                                 create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cn, 32> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -176,21 +460,21 @@ int main(int argc, char* argv[]) {
                         switch (b) {
                             case 8:
                                 cout << "index: cst_cn<csa_sada, lcp_support_sada, 8>" << std::endl;
-                                out_file += ".cst_cn_sa_sa_8";
+                                opt.out_file += ".cst_cn_sa_sa_8";
                                 create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cn, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_sada, lcp_support_sada, 16>" << std::endl;
-                                out_file += ".cst_cn_sa_sa_16";
+                                opt.out_file += ".cst_cn_sa_sa_16";
                                 create_index<cstds::cst_cn<csa_sada<sdsl::enc_vector<>, 32, 32>, lcp_support_sada<>,
-                                                           cstds::npr_support_cn, 16> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_sada, lcp_support_sada, 32>" << std::endl;
-                                out_file += ".cst_cn_sa_sa_32";
+                                opt.out_file += ".cst_cn_sa_sa_32";
                                 create_index<cstds::cst_cn<csa_sada<sdsl::enc_vector<>, 32, 32>, lcp_support_sada<>,
-                                                           cstds::npr_support_cn, 32> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -212,15 +496,15 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 8, 4>" << std::endl;
-                                    out_file += ".cst_cn_wt_dac_8_4";
+                                    opt.out_file += ".cst_cn_wt_dac_8_4";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 8, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 8, 8>" << std::endl;
-                                    out_file += ".cst_cn_wt_dac_8_8";
+                                    opt.out_file += ".cst_cn_wt_dac_8_8";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 8, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -228,15 +512,15 @@ int main(int argc, char* argv[]) {
                             case 16:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 16, 4>" << std::endl;
-                                    out_file += ".cst_cn_wt_dac_16_4";
+                                    opt.out_file += ".cst_cn_wt_dac_16_4";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 16, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 16, 8>" << std::endl;
-                                    out_file += ".cst_cn_wt_dac_16_8";
+                                    opt.out_file += ".cst_cn_wt_dac_16_8";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 16, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -244,15 +528,15 @@ int main(int argc, char* argv[]) {
                             case 32:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 32, 4>" << std::endl;
-                                    out_file += ".cst_cn_wt_dac_32_4";
+                                    opt.out_file += ".cst_cn_wt_dac_32_4";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 32, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 32, 8>" << std::endl;
-                                    out_file += ".cst_cn_wt_dac_32_8";
+                                    opt.out_file += ".cst_cn_wt_dac_32_8";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 32, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -266,15 +550,15 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 8, 4>" << std::endl;
-                                    out_file += ".cst_cn_wt_sa_8_4";
+                                    opt.out_file += ".cst_cn_wt_sa_8_4";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 8, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 8, 8>" << std::endl;
-                                    out_file += ".cst_cn_wt_sa_8_8";
+                                    opt.out_file += ".cst_cn_wt_sa_8_8";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 8, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -282,15 +566,15 @@ int main(int argc, char* argv[]) {
                             case 16:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 16, 4>" << std::endl;
-                                    out_file += ".cst_cn_wt_sa_16_4";
+                                    opt.out_file += ".cst_cn_wt_sa_16_4";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 16, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 16, 8>" << std::endl;
-                                    out_file += ".cst_cn_wt_sa_16_8";
+                                    opt.out_file += ".cst_cn_wt_sa_16_8";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 16, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -298,15 +582,15 @@ int main(int argc, char* argv[]) {
                             case 32:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 32, 4>" << std::endl;
-                                    out_file += ".cst_cn_wt_sa_32_4";
+                                    opt.out_file += ".cst_cn_wt_sa_32_4";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 32, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 32, 8>" << std::endl;
-                                    out_file += ".cst_cn_wt_sa_32_8";
+                                    opt.out_file += ".cst_cn_wt_sa_32_8";
                                     create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 32, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -324,15 +608,15 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 8, 4>" << std::endl;
-                                    out_file += ".cst_cn_sa_dac_8_4";
+                                    opt.out_file += ".cst_cn_sa_dac_8_4";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 8, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 8, 8>" << std::endl;
-                                    out_file += ".cst_cn_sa_dac_8_8";
+                                    opt.out_file += ".cst_cn_sa_dac_8_8";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 8, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -340,15 +624,15 @@ int main(int argc, char* argv[]) {
                             case 16:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 16, 4>" << std::endl;
-                                    out_file += ".cst_cn_sa_dac_16_4";
+                                    opt.out_file += ".cst_cn_sa_dac_16_4";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 16, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 16, 8>" << std::endl;
-                                    out_file += ".cst_cn_sa_dac_16_8";
+                                    opt.out_file += ".cst_cn_sa_dac_16_8";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 16, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -356,15 +640,15 @@ int main(int argc, char* argv[]) {
                             case 32:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 32, 4>" << std::endl;
-                                    out_file += ".cst_cn_sa_dac_32_4";
+                                    opt.out_file += ".cst_cn_sa_dac_32_4";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 32, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 32, 8>" << std::endl;
-                                    out_file += ".cst_cn_sa_dac_32_8";
+                                    opt.out_file += ".cst_cn_sa_dac_32_8";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                                           cstds::npr_support_cnr, 32, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -378,15 +662,15 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 8, 4>" << std::endl;
-                                    out_file += ".cst_cn_sa_sa_8_4";
+                                    opt.out_file += ".cst_cn_sa_sa_8_4";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 8, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 8, 8>" << std::endl;
-                                    out_file += ".cst_cn_sa_sa_8_8";
+                                    opt.out_file += ".cst_cn_sa_sa_8_8";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 8, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -394,15 +678,15 @@ int main(int argc, char* argv[]) {
                             case 16:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 16, 4>" << std::endl;
-                                    out_file += ".cst_cn_sa_sa_16_4";
+                                    opt.out_file += ".cst_cn_sa_sa_16_4";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 16, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 16, 8>" << std::endl;
-                                    out_file += ".cst_cn_sa_sa_16_8";
+                                    opt.out_file += ".cst_cn_sa_sa_16_8";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 16, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -410,15 +694,15 @@ int main(int argc, char* argv[]) {
                             case 32:
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 32, 4>" << std::endl;
-                                    out_file += ".cst_cn_sa_sa_32_4";
+                                    opt.out_file += ".cst_cn_sa_sa_32_4";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 32, 4> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 32, 8>" << std::endl;
-                                    out_file += ".cst_cn_sa_sa_32_8";
+                                    opt.out_file += ".cst_cn_sa_sa_32_8";
                                     create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                                           cstds::npr_support_cnr, 32, 8> >(file, tmp_dir, out_file);
+                                                           cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -440,13 +724,13 @@ int main(int argc, char* argv[]) {
                 case 0:
                     if (l == 0) {
                         cout << "index: cst_sada<csa_wt, lcp_dac>" << std::endl;
-                        out_file += ".cst_sada_wt_dac";
-                        create_index<sdsl::cst_sada<csa_wt<>, lcp_dac<>> >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sada_wt_dac";
+                        create_index<sdsl::cst_sada<csa_wt<>, lcp_dac<>> >(opt);
                     }
                     else if (l == 1) {
                         cout << "index: cst_sada<csa_wt, lcp_support_tree2>" << std::endl;
-                        out_file += ".cst_sada_wt_t2";
-                        create_index<sdsl::cst_sada<csa_wt<>, lcp_support_tree2<>> >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sada_wt_t2";
+                        create_index<sdsl::cst_sada<csa_wt<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                         cout << "Error: the -l option must be in [0,1]" << endl;
@@ -454,13 +738,13 @@ int main(int argc, char* argv[]) {
                 case 1:
                     if (l == 0) {
                         cout << "index: cst_sada<csa_sada, lcp_dac>" << std::endl;
-                        out_file += ".cst_sada_sa_dac";
-                        create_index<sdsl::cst_sada<csa_sada<>, lcp_dac<> > >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sada_sa_dac";
+                        create_index<sdsl::cst_sada<csa_sada<>, lcp_dac<> > >(opt);
                     }
                     else if (l == 1) {
                         cout << "index: cst_sada<csa_sada, lcp_support_tree2>" << std::endl;
-                        out_file += ".cst_sada_sa_t2";
-                        create_index<sdsl::cst_sada<csa_sada<>, lcp_support_tree2<>> >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sada_sa_t2";
+                        create_index<sdsl::cst_sada<csa_sada<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                        cout << "Error: the -l option must be in [0,1]" << endl;
@@ -474,12 +758,12 @@ int main(int argc, char* argv[]) {
                 case 0:
                     if (l == 0) {
                         cout << "index: cst_sct3<csa_wt, lcp_dac>" << std::endl;
-                        out_file += ".cst_sct3_wt_dac";
-                        create_index<sdsl::cst_sct3<csa_wt<>, lcp_dac<>> >(file, tmp_dir, out_file); }
+                        opt.out_file += ".cst_sct3_wt_dac";
+                        create_index<sdsl::cst_sct3<csa_wt<>, lcp_dac<>> >(opt); }
                     else if (l == 1) {
                         cout << "index: cst_sct3<csa_wt, lcp_support_tree2>" << std::endl;
-                        out_file += ".cst_sct3_wt_t2";
-                        create_index<sdsl::cst_sct3<csa_wt<>, lcp_support_tree2<>> >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sct3_wt_t2";
+                        create_index<sdsl::cst_sct3<csa_wt<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                         cout << "Error: the -l option must be in [0,1]" << endl;
@@ -487,13 +771,13 @@ int main(int argc, char* argv[]) {
                 case 1:
                     if (l == 0) {
                         cout << "index: cst_sct3<csa_sada, lcp_dac>" << std::endl;
-                        out_file += ".cst_sct3_sa_dac";
-                        create_index<sdsl::cst_sct3<csa_sada<>, lcp_dac<> > >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sct3_sa_dac";
+                        create_index<sdsl::cst_sct3<csa_sada<>, lcp_dac<> > >(opt);
                     }
                     else if (l == 1){
                         cout << "index: cst_sct3<csa_sada, lcp_support_tree2>" << std::endl;
-                        out_file += ".cst_sct3_sa_t2";
-                        create_index<sdsl::cst_sct3<csa_sada<>, lcp_support_tree2<>> >(file, tmp_dir, out_file);
+                        opt.out_file += ".cst_sct3_sa_t2";
+                        create_index<sdsl::cst_sct3<csa_sada<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                         cout << "Error: the -l option must be in [0,1]" << endl;
@@ -502,8 +786,76 @@ int main(int argc, char* argv[]) {
                     cout << "Error: the -c option must be in [0,1]" << endl;
             }
             break;
+        case 4:  //CST-CN with NPR-CN-DYN
+        {
+            string npr = to_string(b); //block size, or fanouts with -f
+            if (!f.empty()) {
+                npr.clear();
+                for (uint64_t x : f) {
+                    if (!cstds::_npr_support_cn_dyn<>::valid_block_size(x)) {
+                        npr.clear();
+                        break;
+                    }
+                    npr += (npr.empty() ? "" : "-") + to_string(x);
+                }
+                if (npr.empty()) {
+                    cout << "Error: for NPR-CN-DYN the -f option must be a list of powers of two in [2,256]" << endl;
+                    break;
+                }
+            } else if (!cstds::_npr_support_cn_dyn<>::valid_block_size(b)) {
+                cout << "Error: for NPR-CN-DYN the -b option must be a power of two in [2,256]" << endl;
+                break;
+            }
+            if (x != -1) { //integer alphabet
+                if (c == 0 and l == 0) {
+                    cout << "index: cst_cn<csa_wt<wt_int>, lcp_dac, npr_cn_dyn> int alphabet block size " << npr << std::endl;
+                    opt.out_file += ".cst_cn_dyn_int_wt_dac_" + npr;
+                    create_index<cstds::cst_cn<csa_wt_int, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+                } else if (c == 0 and l == 1) {
+                    cout << "index: cst_cn<csa_wt<wt_int>, lcp_support_sada, npr_cn_dyn> int alphabet block size " << npr
+                         << std::endl;
+                    opt.out_file += ".cst_cn_dyn_int_wt_sa_" + npr;
+                    create_index<cstds::cst_cn<csa_wt_int, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+                } else if (c == 1 and l == 0) {
+                    cout << "index: cst_cn<csa_sada, lcp_dac, npr_cn_dyn> int alphabet block size " << npr << std::endl;
+                    opt.out_file += ".cst_cn_dyn_int_sa_dac_" + npr;
+                    create_index<cstds::cst_cn<csa_sada_int, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+                } else if (c == 1 and l == 1) {
+                    cout << "index: cst_cn<csa_sada, lcp_support_sada, npr_cn_dyn> int alphabet block size " << npr
+                         << std::endl;
+                    opt.out_file += ".cst_cn_dyn_int_sa_sa_" + npr;
+                    create_index<cstds::cst_cn<csa_sada_int, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+                } else
+                    cout << "Error: the -c and -l options must be in [0,1]" << endl;
+            } else if (c == 0 and l == 0) {
+                cout << "index: cst_cn<csa_wt, lcp_dac, npr_cn_dyn> block size " << npr << std::endl;
+                opt.out_file += ".cst_cn_dyn_wt_dac_" + npr;
+                create_index<cstds::cst_cn<csa_wt<>, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+            } else if (c == 0 and l == 1) {
+                cout << "index: cst_cn<csa_wt, lcp_support_sada, npr_cn_dyn> block size " << npr << std::endl;
+                opt.out_file += ".cst_cn_dyn_wt_sa_" + npr;
+                create_index<cstds::cst_cn<csa_wt<>, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+            } else if (c == 1 and l == 0) {
+                cout << "index: cst_cn<csa_sada, lcp_dac, npr_cn_dyn> block size " << npr << std::endl;
+                opt.out_file += ".cst_cn_dyn_sa_dac_" + npr;
+                create_index<cstds::cst_cn<csa_sada<>, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+            } else if (c == 1 and l == 1) {
+                cout << "index: cst_cn<csa_sada, lcp_support_sada, npr_cn_dyn> block size " << npr << std::endl;
+                opt.out_file += ".cst_cn_dyn_sa_sa_" + npr;
+                create_index<cstds::cst_cn<csa_sada<>, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+            } else
+                cout << "Error: the -c and -l options must be in [0,1]" << endl;
+            break;
+        }
         default:
-            cout << "index_type must be a value in [0,3]" << endl;
+            cout << "index_type must be a value in [0,4]" << endl;
+    }
+
+    if (!report_file.empty()) {
+        ofstream report(report_file);
+        cstds::construction_report::instance().write_json(report, {{"input", file}, {"index", opt.out_file},
+                                                                   {"threads", to_string(p)},
+                                                                   {"memory_hint_mb", to_string(m)}});
     }
 
     return 0;
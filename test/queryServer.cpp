@@ -0,0 +1,230 @@
+/* cstds - compressed suffix tree data structure
+ * Copyright (C)2016-2017 Rodrigo Canovas
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/ .
+ * */
+
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <sdsl/suffix_trees.hpp>
+#include "./../include/cst_cn.h"
+#include "./../include/mapped_file.h"
+#include "./../include/query_server.h"
+
+using namespace std;
+
+volatile sig_atomic_t stop_server = 0;
+
+void
+handle_stop(int) {
+    stop_server = 1;
+}
+
+//! Options of the server.
+struct server_options {
+    string file;
+    string socket;
+    uint64_t threads;
+    uint64_t max_batch;
+    uint64_t window;
+    uint64_t report;
+    bool mapped;
+    bool sectioned;
+};
+
+//! Loads the index once and serves it until SIGINT or SIGTERM.
+template<class idx_type>
+void
+serve(const server_options& opt) {
+    using timer = std::chrono::high_resolution_clock;
+    idx_type idx;
+    auto start = timer::now();
+    if (opt.sectioned) {
+        if (!(opt.mapped ? cstds::load_sectioned_from_mapped_file(idx, opt.file) : idx.load_sectioned(opt.file))) {
+            std::cerr << "Failed to load the sections of file " << opt.file;
+            exit(1);
+        }
+    } else if (opt.mapped) {
+        if (!cstds::load_from_mapped_file(idx, opt.file)) {
+            std::cerr << "Failed to map file " << opt.file;
+            exit(1);
+        }
+    } else {
+        std::ifstream f_in(opt.file, std::ios::in | std::ios::binary);
+        if (!f_in) {
+            std::cerr << "Failed to open file " << opt.file;
+            exit(1);
+        }
+        idx.load(f_in);
+    }
+    auto stop = timer::now();
+    cout << "Load time: " << chrono::duration_cast<chrono::milliseconds>(stop - start).count() << " millisec"
+         << (opt.sectioned ? " (sections)" : "") << (opt.mapped ? " (mmap)" : "") << endl;
+    cout << "Size Text: " << idx.size() << endl;
+
+    cstds::query_server<idx_type> server(idx, opt.threads, opt.max_batch, opt.window);
+    if (!server.listen(opt.socket)) {
+        std::cerr << "Failed to listen on " << opt.socket;
+        exit(1);
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop; //no SA_RESTART, so the wait for requests is interrupted
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    cout << "Listening on " << opt.socket << " (threads " << opt.threads << ", batches of up to " << opt.max_batch
+         << " requests, window " << opt.window << " microsec)" << endl;
+    server.run(stop_server, opt.report, cout);
+}
+
+//! Serves the CST_CN with the NPR t_npr whose CSA and LCP are chosen by -c and -l. The CSA
+//  of CSA_SADA with LCP_SUPPORT_SADA and NPR-CN of blocks of 16 and 32 is the one of createCST.
+template<class t_npr, uint8_t bs = 32, uint8_t sbs = 8>
+void
+serve_cst_cn(int c, int l, const server_options& opt) {
+    typedef typename std::conditional<std::is_same<t_npr, cstds::npr_support_cn>::value and bs != 8,
+                                      csa_sada<sdsl::enc_vector<>, 32, 32>, csa_sada<> >::type csa_sada_sa;
+    if (c == 0 and l == 0)
+        serve<cstds::cst_cn<csa_wt<>, lcp_dac<>, t_npr, bs, sbs> >(opt);
+    else if (c == 0 and l == 1)
+        serve<cstds::cst_cn<csa_wt<>, lcp_support_sada<>, t_npr, bs, sbs> >(opt);
+    else if (c == 1 and l == 0)
+        serve<cstds::cst_cn<csa_sada<>, lcp_dac<>, t_npr, bs, sbs> >(opt);
+    else if (c == 1 and l == 1)
+        serve<cstds::cst_cn<csa_sada_sa, lcp_support_sada<>, t_npr, bs, sbs> >(opt);
+    else
+        cout << "Error: the -c and -l options must be in [0,1]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        cout << "Usage: " << argv[0] << " index_file <opt>" << endl;
+        cout << "index_file: CST_CN over a byte alphabet created by createCST. It is loaded once and its count, locate, child, lca and matching statistics queries are served over a Unix domain socket (see include/query_server.h for the protocol) until SIGINT or SIGTERM." << endl;
+        cout << "opt (index details needed, unless index_file was stored in sections by createCST (the default): then -w, -c, -l, -b and -s are read from its header): " << endl;
+        cout << "-w Index_type. Default = 0" << endl;
+        cout << "    ---+--------------------" << endl;
+        cout << "     0 | CST_CN with NPR-CN" << endl;
+        cout << "     1 | CST_CN with NPR-CNR" << endl;
+        cout << "     4 | CST_CN with NPR-CN-DYN (block size or fanouts read from the index)" << endl;
+        cout << "-c suffix array: CSA used within the CST. Default = 0 " << endl;
+        cout << "    ---+--------------------" << endl;
+        cout << "     0 | CSA_WT" << endl;
+        cout << "     1 | CSA_SADA" << endl;
+        cout << "-l lcp array: LCP used within the CST. Default = 0 " << endl;
+        cout << "    ---+--------------------" << endl;
+        cout << "     0 | LCP_DAC" << endl;
+        cout << "     1 | LCP_SUPPORT_SADA" << endl;
+        cout << "-b block_size: Block size for NPR of CN and CNR (8, 16 or 32). Default = 32 " << endl;
+        cout << "-s small block_size: Small Block size for NPR of CNR (4 or 8). Default = 8 " << endl;
+        cout << "-u socket: Path of the Unix domain socket. Default = index_file.sock " << endl;
+        cout << "-p threads: Threads that answer each batch of requests. Default = 1 " << endl;
+        cout << "-B max_batch: Largest number of requests answered as one batch. Default = 64 " << endl;
+        cout << "-W microsec: Time that the first request of a batch waits for other requests. Default = 200 " << endl;
+        cout << "-R seconds: Report the queries/sec and the p50 and p99 latency every this number of seconds. Default = 10 (0 only at the end) " << endl;
+        cout << "-M 1: Load the index through a memory mapping of index_file instead of a stream. Default = 0 " << endl;
+        return 1;
+    }
+
+    server_options opt;
+    opt.file = argv[1];
+    opt.socket = opt.file + ".sock";
+    opt.threads = 1;
+    opt.max_batch = 64;
+    opt.window = 200;
+    opt.report = 10;
+    opt.mapped = false;
+    opt.sectioned = false;
+    int w = 0, c = 0, l = 0, b = 32, s = 8;
+
+    int o;
+    while((o = getopt (argc, argv, "w:c:l:b:s:u:p:B:W:R:M:")) != -1){
+        switch (o) {
+            case 'w': w = atoi(optarg); break;
+            case 'c': c = atoi(optarg); break;
+            case 'l': l = atoi(optarg); break;
+            case 'b': b = atoi(optarg); break;
+            case 's': s = atoi(optarg); break;
+            case 'u': opt.socket = optarg; break;
+            case 'p': opt.threads = atoll(optarg); break;
+            case 'B': opt.max_batch = atoll(optarg); break;
+            case 'W': opt.window = atoll(optarg); break;
+            case 'R': opt.report = atoll(optarg); break;
+            case 'M': opt.mapped = atoi(optarg) != 0; break;
+            case '?':
+                if(optopt == 'w' || optopt == 'c' || optopt == 'l' || optopt == 'b' || optopt == 's' ||
+                        optopt == 'u' || optopt == 'p' || optopt == 'B' || optopt == 'W' || optopt == 'R' ||
+                        optopt == 'M')
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                else
+                    fprintf(stderr,"Unknown option character `\\x%x'.\n",	optopt);
+                return 1;
+            default:  abort ();
+        }
+
+    }
+
+    cstds::section_header header;
+    if (cstds::read_section_header(opt.file, header)) {
+        header.option('w', w);
+        header.option('c', c);
+        header.option('l', l);
+        header.option('b', b);
+        header.option('s', s);
+        opt.sectioned = true;
+    } else if (cstds::is_sectioned_file(opt.file)) {
+        cout << "Error: " << opt.file << " is a sectioned file of another version, truncated or with a damaged header" << endl;
+        return 1;
+    } else
+        cout << "Warning: " << opt.file << " has no header (legacy format, createCST -S 0), so it is loaded as the type "
+             << "given by -w, -c, -l, -b and -s without any check" << endl;
+
+    switch (w) {
+        case 0:  //CST-CN with NPR-CN
+            switch (b) {
+                case 8:  serve_cst_cn<cstds::npr_support_cn, 8>(c, l, opt); break;
+                case 16: serve_cst_cn<cstds::npr_support_cn, 16>(c, l, opt); break;
+                case 32: serve_cst_cn<cstds::npr_support_cn, 32>(c, l, opt); break;
+                default: cout << "Error: the -b option must be 8, 16, or 32" << endl;
+            }
+            break;
+        case 1:  //CST-CN with NPR-CNR
+            if (s != 4 and s != 8) {
+                cout << "Error: the -s option must be 4, 8" << endl;
+                break;
+            }
+            switch (b) {
+                case 8:
+                    s == 4 ? serve_cst_cn<cstds::npr_support_cnr, 8, 4>(c, l, opt)
+                           : serve_cst_cn<cstds::npr_support_cnr, 8, 8>(c, l, opt);
+                    break;
+                case 16:
+                    s == 4 ? serve_cst_cn<cstds::npr_support_cnr, 16, 4>(c, l, opt)
+                           : serve_cst_cn<cstds::npr_support_cnr, 16, 8>(c, l, opt);
+                    break;
+                case 32:
+                    s == 4 ? serve_cst_cn<cstds::npr_support_cnr, 32, 4>(c, l, opt)
+                           : serve_cst_cn<cstds::npr_support_cnr, 32, 8>(c, l, opt);
+                    break;
+                default: cout << "Error: the -b option must be 8, 16, or 32" << endl;
+            }
+            break;
+        case 4:  //CST-CN with NPR-CN-DYN
+            serve_cst_cn<cstds::npr_support_cn_dyn>(c, l, opt);
+            break;
+        default:
+            cout << "index_type must be 0, 1 or 4" << endl;
+    }
+
+    return 0;
+}
@@ -16,9 +16,154 @@
 #include <iostream>
 #include <sdsl/suffix_trees.hpp>
 #include "./../include/cst_cn.h"
+#include "./../include/query_engine.h"
+#include "./../include/interleaved_ops.h"
+#include "./../include/query_sample.h"
+#include "./../include/batch_lca.h"
+#include "./../include/cst_node_cache.h"
+#include "./../include/mapped_file.h"
+#include "./../include/lazy_cst_cn.h"
+#include "./../include/forked_workers.h"
+#include "./../include/huge_pages.h"
+#include "./../include/numa_replicas.h"
+#include "./../include/sharded_cst.h"
 
 using namespace std;
 
+//! CSAs over an integer alphabet (-x option)
+typedef csa_wt<wt_int<>, 32, 64, sa_order_sa_sampling<>, isa_sampling<>, int_alphabet<> > csa_wt_int;
+typedef csa_sada<enc_vector<>, 32, 64, sa_order_sa_sampling<>, isa_sampling<>, int_alphabet<> > csa_sada_int;
+
+//! Prints the time per query of an interleaved operation next to the one of the plain
+//  loop over the same queries, and how many answers differ.
+template<class t_res>
+void
+report_interleaved(const char* name, uint64_t group, uint64_t queries, double interleaved_ns, double plain_ns,
+                   const vector<t_res>& res, const vector<t_res>& expected) {
+    uint64_t wrong = 0;
+    for (uint64_t i = 0; i < res.size(); ++i)
+        wrong += res[i] != expected[i];
+    cout << name << " (interleaved " << group << "): " << interleaved_ns / queries << " nanosec, plain loop: "
+         << plain_ns / queries << " nanosec, speedup: " << plain_ns / interleaved_ns << endl;
+    if (wrong > 0)
+        cout << name << " (interleaved " << group << "): " << wrong << " answers differ from the plain loop" << endl;
+}
+
+//! Times the interleaved version of lca against the plain loop over the sample of
+//  test_with_sample_v3.
+template<class idx_type, class node_type>
+void
+test_interleaved_v3(const idx_type&, const vector<node_type>&, uint64_t) { }
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size, class node_type>
+void
+test_interleaved_v3(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>& cst, const vector<node_type>& sample,
+                    uint64_t group) {
+    if (group == 0)
+        return;
+    vector<node_type> v, w, res, expected;
+    for (uint64_t i = 0; i + 1 < sample.size(); i += 2) {
+        v.push_back(sample[i]);
+        w.push_back(sample[i + 1]);
+    }
+    expected.resize(v.size());
+    using timer = std::chrono::high_resolution_clock;
+    auto start = timer::now();
+    for (uint64_t i = 0; i < v.size(); ++i)
+        expected[i] = cst.lca(v[i], w[i]);
+    auto middle = timer::now();
+    cstds::lca_interleaved(cst, v, w, res, group);
+    auto stop = timer::now();
+    report_interleaved("LCA", group, v.size(), chrono::duration_cast<chrono::nanoseconds>(stop - middle).count() * 1.0,
+                       chrono::duration_cast<chrono::nanoseconds>(middle - start).count() * 1.0, res, expected);
+}
+
+//! Times parent, depth and node_depth over the sample of test_with_sample_v1
+//  through a cst_node_cache and reports its hit ratio.
+template<class idx_type, class node_type>
+void
+test_node_cache(const idx_type& cst, const vector<node_type>& sample) {
+    cstds::cst_node_cache<idx_type> cache(cst);
+    uint64_t pos = sample.size();
+    using timer = std::chrono::high_resolution_clock;
+
+    cout << "Parent (cached): ";
+    auto start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        auto p = cache.parent(sample[i]);
+    auto stop = timer::now();
+    cout << ((chrono::duration_cast<chrono::nanoseconds>(stop - start).count() * 1.0)) / pos << " nanosec" << endl;
+
+    cout << "Depth (cached): ";
+    start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        auto p = cache.depth(sample[i]);
+    stop = timer::now();
+    cout << ((chrono::duration_cast<chrono::nanoseconds>(stop - start).count() * 1.0)) / pos << " nanosec" << endl;
+
+    cout << "Node-Depth (cached): ";
+    start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        auto p = cache.node_depth(sample[i]);
+    stop = timer::now();
+    cout << ((chrono::duration_cast<chrono::nanoseconds>(stop - start).count() * 1.0)) / pos << " nanosec" << endl;
+
+    auto& st = cache.stats();
+    cout << "Cache parent hits: " << st.parent_hits << " misses: " << st.parent_misses << endl;
+    cout << "Cache depth hits: " << st.depth_hits << " misses: " << st.depth_misses << endl;
+}
+
+//! Times lca over the sample of test_with_sample_v3 through a cst_node_cache and reports
+//  its hit ratio.
+template<class idx_type, class node_type>
+void
+test_lca_cache(const idx_type& cst, const vector<node_type>& sample) {
+    cstds::cst_node_cache<idx_type> cache(cst);
+    uint64_t pos = sample.size() / 2;
+    using timer = std::chrono::high_resolution_clock;
+
+    cout << "LCA (cached): ";
+    auto start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        auto p = cache.lca(sample[2 * i], sample[2 * i + 1]);
+    auto stop = timer::now();
+    cout << ((chrono::duration_cast<chrono::nanoseconds>(stop - start).count() * 1.0)) / pos << " nanosec" << endl;
+
+    auto& st = cache.stats();
+    cout << "Cache lca hits: " << st.lca_hits << " misses: " << st.lca_misses << endl;
+}
+
+//! Times the offline batch lca over the sample of test_with_sample_v3. Only cst_cn supports it.
+template<class idx_type, class node_type>
+void
+test_batch_lca(const idx_type&, const vector<node_type>&, uint64_t) { }
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size, class node_type>
+void
+test_batch_lca(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>& cst, const vector<node_type>& sample,
+               uint64_t threads) {
+    vector<node_type> v, w, res;
+    for (uint64_t i = 0; i + 1 < sample.size(); i += 2) {
+        v.push_back(sample[i]);
+        w.push_back(sample[i + 1]);
+    }
+    cout << "LCA (batch, " << threads << " threads): ";
+    using timer = std::chrono::high_resolution_clock;
+    auto start = timer::now();
+    cstds::lca_batch(cst, v, w, res, threads);
+    auto stop = timer::now();
+    cout << ((chrono::duration_cast<chrono::nanoseconds>(stop - start).count() * 1.0)) / v.size() << " nanosec" << endl;
+}
+
+template<class idx_type, class node_type, class char_type>
+void
+test_interleaved_v1(const idx_type&, const vector<node_type>&, const vector<char_type>&, uint64_t);
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size, class node_type, class char_type>
+void
+test_interleaved_v1(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>& cst, const vector<node_type>& sample,
+                    const vector<char_type>& symbol, uint64_t group);
+
 //! Takes x random leaves of the CST. For each random leaf
 //	v we add all nodes of the path from v to the root to the sample
 //	Operations measured: parent(v), depth(v), first child(v),
@@ -28,35 +173,13 @@ using namespace std;
 // Based on the experiments done by Simon Gog in his PhD thesis
 template<class idx_type>
 void
-test_with_sample_v1(idx_type cst) {
+test_with_sample_v1(idx_type cst, uint64_t group, bool cache) {
     typedef typename idx_type::node_type node_type;
     typedef typename idx_type::char_type char_type;
     vector<node_type> sample;
     vector<char_type> symbol;
-
-    //std::random_device rd;
-    //std::mt19937 mt(rd());
-
-    std::default_random_engine generator;
-    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
-    std::default_random_engine generator2;
-    std::uniform_real_distribution<double> let(0.0, 1.0 * cst.csa.size() - 1);
-    uint64_t pos = 0, let_pos = 0;
-    auto root = cst.root();
-    for (uint64_t i = 0; i < 10000; ++ i) {
-        //pos = (uint64_t)dist(mt);
-        //if you want to always generate the same random numbers whenever the test is run
-        pos = (uint64_t)dist(generator);
-        auto node = cst.select_leaf(pos);
-        node = cst.parent(node);
-        while (node !=  root){
-            sample.push_back(node);
-            let_pos = (uint64_t)let(generator2);
-            symbol.push_back(sdsl::first_row_symbol(let_pos, cst.csa));
-            node = cst.parent(node);
-        }
-    }
-    pos = sample.size();
+    cstds::sample_parent_paths(cst, 10000, sample, symbol);
+    uint64_t pos = sample.size();
     cout << "Sample V1 size: " << pos << endl;
 
     cout << "Parent: ";
@@ -109,6 +232,63 @@ test_with_sample_v1(idx_type cst) {
     stop = timer::now();
     elapsed = stop - start;
     cout << ((chrono::duration_cast<chrono::nanoseconds>(elapsed).count() * 1.0)) / pos << " nanosec" << endl;
+
+    test_interleaved_v1(cst, sample, symbol, group);
+    if (cache)
+        test_node_cache(cst, sample);
+}
+
+//! Times the interleaved versions of parent, depth, sibling and child against the plain
+//  loops over the sample of test_with_sample_v1. Only cst_cn supports them.
+template<class idx_type, class node_type, class char_type>
+void
+test_interleaved_v1(const idx_type&, const vector<node_type>&, const vector<char_type>&, uint64_t) { }
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size, class node_type, class char_type>
+void
+test_interleaved_v1(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>& cst, const vector<node_type>& sample,
+                    const vector<char_type>& symbol, uint64_t group) {
+    if (group == 0)
+        return;
+    uint64_t pos = sample.size();
+    vector<node_type> res, expected(pos);
+    vector<t_size> res_depth, expected_depth(pos);
+    using timer = std::chrono::high_resolution_clock;
+    auto ns = [](timer::time_point start, timer::time_point stop) {
+        return chrono::duration_cast<chrono::nanoseconds>(stop - start).count() * 1.0;
+    };
+
+    auto start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        expected[i] = cst.parent(sample[i]);
+    auto middle = timer::now();
+    cstds::parent_interleaved(cst, sample, res, group);
+    auto stop = timer::now();
+    report_interleaved("Parent", group, pos, ns(middle, stop), ns(start, middle), res, expected);
+
+    start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        expected_depth[i] = cst.depth(sample[i]);
+    middle = timer::now();
+    cstds::depth_interleaved(cst, sample, res_depth, group);
+    stop = timer::now();
+    report_interleaved("Depth", group, pos, ns(middle, stop), ns(start, middle), res_depth, expected_depth);
+
+    start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        expected[i] = cst.sibling(sample[i]);
+    middle = timer::now();
+    cstds::sibling_interleaved(cst, sample, res, group);
+    stop = timer::now();
+    report_interleaved("Sibling", group, pos, ns(middle, stop), ns(start, middle), res, expected);
+
+    start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        expected[i] = cst.child(sample[i], symbol[i]);
+    middle = timer::now();
+    cstds::child_interleaved(cst, sample, symbol, res, group);
+    stop = timer::now();
+    report_interleaved("Child", group, pos, ns(middle, stop), ns(start, middle), res, expected);
 }
 
 
@@ -121,25 +301,8 @@ void
 test_with_get_sample_v2(idx_type cst) {
     typedef typename idx_type::node_type node_type;
     vector<node_type> sample;
-    //std::random_device rd;
-    //std::mt19937 mt(rd());
-    std::default_random_engine generator;
-    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
-    uint64_t pos = 0;
-    auto root = cst.root();
-    for (uint64_t i = 0; i < 1000; ++ i) {
-        //pos = (uint64_t)dist(mt);
-        //if you want to always generate the same random numbers whenever the test is run
-        pos = (uint64_t)dist(generator);
-        auto node = cst.select_leaf(pos);
-        node = cst.parent(node);
-        while (node !=  root){
-            sample.push_back(node);
-            node = cst.sl(node);
-        }
-    }
-
-    pos = sample.size();
+    cstds::sample_sl_paths(cst, 1000, sample);
+    uint64_t pos = sample.size();
     std::cout << "Sample V2 size: " << pos << std::endl;
 
     std::cout << "Slink: ";
@@ -157,33 +320,10 @@ test_with_get_sample_v2(idx_type cst) {
 //! Operation measured: lca(v, w).
 template<class idx_type>
 void
-test_with_sample_v3(idx_type cst) {
+test_with_sample_v3(idx_type cst, uint64_t group, uint64_t threads, bool cache) {
     typedef typename idx_type::node_type node_type;
     vector<node_type> sample;
-    //std::random_device rd;
-    //std::mt19937 mt(rd());
-    std::default_random_engine generator;
-    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
-    uint64_t pos1 = 0, pos2 = 0;
-    node_type node1, node2;
-    auto root = cst.root();
-    for (uint64_t i = 0; i < 100000; ++ i) {
-        //pos1 = (uint64_t)dist(mt);
-        //pos2 = (uint64_t)dist(mt);
-        //if you want to always generate the same random numbers whenever the test is run
-        pos1 = (uint64_t)dist(generator);
-        pos2 = (uint64_t)dist(generator);
-        if (pos1 < pos2) {
-            node1 = cst.select_leaf(pos1);
-            node2 = cst.select_leaf(pos2);
-        }
-        else {
-            node1 = cst.select_leaf(pos2);
-            node2 = cst.select_leaf(pos1);
-        }
-        sample.push_back(node1);
-        sample.push_back(node2);
-    }
+    cstds::sample_leaf_pairs(cst, 100000, sample);
 
     std::cout << "Sample V3 size: " << sample.size() << std::endl;
 
@@ -195,27 +335,450 @@ test_with_sample_v3(idx_type cst) {
     auto stop = timer::now();
     auto elapsed = stop - start;
     cout << ((chrono::duration_cast<chrono::nanoseconds>(elapsed).count() * 1.0)) / 100000.0 << " nanosec" << endl;
+
+    test_interleaved_v3(cst, sample, group);
+    test_batch_lca(cst, sample, threads);
+    if (cache)
+        test_lca_cache(cst, sample);
 }
 
 
+//! Takes x random leaves of the CST and builds a mixed workload with the nodes
+//  of their paths to the root: parent(v), depth(v), child(v, c), sl(v),
+//  lca(v, w) and count(P) with |P| = 8 taken from random positions of T.
+//  The workload is executed with 1 and with `threads` threads.
 template<class idx_type>
 void
-test_cst(string file) {
-    idx_type idx;
-    std::ifstream f_in(file, std::ios::in | std::ios::binary);
-    if(!f_in) {
+test_query_engine(const idx_type& cst, uint64_t threads) {
+    typedef typename cstds::query_engine<idx_type> engine_type;
+    typedef typename engine_type::query_type query_type;
+    vector<query_type> queries;
+    vector<typename engine_type::result_type> results;
+    vector<vector<typename idx_type::char_type> > patterns;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.csa.size());
+    uint64_t pos = 0;
+    auto root = cst.root();
+    for (uint64_t i = 0; i < 10000; ++ i) {
+        pos = (uint64_t)dist(generator);
+        if (pos + 8 < cst.csa.size()) {
+            auto pattern = sdsl::extract(cst.csa, pos, pos + 7);
+            patterns.emplace_back(pattern.begin(), pattern.end());
+        }
+    }
+    for (uint64_t i = 0; i < 10000; ++ i) {
+        pos = (uint64_t)dist(generator);
+        auto leaf = cst.select_leaf(pos);
+        auto node = cst.parent(leaf);
+        while (node != root) {
+            query_type q;
+            q.v = node;
+            q.w = leaf;
+            q.c = sdsl::first_row_symbol((uint64_t)dist(generator) - 1, cst.csa);
+            q.op = (cstds::query_op)(queries.size() % 5);
+            if (q.op == cstds::q_lca)
+                q.w = cst.select_leaf((uint64_t)dist(generator));
+            queries.push_back(q);
+            node = cst.parent(node);
+        }
+    }
+    for (uint64_t i = 0; i < patterns.size(); ++ i) {
+        query_type q;
+        q.op = cstds::q_count;
+        q.pattern = patterns[i].data();
+        q.m = patterns[i].size();
+        queries.push_back(q);
+    }
+    std::shuffle(queries.begin(), queries.end(), generator);
+    cout << "Mixed workload size: " << queries.size() << endl;
+
+    using timer = std::chrono::high_resolution_clock;
+    double base = 0;
+    for (uint64_t t : {(uint64_t)1, threads}) {
+        engine_type engine(cst, t);
+        auto start = timer::now();
+        engine.run(queries, results);
+        auto stop = timer::now();
+        double secs = chrono::duration_cast<chrono::nanoseconds>(stop - start).count() / 1e9;
+        if (t == 1)
+            base = secs;
+        cout << "Threads " << t << ": " << (queries.size() / secs) << " queries/sec (speedup "
+             << (base / secs) << ")" << endl;
+    }
+}
+
+//! Only cst_cn supports the top tree.
+template<class idx_type>
+void
+build_top_tree(idx_type&, uint64_t) { }
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size>
+void
+build_top_tree(cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>& cst, uint64_t threshold) {
+    if (threshold == 0)
+        return;
+    cst.build_top_tree(threshold);
+    std::cout << "Top tree nodes: " << cst.top.size() << std::endl;
+    std::cout << "Top tree uses: " << (cst.top.size_in_bytes() * 8.0 / cst.size()) << "n bits" << std::endl;
+}
+
+//! Only cst_cn is stored in sections.
+template<class idx_type>
+bool
+load_sectioned(idx_type&, string, uint64_t, bool) {
+    return false;
+}
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size>
+bool
+load_sectioned(cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>& cst, string file, uint64_t threads, bool mapped) {
+    return mapped ? cstds::load_sectioned_from_mapped_file(cst, file, threads) : cst.load_sectioned(file, threads);
+}
+
+//! Opens a sectioned index lazily and reports what each kind of query loads: lca over
+//  internal nodes (LCP and NPR) and then count (CSA). Only cst_cn is stored in sections.
+template<class idx_type>
+void
+test_lazy(const idx_type&, string) {
+    cout << "Error: only CST_CN can be opened lazily" << endl;
+}
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size>
+void
+test_lazy(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>&, string file) {
+    typedef cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size> idx_type;
+    using timer = std::chrono::high_resolution_clock;
+    cstds::lazy_cst_cn<idx_type> lazy;
+    auto start = timer::now();
+    if (!lazy.open(file)) {
+        std::cerr << "Failed to open the sections of file " << file;
+        exit(1);
+    }
+    auto stop = timer::now();
+    cout << "Open time: " << chrono::duration_cast<chrono::microseconds>(stop - start).count() << " microsec, "
+         << lazy.loaded_bytes() << " bytes loaded" << endl;
+
+    std::default_random_engine generator;
+    uint64_t check = 0;
+    start = timer::now();
+    const idx_type& cst = lazy.ranges();
+    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.size());
+    for (uint64_t i = 0; i < 10000; ++ i) {
+        auto v = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+        auto w = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+        check += cst.lca(v, w).first;
+    }
+    stop = timer::now();
+    cout << "LCA of internal nodes: " << chrono::duration_cast<chrono::milliseconds>(stop - start).count()
+         << " millisec including the load, " << lazy.loaded_bytes() << " bytes loaded" << endl;
+
+    start = timer::now();
+    const t_csa& csa = lazy.csa();
+    for (uint64_t i = 0; i < 1000; ++ i) {
+        uint64_t pos = (uint64_t)dist(generator);
+        if (pos + 8 < csa.size()) {
+            auto pattern = sdsl::extract(csa, pos, pos + 7);
+            check += sdsl::count(csa, pattern.begin(), pattern.end());
+        }
+    }
+    stop = timer::now();
+    cout << "Count: " << chrono::duration_cast<chrono::milliseconds>(stop - start).count()
+         << " millisec including the load, " << lazy.loaded_bytes() << " bytes loaded" << endl;
+    volatile uint64_t sink = check;
+    (void) sink;
+}
+
+//! Serves a workload of lca and depth queries from `workers` processes forked after the
+//  index was loaded, so all of them share its pages instead of loading their own copy.
+//  Each worker reports its throughput and the memory it did not share with the loader.
+template<class idx_type>
+void
+test_forked_workers(const idx_type& cst, uint64_t workers) {
+    typedef typename idx_type::node_type node_type;
+    vector<pair<node_type, node_type> > sample;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.size());
+    for (uint64_t i = 0; i < 100000; ++ i) {
+        auto v = cst.select_leaf((uint64_t)dist(generator));
+        auto w = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+        sample.emplace_back(v, w);
+    }
+    cout << "Workers sharing the index (" << sdsl::size_in_bytes(cst) << " bytes): " << workers << endl;
+    bool ok = cstds::run_forked_workers(workers, [&](uint64_t worker) {
+        using timer = std::chrono::high_resolution_clock;
+        uint64_t check = 0;
+        auto start = timer::now();
+        for (uint64_t i = 0; i < sample.size(); ++ i)
+            check += cst.depth(cst.lca(sample[i].first, sample[i].second));
+        auto stop = timer::now();
+        double secs = chrono::duration_cast<chrono::nanoseconds>(stop - start).count() / 1e9;
+        cout << "Worker " << worker << ": " << (sample.size() / secs) << " queries/sec, "
+             << cstds::private_dirty_bytes() << " bytes not shared (check " << check << ")" << endl;
+        return 0;
+    });
+    if (!ok)
+        cout << "Error: a worker failed" << endl;
+}
+
+//! Counts the dTLB load misses of parent and lca over random internal nodes, to compare
+//  the placements of the index selected by -H.
+template<class idx_type>
+void
+test_tlb_misses(const idx_type& cst) {
+    typedef typename idx_type::node_type node_type;
+    vector<node_type> sample;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.size());
+    for (uint64_t i = 0; i < 100000; ++ i)
+        sample.push_back(cst.parent(cst.select_leaf((uint64_t)dist(generator))));
+    cstds::tlb_miss_counter counter;
+    if (!counter.good()) {
+        cout << "dTLB misses: counter not available" << endl;
+        return;
+    }
+    uint64_t check = 0;
+    counter.start();
+    for (uint64_t i = 0; i < sample.size(); ++ i)
+        check += cst.parent(sample[i]).first;
+    uint64_t misses = counter.stop();
+    cout << "dTLB misses per parent: " << (misses * 1.0 / sample.size()) << endl;
+    counter.start();
+    for (uint64_t i = 0; i + 1 < sample.size(); ++ i)
+        check += cst.lca(sample[i], sample[i + 1]).first;
+    misses = counter.stop();
+    cout << "dTLB misses per lca: " << (misses * 1.0 / (sample.size() - 1)) << endl;
+    volatile uint64_t sink = check;
+    (void) sink;
+}
+
+//! Loads the index placed on the NUMA nodes as mode says and answers lca and depth queries
+//  with `threads` threads, each one bound to a node and querying the replica of its node.
+template<class idx_type>
+void
+test_numa(string file, cstds::numa_mode mode, uint64_t threads, uint64_t load_threads) {
+    typedef typename idx_type::node_type node_type;
+    using timer = std::chrono::high_resolution_clock;
+    cstds::numa_replicas<idx_type> replicas;
+    auto start = timer::now();
+    bool ok = replicas.load(mode, [&](idx_type& idx) {
+        if (load_threads > 0)
+            return load_sectioned(idx, file, load_threads, false);
+        std::ifstream f_in(file, std::ios::in | std::ios::binary);
+        if (!f_in)
+            return false;
+        idx.load(f_in);
+        return !f_in.fail();
+    });
+    auto stop = timer::now();
+    if (!ok) {
         std::cerr << "Failed to open file " << file;
         exit(1);
     }
-    idx.load(f_in);
+    cout << "NUMA nodes: " << replicas.nodes() << ", replicas: " << replicas.replicas() << ", load time: "
+         << chrono::duration_cast<chrono::milliseconds>(stop - start).count() << " millisec" << endl;
+
+    const idx_type& cst = replicas.bind_thread(0);
+    vector<pair<node_type, node_type> > sample;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> dist(1.0, 1.0 * cst.size());
+    for (uint64_t i = 0; i < 100000; ++ i) {
+        auto v = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+        auto w = cst.parent(cst.select_leaf((uint64_t)dist(generator)));
+        sample.emplace_back(v, w);
+    }
+    vector<uint64_t> check(threads, 0);
+    vector<thread> workers;
+    start = timer::now();
+    for (uint64_t t = 0; t < threads; ++ t) {
+        workers.emplace_back([&, t]() {
+            const idx_type& local = replicas.bind_thread(t);
+            for (uint64_t i = 0; i < sample.size(); ++ i)
+                check[t] += local.depth(local.lca(sample[i].first, sample[i].second));
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    stop = timer::now();
+    double secs = chrono::duration_cast<chrono::nanoseconds>(stop - start).count() / 1e9;
+    cout << "Threads " << threads << ": " << (threads * sample.size() / secs) << " queries/sec" << endl;
+}
+
+//! Loads the sharded index of file, built by createCST -k, with `threads` threads and times
+//  count, locate and longest_match of patterns taken from the text, answered by all the shards.
+template<class idx_type>
+void
+test_sharded(string file, uint64_t threads, std::true_type) {
+    using timer = std::chrono::high_resolution_clock;
+    cstds::sharded_cst<idx_type> idx;
+    auto start = timer::now();
+    if (!idx.load(file, threads)) {
+        std::cerr << "Failed to load the shards of file " << file;
+        exit(1);
+    }
+    auto stop = timer::now();
+    uint64_t size_idx = 0;
+    for (uint64_t i = 0; i < idx.shards(); ++i)
+        size_idx += sdsl::size_in_bytes(idx.shard(i));
+    cout << "Shards: " << idx.shards() << ", load time: "
+         << chrono::duration_cast<chrono::milliseconds>(stop - start).count() << " millisec" << endl;
+    cout << "Size Text: " << idx.size() << endl;
+    cout << "Size in bytes: " << size_idx << " bytes" << endl;
+    cout << "Size in bits: " << (size_idx * 8.0 / idx.size()) << "n bits" << endl;
+
+    uint64_t m = std::min<uint64_t>(8, idx.max_pattern_length());
+    vector<string> sample;
+    std::default_random_engine generator;
+    for (uint64_t i = 0; i < idx.shards(); ++i) {
+        const auto& csa = idx.shard(i).csa;
+        if (csa.size() <= m + 1)
+            continue;
+        std::uniform_int_distribution<uint64_t> dist(0, csa.size() - m - 2);
+        for (uint64_t j = 0; j < 10000 / idx.shards(); ++j) {
+            uint64_t pos = dist(generator);
+            auto text = sdsl::extract(csa, pos, pos + m - 1);
+            sample.emplace_back(text.begin(), text.end());
+        }
+    }
+    uint64_t check = 0;
+    start = timer::now();
+    for (auto& pattern : sample)
+        check += idx.count(pattern);
+    stop = timer::now();
+    cout << "Count: " << chrono::duration_cast<chrono::microseconds>(stop - start).count() * 1.0 / sample.size()
+         << " microsec per pattern of length " << m << " (" << check << " occurrences)" << endl;
+    check = 0;
+    start = timer::now();
+    for (uint64_t i = 0; i < sample.size() / 10; ++i)
+        check += idx.locate(sample[i]).size();
+    stop = timer::now();
+    cout << "Locate: " << chrono::duration_cast<chrono::microseconds>(stop - start).count() * 1.0 / (sample.size() / 10)
+         << " microsec per pattern (" << check << " occurrences)" << endl;
+    check = 0;
+    start = timer::now();
+    for (auto& pattern : sample)
+        check += idx.longest_match(pattern + pattern).first;
+    stop = timer::now();
+    cout << "Longest match: " << chrono::duration_cast<chrono::microseconds>(stop - start).count() * 1.0 / sample.size()
+         << " microsec per pattern of length " << 2 * m << " (" << check << " symbols matched)" << endl;
+}
+
+template<class idx_type>
+void
+test_sharded(string, uint64_t, std::false_type) {
+    cout << "Error: only indexes over a byte alphabet can be sharded" << endl;
+}
+
+//! Options of the command line that choose how the index is loaded and which tests run.
+struct test_options {
+    string file;
+    uint64_t top_threshold = 0; //-T
+    uint64_t threads = 1;       //-p
+    uint64_t group = 0;         //-g
+    bool cache = false;         //-C
+    bool mapped = false;        //-M
+    uint64_t load_threads = 0;  //-S
+    bool lazy = false;          //-L
+    uint64_t workers = 0;       //-F
+    int huge = -1;              //-H
+    int numa = -1;              //-N
+    bool sharded = false;       //-K
+    bool pos32 = false;         //-P
+};
+
+template<class idx_type>
+void
+test_cst(const test_options& opt);
+
+//! Only cst_cn has 32-bit positions.
+template<class idx_type>
+void
+test_cst_32(const idx_type&, const test_options&) {
+    cout << "Error: only CST_CN has 32-bit positions" << endl;
+}
+
+template<class t_csa, class t_lcp, class t_npr, uint8_t bs, uint8_t sbs, class t_size>
+void
+test_cst_32(const cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size>&, const test_options& opt) {
+    typedef cstds::cst_cn<t_csa, t_lcp, t_npr, bs, sbs, t_size> idx_type;
+    test_options opt32 = opt;
+    opt32.pos32 = false;
+    test_cst<typename cstds::cst_cn_with_size<idx_type, uint32_t>::type>(opt32);
+}
+
+template<class idx_type>
+void
+test_cst(const test_options& opt) {
+    using timer = std::chrono::high_resolution_clock;
+    const string& file = opt.file;
+    idx_type idx;
+    if (opt.pos32) {
+        test_cst_32(idx, opt);
+        return;
+    }
+    if (opt.sharded) {
+        test_sharded<idx_type>(file, opt.threads,
+                               std::integral_constant<bool, idx_type::csa_type::alphabet_category::WIDTH == 8>());
+        return;
+    }
+    if (opt.lazy) {
+        test_lazy(idx, file);
+        return;
+    }
+    if (opt.numa >= 0) {
+        test_numa<idx_type>(file, (cstds::numa_mode) opt.numa, opt.threads, opt.load_threads);
+        return;
+    }
+    if (opt.huge > 0 and !cstds::use_huge_pages((cstds::huge_page_mode) opt.huge)) {
+        std::cerr << "No free huge pages in the pool (see /proc/sys/vm/nr_hugepages)";
+        exit(1);
+    }
+    auto start = timer::now();
+    if (opt.load_threads > 0) {
+        if (!load_sectioned(idx, file, opt.load_threads, opt.mapped)) {
+            std::cerr << "Failed to load the sections of file " << file << " (is it an index of this type?)";
+            exit(1);
+        }
+    } else if (opt.mapped) {
+        if (!cstds::load_from_mapped_file(idx, file)) {
+            std::cerr << "Failed to map file " << file;
+            exit(1);
+        }
+    } else {
+        std::ifstream f_in(file, std::ios::in | std::ios::binary);
+        if(!f_in) {
+            std::cerr << "Failed to open file " << file;
+            exit(1);
+        }
+        idx.load(f_in);
+    }
+    auto stop = timer::now();
+    if (idx.csa.size() > idx_type::max_size()) {
+        std::cerr << "The text of " << file << " is too long for the positions of the index";
+        exit(1);
+    }
+    std::cout << "Load time: " << chrono::duration_cast<chrono::milliseconds>(stop - start).count() << " millisec"
+              << (opt.load_threads > 0 ? " (sections)" : "") << (opt.mapped ? " (mmap)" : "") << std::endl;
+    if (opt.huge > 0)
+        std::cout << (opt.huge == cstds::hp_transparent ? "Advised for huge pages: " : "Moved to huge pages: ")
+                  << cstds::place_in_huge_pages(idx, (cstds::huge_page_mode) opt.huge) << " bytes" << std::endl;
     uint64_t size_idx = sdsl::size_in_bytes(idx);
     std::cout << "Size Text: " << idx.size() << std::endl;
     std::cout << "Size in bytes: " << size_idx << " bytes" << std::endl;
     std::cout << "Size in bits: " << (size_idx * 8.0 / idx.size()) << "n bits" << std::endl;
+    std::cout << "Node size: " << sizeof(typename idx_type::node_type) << " bytes" << std::endl;
+    build_top_tree(idx, opt.top_threshold);
+    if (opt.huge >= 0)
+        test_tlb_misses(idx);
+    if (opt.workers > 0) {
+        test_forked_workers(idx, opt.workers);
+        return;
+    }
 
-    test_with_sample_v1<idx_type>(idx);
+    test_with_sample_v1<idx_type>(idx, opt.group, opt.cache);
     test_with_get_sample_v2<idx_type>(idx);
-    test_with_sample_v3<idx_type>(idx);
+    test_with_sample_v3<idx_type>(idx, opt.group, opt.threads, opt.cache);
+    if (opt.threads > 1)
+        test_query_engine<idx_type>(idx, opt.threads);
 
 }
 
@@ -223,13 +786,14 @@ int main(int argc, char* argv[]) {
 
     if(argc < 2) {
         cout << "Usage: " << argv[0] << " index_file <opt>" << endl;
-        cout << "opt (index details needed): " << endl;
+        cout << "opt (index details needed, unless index_file was stored in sections by createCST (the default): then -w, -c, -l, -b, -s and -x are read from its header): " << endl;
         cout << "-w Index_type. Default = 0" << endl;
         cout << "    ---+--------------------" << endl;
         cout << "     0 | CST_CN with NPR-CN" << endl;
         cout << "     1 | CST_CN with NPR-CNR" << endl;
         cout << "     2 | CST_SADA" << endl;
         cout << "     3 | CST_SCT3" << endl;
+        cout << "     4 | CST_CN with NPR-CN-DYN (block size or fanouts read from the index)" << endl;
         cout << "-c suffix array: CSA used within the CST used. Default = 0 " << endl;
         cout << "    ---+--------------------" << endl;
         cout << "     0 | CSA_WT" << endl;
@@ -240,23 +804,64 @@ int main(int argc, char* argv[]) {
         cout << "     1 | LCP_SUPPORT_SADA (for CST-CN) and LCP_SUPPORT_TREE2 (for CST-SCT3 and CST_SADA)" << endl;
         cout << "-b block_size: Block size for NPR of CN and CNR (values accepted in this test: 32, 16, 8). Default = 32 " << endl;
         cout << "-s small block_size: Small Block size for NPR of CNR (values accepted in this test: 8, 4). Default = 8 " << endl;
+        cout << "-x 1: The index was created by createCST -w 4 -x (integer alphabet). Default = 0 " << endl;
+        cout << "-T threshold: Materialize the nodes with at least threshold leaves (only CST_CN). Default = 0 (disabled) " << endl;
+        cout << "-p threads: Also run a mixed workload with the multi-threaded query engine. Default = 1 (disabled) " << endl;
+        cout << "-g group: Also time the experimental interleaved operations keeping group queries in flight against the plain loops (only CST_CN). Default = 0 (disabled) " << endl;
+        cout << "-M 1: Load the index through a memory mapping of index_file instead of a stream. Default = 0 " << endl;
+        cout << "-S threads: index_file was stored in sections by createCST (the default). Its CSA, LCP and NPR are loaded by up to threads (1-3) threads at the same time. Default = 3 if index_file is stored in sections, else 0 " << endl;
+        cout << "-V 1: index_file was stored in sections by createCST (the default). Check the checksum of each section before loading it. Default = 0 " << endl;
+        cout << "-L 1: index_file was stored in sections by createCST (the default). Open it lazily and report the bytes loaded by lca and by count queries. Default = 0 " << endl;
+        cout << "-F workers: Load the index once and fork workers processes that share it to answer lca and depth queries, instead of the other tests. Each one reports its throughput and the memory it does not share. Default = 0 (disabled) " << endl;
+        cout << "-H mode: Pages of the arrays of the index, chosen at load time, and report the dTLB misses of parent and lca. Default = not reported " << endl;
+        cout << "    ---+--------------------" << endl;
+        cout << "     0 | Base pages" << endl;
+        cout << "     1 | Transparent huge pages (madvise after the load)" << endl;
+        cout << "     2 | Huge pages of the hugetlb pool (moved after the load)" << endl;
+        cout << "-N mode: Place the index on the NUMA nodes and answer lca and depth queries with the threads of -p, each one bound to a node, instead of the other tests. Default = disabled " << endl;
+        cout << "    ---+--------------------" << endl;
+        cout << "     0 | One copy, threads not bound" << endl;
+        cout << "     1 | One replica per node, each thread queries the one of its node" << endl;
+        cout << "     2 | One copy interleaved over the nodes" << endl;
+        cout << "-K 1: index_file was built in shards by createCST -k. Load the shards with the threads of -p and time count, locate and longest_match over all of them, instead of the other tests. Default = 0 " << endl;
+        cout << "-P 1: Load the index with 32-bit positions (only CST_CN, texts of less than 2^32-1 symbols). Default = 0 (64-bit) " << endl;
+        cout << "-C 1: Also time parent, depth and node_depth, and lca, through a node cache of 4096 entries. Default = 0 (disabled) " << endl;
         return 1;
     }
 
     string file = argv[1];
-    int w = 0, c = 0, l = 0, b = 32, s = 8;
+    int w = 0, c = 0, l = 0, b = 32, s = 8, H = -1, N = -1;
+    uint64_t t = 0, p = 1, g = 0, S = 0, F = 0;
+    bool h = false, x = false, M = false, L = false, P = false, K = false, V = false;
 
     int o;
-    while((o = getopt (argc, argv, "w:c:l:b:s:")) != -1){
+    while((o = getopt (argc, argv, "w:c:l:b:s:T:p:g:C:x:M:S:L:F:H:N:P:K:V:")) != -1){
         switch (o) {
             case 'w': w = atoi(optarg); break;
             case 'c': c = atoi(optarg); break;
             case 'l': l = atoi(optarg); break;
             case 'b': b = atoi(optarg); break;
             case 's': s = atoi(optarg); break;
+            case 'T': t = atoll(optarg); break;
+            case 'p': p = atoll(optarg); break;
+            case 'g': g = atoll(optarg); break;
+            case 'C': h = atoi(optarg) != 0; break;
+            case 'x': x = atoi(optarg) != 0; break;
+            case 'M': M = atoi(optarg) != 0; break;
+            case 'S': S = atoll(optarg); break;
+            case 'L': L = atoi(optarg) != 0; break;
+            case 'F': F = atoll(optarg); break;
+            case 'H': H = atoi(optarg); break;
+            case 'N': N = atoi(optarg); break;
+            case 'P': P = atoi(optarg) != 0; break;
+            case 'K': K = atoi(optarg) != 0; break;
+            case 'V': V = atoi(optarg) != 0; break;
             case '?':
                 if(optopt == 'w' || optopt == 'c' || optopt == 'l' ||
-                        optopt == 'b' ||  optopt == 's')
+                        optopt == 'b' ||  optopt == 's' || optopt == 'T' || optopt == 'p' ||
+                        optopt == 'g' || optopt == 'C' || optopt == 'x' ||
+                        optopt == 'M' || optopt == 'S' || optopt == 'L' || optopt == 'F' || optopt == 'H' || optopt == 'N' || optopt == 'P' ||
+                        optopt == 'K' || optopt == 'V')
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 else
                     fprintf(stderr,"Unknown option character `\\x%x'.\n",	optopt);
@@ -266,6 +871,60 @@ int main(int argc, char* argv[]) {
 
     }
 
+    if (H > 2) {
+        cout << "Error: the -H option must be in [0,2]" << endl;
+        return 1;
+    }
+    if (N > 2) {
+        cout << "Error: the -N option must be in [0,2]" << endl;
+        return 1;
+    }
+
+    //a sectioned index describes itself, so its header chooses the type to load
+    cstds::section_header header;
+    if (cstds::read_section_header(file, header)) {
+        int xi = x;
+        header.option('w', w);
+        header.option('c', c);
+        header.option('l', l);
+        header.option('b', b);
+        header.option('s', s);
+        header.option('x', xi);
+        x = xi != 0;
+        if (S == 0 and !L)
+            S = 3;
+        cout << "Sectioned file: version " << header.version << ", options " << header.options << endl;
+        if (V) {
+            bool ok = cstds::verify_sections(file, header, 3);
+            cout << "Checksums of the sections: " << (ok ? "ok" : "FAILED") << endl;
+            if (!ok)
+                return 1;
+        }
+    } else if (cstds::is_sectioned_file(file)) {
+        cout << "Error: " << file << " is a sectioned file of another version, truncated or with a damaged header" << endl;
+        return 1;
+    } else if (S > 0 or L or V) {
+        cout << "Error: " << file << " was not stored in sections" << endl;
+        return 1;
+    } else if (!K)
+        cout << "Warning: " << file << " has no header (legacy format, createCST -S 0), so it is loaded as the type "
+             << "given by -w, -c, -l, -b and -s without any check" << endl;
+
+    test_options opt;
+    opt.file = file;
+    opt.top_threshold = t;
+    opt.threads = p;
+    opt.group = g;
+    opt.cache = h;
+    opt.mapped = M;
+    opt.load_threads = S;
+    opt.lazy = L;
+    opt.workers = F;
+    opt.huge = H;
+    opt.numa = N;
+    opt.sharded = K;
+    opt.pos32 = P;
+
     switch (w) {
         case 0:  //CST-CN with NPR-CN
             switch (c) {
@@ -275,17 +934,17 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 cout << "index: cst_cn<csa_wt, lcp_dac, 8>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                        cstds::npr_support_cn, 8> >(file);
+                                        cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_wt, lcp_dac, 16>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                        cstds::npr_support_cn, 16> >(file);
+                                        cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_wt, lcp_dac, 32>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                        cstds::npr_support_cn, 32> >(file);
+                                        cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -296,17 +955,17 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 cout << "index: cst_cn<csa_wt, lcp_support_sada, 8>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                        cstds::npr_support_cn, 8> >(file);
+                                        cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_wt, lcp_support_sada, 16>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                        cstds::npr_support_cn, 16> >(file);
+                                        cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_wt, lcp_support_sada, 32>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                        cstds::npr_support_cn, 32> >(file);
+                                        cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -321,17 +980,17 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 cout << "index: cst_cn<csa_sada, lcp_dac, 8>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                        cstds::npr_support_cn, 8> >(file);
+                                        cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_sada, lcp_dac, 16>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                        cstds::npr_support_cn, 16> >(file);
+                                        cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_sada, lcp_dac, 32>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                        cstds::npr_support_cn, 32> >(file);
+                                        cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -342,17 +1001,17 @@ int main(int argc, char* argv[]) {
                             case 8:
                                 cout << "index: cst_cn<csa_sada, lcp_support_sada, 8>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                        cstds::npr_support_cn, 8> >(file);
+                                        cstds::npr_support_cn, 8> >(opt);
                                 break;
                             case 16:
                                 cout << "index: cst_cn<csa_sada, lcp_support_sada, 16>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_sada<sdsl::enc_vector<>, 32, 32>, lcp_support_sada<>,
-                                        cstds::npr_support_cn, 16> >(file);
+                                        cstds::npr_support_cn, 16> >(opt);
                                 break;
                             case 32:
                                 cout << "index: cst_cn<csa_sada, lcp_support_sada, 32>" << std::endl;
                                 test_cst<cstds::cst_cn<csa_sada<sdsl::enc_vector<>, 32, 32>, lcp_support_sada<>,
-                                        cstds::npr_support_cn, 32> >(file);
+                                        cstds::npr_support_cn, 32> >(opt);
                                 break;
                             default:
                                 cout << "Error: the -b option must be 8, 16, or 32" << endl;
@@ -375,12 +1034,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 8, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 8, 4> >(file);
+                                            cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 8, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 8, 8> >(file);
+                                            cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -389,12 +1048,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 16, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 16, 4> >(file);
+                                            cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 16, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 16, 8> >(file);
+                                            cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -403,12 +1062,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 32, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 32, 4> >(file);
+                                            cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_dac, 32, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 32, 8> >(file);
+                                            cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -423,12 +1082,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 8, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 8, 4> >(file);
+                                            cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 8, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 8, 8> >(file);
+                                            cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -437,12 +1096,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 16, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 16, 4> >(file);
+                                            cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 16, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 16, 8> >(file);
+                                            cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -451,12 +1110,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 32, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 32, 4> >(file);
+                                            cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_wt, lcp_sada, 32, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 32, 8> >(file);
+                                            cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -475,12 +1134,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 8, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 8, 4> >(file);
+                                            cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 8, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 8, 8> >(file);
+                                            cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -489,12 +1148,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 16, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 16, 4> >(file);
+                                            cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 16, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 16, 8> >(file);
+                                            cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -503,12 +1162,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 32, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 32, 4> >(file);
+                                            cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_dac, 32, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>,
-                                            cstds::npr_support_cnr, 32, 8> >(file);
+                                            cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -523,12 +1182,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 8, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 8, 4> >(file);
+                                            cstds::npr_support_cnr, 8, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 8, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 8, 8> >(file);
+                                            cstds::npr_support_cnr, 8, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -537,12 +1196,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 16, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 16, 4> >(file);
+                                            cstds::npr_support_cnr, 16, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 16, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                             cstds::npr_support_cnr, 16, 8> >(file);
+                                             cstds::npr_support_cnr, 16, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -551,12 +1210,12 @@ int main(int argc, char* argv[]) {
                                 if (s == 4) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 32, 4>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 32, 4> >(file);
+                                            cstds::npr_support_cnr, 32, 4> >(opt);
                                 }
                                 else if (s == 8) {
                                     cout << "index: cst_cn<csa_sada, lcp_sada, 32, 8>" << std::endl;
                                     test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>,
-                                            cstds::npr_support_cnr, 32, 8> >(file);
+                                            cstds::npr_support_cnr, 32, 8> >(opt);
                                 }
                                 else
                                     cout << "Error: the -s option must be 4, 8" << endl;
@@ -578,11 +1237,11 @@ int main(int argc, char* argv[]) {
                 case 0:
                     if (l == 0) {
                         cout << "index: cst_sada<csa_wt, lcp_dac>" << std::endl;
-                        test_cst<sdsl::cst_sada<csa_wt<>, lcp_dac<>> >(file);
+                        test_cst<sdsl::cst_sada<csa_wt<>, lcp_dac<>> >(opt);
                     }
                     else if (l == 1) {
                         cout << "index: cst_sada<csa_wt, lcp_support_tree2>" << std::endl;
-                        test_cst<sdsl::cst_sada<csa_wt<>, lcp_support_tree2<>> >(file);
+                        test_cst<sdsl::cst_sada<csa_wt<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                         cout << "Error: the -l option must be in [0,1]" << endl;
@@ -590,11 +1249,11 @@ int main(int argc, char* argv[]) {
                 case 1:
                     if (l == 0) {
                         cout << "index: cst_sada<csa_sada, lcp_dac>" << std::endl;
-                        test_cst<sdsl::cst_sada<csa_sada<>, lcp_dac<> > >(file);
+                        test_cst<sdsl::cst_sada<csa_sada<>, lcp_dac<> > >(opt);
                     }
                     else if (l == 1) {
                         cout << "index: cst_sada<csa_sada, lcp_support_tree2>" << std::endl;
-                        test_cst<sdsl::cst_sada<csa_sada<>, lcp_support_tree2<>> >(file);
+                        test_cst<sdsl::cst_sada<csa_sada<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                        cout << "Error: the -l option must be in [0,1]" << endl;
@@ -608,10 +1267,10 @@ int main(int argc, char* argv[]) {
                 case 0:
                     if (l == 0) {
                         cout << "index: cst_sct3<csa_wt, lcp_dac>" << std::endl;
-                        test_cst<sdsl::cst_sct3<csa_wt<>, lcp_dac<>> >(file); }
+                        test_cst<sdsl::cst_sct3<csa_wt<>, lcp_dac<>> >(opt); }
                     else if (l == 1) {
                         cout << "index: cst_sct3<csa_wt, lcp_support_tree2>" << std::endl;
-                        test_cst<sdsl::cst_sct3<csa_wt<>, lcp_support_tree2<>> >(file);
+                        test_cst<sdsl::cst_sct3<csa_wt<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                         cout << "Error: the -l option must be in [0,1]" << endl;
@@ -619,11 +1278,11 @@ int main(int argc, char* argv[]) {
                 case 1:
                     if (l == 0) {
                         cout << "index: cst_sct3<csa_sada, lcp_dac>" << std::endl;
-                        test_cst<sdsl::cst_sct3<csa_sada<>, lcp_dac<> > >(file);
+                        test_cst<sdsl::cst_sct3<csa_sada<>, lcp_dac<> > >(opt);
                     }
                     else if (l == 1){
                         cout << "index: cst_sct3<csa_sada, lcp_support_tree2>" << std::endl;
-                        test_cst<sdsl::cst_sct3<csa_sada<>, lcp_support_tree2<>> >(file);
+                        test_cst<sdsl::cst_sct3<csa_sada<>, lcp_support_tree2<>> >(opt);
                     }
                     else
                         cout << "Error: the -l option must be in [0,1]" << endl;
@@ -632,8 +1291,39 @@ int main(int argc, char* argv[]) {
                     cout << "Error: the -c option must be in [0,1]" << endl;
             }
             break;
+        case 4: //CST-CN with NPR-CN-DYN, the fanouts are read from the index
+            if (x) { //integer alphabet
+                if (c == 0 and l == 0) {
+                    cout << "index: cst_cn<csa_wt<wt_int>, lcp_dac, npr_cn_dyn> int alphabet" << std::endl;
+                    test_cst<cstds::cst_cn<csa_wt_int, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+                } else if (c == 0 and l == 1) {
+                    cout << "index: cst_cn<csa_wt<wt_int>, lcp_support_sada, npr_cn_dyn> int alphabet" << std::endl;
+                    test_cst<cstds::cst_cn<csa_wt_int, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+                } else if (c == 1 and l == 0) {
+                    cout << "index: cst_cn<csa_sada, lcp_dac, npr_cn_dyn> int alphabet" << std::endl;
+                    test_cst<cstds::cst_cn<csa_sada_int, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+                } else if (c == 1 and l == 1) {
+                    cout << "index: cst_cn<csa_sada, lcp_support_sada, npr_cn_dyn> int alphabet" << std::endl;
+                    test_cst<cstds::cst_cn<csa_sada_int, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+                } else
+                    cout << "Error: the -c and -l options must be in [0,1]" << endl;
+            } else if (c == 0 and l == 0) {
+                cout << "index: cst_cn<csa_wt, lcp_dac, npr_cn_dyn>" << std::endl;
+                test_cst<cstds::cst_cn<csa_wt<>, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+            } else if (c == 0 and l == 1) {
+                cout << "index: cst_cn<csa_wt, lcp_support_sada, npr_cn_dyn>" << std::endl;
+                test_cst<cstds::cst_cn<csa_wt<>, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+            } else if (c == 1 and l == 0) {
+                cout << "index: cst_cn<csa_sada, lcp_dac, npr_cn_dyn>" << std::endl;
+                test_cst<cstds::cst_cn<csa_sada<>, lcp_dac<>, cstds::npr_support_cn_dyn> >(opt);
+            } else if (c == 1 and l == 1) {
+                cout << "index: cst_cn<csa_sada, lcp_support_sada, npr_cn_dyn>" << std::endl;
+                test_cst<cstds::cst_cn<csa_sada<>, lcp_support_sada<>, cstds::npr_support_cn_dyn> >(opt);
+            } else
+                cout << "Error: the -c and -l options must be in [0,1]" << endl;
+            break;
         default:
-            cout << "index_type must be a value in [0,3]" << endl;
+            cout << "index_type must be a value in [0,4]" << endl;
     }
 
     return 0;
@@ -0,0 +1,478 @@
+/* cstds - compressed suffix tree data structure
+ * Copyright (C)2016-2017 Rodrigo Canovas
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/ .
+ * */
+
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <sdsl/suffix_trees.hpp>
+#include "./../include/cst_cn.h"
+#include "./../include/query_sample.h"
+
+using namespace std;
+
+//! Nodes and symbols of the query mix, the samples V1, V2 and V3 of testOperations.cpp.
+template<class idx_type>
+struct query_sample {
+    typedef typename idx_type::node_type node_type;
+    typedef typename idx_type::char_type char_type;
+
+    vector<node_type> v1;     //parent, sibling and child
+    vector<char_type> symbol; //child
+    vector<node_type> v2;     //sl
+    vector<node_type> v3;     //lca (pairs)
+
+    query_sample(const idx_type& cst) {
+        cstds::sample_parent_paths(cst, 10000, v1, symbol);
+        cstds::sample_sl_paths(cst, 1000, v2);
+        cstds::sample_leaf_pairs(cst, 100000, v3);
+    }
+
+    uint64_t
+    queries() const {
+        return 3 * v1.size() + v2.size() + v3.size() / 2;
+    }
+};
+
+//! Result of running the query mix over one NPR configuration.
+struct candidate {
+    uint64_t bs = 0;          //block size of NPR-CN and NPR-CNR
+    uint64_t sbs = 0;         //small block size of NPR-CNR (0 for NPR-CN)
+    vector<uint64_t> fanout;  //fanouts of NPR-CN-DYN from the bottom level, the last one repeated above
+    uint64_t levels = 0;      //levels of NPR-CN-DYN
+    double npr_bits = 0;      //bits per symbol of the NPR
+    double total_bits = 0;    //bits per symbol of the whole index
+    double parent = 0, sibling = 0, child = 0, sl = 0, lca = 0;
+    double mix = 0;           //average time of all the queries of the mix
+
+    //! Block sizes of the NPR as in the names of createCST: "16", "16-4" (NPR-CNR) or
+    // "8-16-64" (the fanouts of NPR-CN-DYN)
+    string
+    name() const {
+        if (fanout.empty())
+            return to_string(bs) + (sbs > 0 ? "-" + to_string(sbs) : "");
+        string res;
+        for (uint64_t f : fanout)
+            res += (res.empty() ? "" : "-") + to_string(f);
+        return res;
+    }
+};
+
+//! Settings of a run of tuneNPR.
+struct tune_options {
+    string file;                  //index tuned
+    string out_file;              //-o
+    bool legacy = false;          //file has no header
+    string options;               //options of the header of file
+    vector<uint64_t> block_sizes; //-B
+    uint64_t levels = 3;          //-D
+    double max_bits = 0;          //-S
+    double max_latency = 0;       //-L
+    uint64_t threads = 1;         //-p
+};
+
+//! Returns the nanoseconds taken by op(0), ..., op(pos - 1).
+template<class t_op>
+double
+time_queries(uint64_t pos, t_op op) {
+    using timer = std::chrono::high_resolution_clock;
+    auto start = timer::now();
+    for (uint64_t i = 0; i < pos; ++ i)
+        op(i);
+    auto stop = timer::now();
+    return (double)chrono::duration_cast<chrono::nanoseconds>(stop - start).count();
+}
+
+//! Times each operation of the mix over cst.
+template<class idx_type, class t_sample>
+void
+run_mix(const idx_type& cst, const t_sample& sample, candidate& res) {
+    uint64_t check = 0;
+    double t_parent = time_queries(sample.v1.size(), [&](uint64_t i) { check += cst.parent(sample.v1[i]).first; });
+    double t_sibling = time_queries(sample.v1.size(), [&](uint64_t i) { check += cst.sibling(sample.v1[i]).first; });
+    double t_child = time_queries(sample.v1.size(), [&](uint64_t i) {
+        check += cst.child(sample.v1[i], sample.symbol[i]).first;
+    });
+    double t_sl = time_queries(sample.v2.size(), [&](uint64_t i) { check += cst.sl(sample.v2[i]).first; });
+    double t_lca = time_queries(sample.v3.size() / 2, [&](uint64_t i) {
+        check += cst.lca(sample.v3[2 * i], sample.v3[2 * i + 1]).first;
+    });
+    uint64_t pos = std::max(sample.v1.size(), (size_t)1);
+    res.parent = t_parent / pos;
+    res.sibling = t_sibling / pos;
+    res.child = t_child / pos;
+    res.sl = t_sl / std::max(sample.v2.size(), (size_t)1);
+    res.lca = t_lca / std::max(sample.v3.size() / 2, (size_t)1);
+    res.mix = (t_parent + t_sibling + t_child + t_sl + t_lca) / std::max(sample.queries(), (uint64_t)1);
+    volatile uint64_t sink = check; //keeps the queries from being optimized out
+    (void) sink;
+}
+
+//! Fills the space of res with the one of cst and times the query mix over it.
+template<class idx_type, class t_sample>
+void
+measure(const idx_type& cst, const t_sample& sample, candidate& res) {
+    uint64_t n = std::max(cst.size(), (uint64_t)1);
+    res.npr_bits = sdsl::size_in_bytes(cst.npr) * 8.0 / n;
+    res.total_bits = sdsl::size_in_bytes(cst) * 8.0 / n;
+    run_mix(cst, sample, res);
+    std::cout << "NPR " << res.name() << ": NPR " << res.npr_bits << "n bits, index " << res.total_bits
+              << "n bits, parent " << res.parent << ", sibling " << res.sibling << ", child " << res.child
+              << ", sl " << res.sl << ", lca " << res.lca << ", mix " << res.mix << " nanosec" << std::endl;
+}
+
+//! Returns if r meets the space budget and the latency SLO.
+bool
+fits(const candidate& r, const tune_options& opt) {
+    return !(opt.max_bits > 0 and r.total_bits > opt.max_bits) and !(opt.max_latency > 0 and r.mix > opt.max_latency);
+}
+
+//! Returns if a is better than b: the smallest index meeting the latency SLO if max_latency > 0,
+//  otherwise the fastest one fitting in max_bits. Among the ones that do not fit, the fastest.
+bool
+better(const candidate& a, const candidate& b, const tune_options& opt) {
+    if (fits(a, opt) != fits(b, opt))
+        return fits(a, opt);
+    if (fits(a, opt) and opt.max_latency > 0)
+        return a.total_bits < b.total_bits;
+    return a.mix < b.mix;
+}
+
+//! Returns the position of the best of results.
+uint64_t
+choose(const vector<candidate>& results, const tune_options& opt) {
+    uint64_t best = 0;
+    for (uint64_t i = 1; i < results.size(); ++i) {
+        if (better(results[i], results[best], opt))
+            best = i;
+    }
+    return best;
+}
+
+//! Loads file in cst, reporting the failure or a file with no header.
+template<class idx_type>
+void
+load_tuned_index(idx_type& cst, tune_options& opt) {
+    if (!cstds::load_index_file(cst, opt.file, opt.legacy)) {
+        std::cerr << "Failed to open file " << opt.file << " (is it an index of this type?)" << endl;
+        exit(1);
+    }
+    if (opt.legacy)
+        std::cout << "Warning: " << opt.file << " has no header (legacy format, createCST -S 0), so it is loaded as "
+                  << "the type given by -w, -c, -l, -b and -s without any check" << endl;
+    uint64_t n = cst.size();
+    std::cout << "Size Text: " << n << std::endl;
+    std::cout << "CSA+LCP uses: " << ((sdsl::size_in_bytes(cst) - sdsl::size_in_bytes(cst.npr)) * 8.0 / n)
+              << "n bits" << std::endl;
+}
+
+//! Reports the best of results, or exits if it does not meet the space budget and latency SLO.
+void
+report_best(const candidate& r, const tune_options& opt) {
+    if (!fits(r, opt)) {
+        std::cout << "Error: no NPR tried meets the space budget and latency SLO given" << std::endl;
+        exit(1);
+    }
+    std::cout << "Best NPR: " << r.name() << " (index " << r.total_bits << "n bits, mix " << r.mix << " nanosec)"
+              << std::endl;
+}
+
+//! Returns options with the values of -b and -s replaced by the block sizes of r.
+string
+with_block_sizes(const string& options, const candidate& r) {
+    istringstream in(options);
+    string name, res;
+    int v = 0;
+    while (in >> name >> v) {
+        if (name == "-b")
+            v = (int) r.bs;
+        else if (name == "-s" and r.sbs > 0)
+            v = (int) r.sbs;
+        res += (res.empty() ? "" : " ") + name + " " + to_string(v);
+    }
+    return res;
+}
+
+//! Stores cst, whose NPR is the one of r, in the format of the file tuned.
+template<class idx_type>
+void
+store_index(const idx_type& cst, const candidate& r, const tune_options& opt) {
+    string out_file = opt.out_file.empty() ? opt.file + ".tuned_" + r.name() : opt.out_file;
+    std::ofstream out(out_file, std::ios::out | std::ios::binary);
+    if (opt.legacy)
+        cst.serialize(out);
+    else
+        cst.serialize_sectioned(out, r.fanout.empty() ? with_block_sizes(opt.options, r) : opt.options);
+    out.flush();
+    if (!out) {
+        std::cerr << "Failed to write file " << out_file << endl;
+        exit(1);
+    }
+    std::cout << "Index stored in: " << out_file << std::endl;
+    if (opt.legacy and r.fanout.empty())
+        std::cout << "It has no header, so load it with -b " << r.bs << (r.sbs > 0 ? " -s " + to_string(r.sbs) : "")
+                  << std::endl;
+}
+
+//! Calls f with a null pointer to cst_cn<t_csa, t_lcp> with NPR-CN of block size bs (sbs = 0)
+//  or NPR-CNR of block sizes bs and sbs. Returns false if createCST does not build that type.
+template<class t_csa, class t_lcp, class t_func>
+bool
+with_npr_type(uint64_t bs, uint64_t sbs, t_func& f) {
+    using cstds::cst_cn;
+    using cstds::npr_support_cn;
+    using cstds::npr_support_cnr;
+    if (sbs == 0) {
+        switch (bs) {
+            case 8:  f((cst_cn<t_csa, t_lcp, npr_support_cn, 8>*) nullptr); return true;
+            case 16: f((cst_cn<t_csa, t_lcp, npr_support_cn, 16>*) nullptr); return true;
+            case 32: f((cst_cn<t_csa, t_lcp, npr_support_cn, 32>*) nullptr); return true;
+        }
+    } else if (sbs == 4) {
+        switch (bs) {
+            case 8:  f((cst_cn<t_csa, t_lcp, npr_support_cnr, 8, 4>*) nullptr); return true;
+            case 16: f((cst_cn<t_csa, t_lcp, npr_support_cnr, 16, 4>*) nullptr); return true;
+            case 32: f((cst_cn<t_csa, t_lcp, npr_support_cnr, 32, 4>*) nullptr); return true;
+        }
+    } else if (sbs == 8) {
+        switch (bs) {
+            case 8:  f((cst_cn<t_csa, t_lcp, npr_support_cnr, 8, 8>*) nullptr); return true;
+            case 16: f((cst_cn<t_csa, t_lcp, npr_support_cnr, 16, 8>*) nullptr); return true;
+            case 32: f((cst_cn<t_csa, t_lcp, npr_support_cnr, 32, 8>*) nullptr); return true;
+        }
+    }
+    return false;
+}
+
+//! Builds the index of the type given, with the CSA and the LCP of src and a new NPR, and runs
+//  the query mix over it, or stores it if store is true.
+template<class t_src>
+struct fixed_npr_builder {
+    const t_src& src;
+    const query_sample<t_src>& sample;
+    const tune_options& opt;
+    candidate& res;
+    bool store;
+
+    template<class idx_type>
+    void
+    operator()(idx_type*) {
+        sdsl::cache_config config; //not used, since the LCP is copied
+        idx_type cst(src, config, opt.threads);
+        if (store)
+            store_index(cst, res, opt);
+        else
+            measure(cst, sample, res);
+    }
+};
+
+//! Tunes the block sizes of an index with NPR-CN (sbs = {0}) or NPR-CNR. The index of each
+//  candidate is built from the CSA and LCP of the one loaded, so both are kept in memory.
+template<class t_csa, class t_lcp>
+struct fixed_npr_tuner {
+    tune_options& opt;
+    vector<uint64_t> sbs;
+
+    template<class t_src>
+    void
+    operator()(t_src*) {
+        t_src src;
+        load_tuned_index(src, opt);
+        query_sample<t_src> sample(src);
+        std::cout << "Query mix size: " << sample.queries() << std::endl;
+
+        vector<candidate> results;
+        for (uint64_t b : opt.block_sizes) {
+            for (uint64_t s : sbs) {
+                candidate res;
+                res.bs = b;
+                res.sbs = s;
+                fixed_npr_builder<t_src> build{src, sample, opt, res, false};
+                if (with_npr_type<t_csa, t_lcp>(b, s, build))
+                    results.push_back(res);
+            }
+        }
+        candidate best = results[choose(results, opt)];
+        report_best(best, opt);
+        fixed_npr_builder<t_src> build{src, sample, opt, best, true};
+        with_npr_type<t_csa, t_lcp>(best.bs, best.sbs, build);
+    }
+};
+
+//! Tunes the fanouts of NPR-CN-DYN. It tries the same fanout in all the levels for each block
+//  size and then, from the best one, each block size in each of the `levels` bottom levels,
+//  keeping the best fanout found for the previous levels (coordinate descent).
+template<class idx_type>
+void
+tune_dyn(tune_options& opt) {
+    idx_type cst;
+    load_tuned_index(cst, opt);
+    query_sample<idx_type> sample(cst);
+    std::cout << "Query mix size: " << sample.queries() << std::endl;
+
+    vector<candidate> results;
+    map<string, uint64_t> tried;
+    auto try_fanout = [&](vector<uint64_t> f) {
+        while (f.size() > 1 and f[f.size() - 1] == f[f.size() - 2])
+            f.pop_back();
+        candidate res;
+        res.fanout = f;
+        if (tried.count(res.name()))
+            return;
+        cst.build_npr(opt.threads, f);
+        res.levels = cst.npr.fanout().size();
+        measure(cst, sample, res);
+        tried[res.name()] = results.size();
+        results.push_back(res);
+    };
+    for (uint64_t b : opt.block_sizes)
+        try_fanout({b});
+    uint64_t best = choose(results, opt);
+    for (uint64_t r = 0; r < opt.levels and r + 1 < results[best].levels; ++r) {
+        for (uint64_t b : opt.block_sizes) {
+            vector<uint64_t> f = results[best].fanout;
+            uint64_t top = f.back();
+            f.resize(r + 2, top);
+            f[r] = b;
+            try_fanout(f);
+        }
+        best = choose(results, opt);
+    }
+    const candidate& r = results[best];
+    report_best(r, opt);
+    if (cst.npr.fanout() != r.fanout)
+        cst.build_npr(opt.threads, r.fanout);
+    store_index(cst, r, opt);
+}
+
+//! Tunes the NPR of an index of type w (0 = NPR-CN, 1 = NPR-CNR, 4 = NPR-CN-DYN) with block
+//  sizes b and s.
+template<class t_csa, class t_lcp>
+void
+tune_index(int w, int b, int s, tune_options& opt) {
+    if (w == 4) {
+        tune_dyn<cstds::cst_cn<t_csa, t_lcp, cstds::npr_support_cn_dyn> >(opt);
+        return;
+    }
+    fixed_npr_tuner<t_csa, t_lcp> tuner{opt, w == 0 ? vector<uint64_t>{0} : vector<uint64_t>{4, 8}};
+    if (!with_npr_type<t_csa, t_lcp>(b, w == 0 ? 0 : s, tuner))
+        cout << "Error: the -b (and -s) options of the index are not valid for -w " << w << endl;
+}
+
+int main(int argc, char* argv[]) {
+
+    if(argc < 2) {
+        cout << "Usage: " << argv[0] << " index_file <opt>" << endl;
+        cout << "index_file: CST_CN created by createCST with -w 0, 1 or 4. Its CSA and LCP are kept and its NPR rebuilt." << endl;
+        cout << "opt: " << endl;
+        cout << "-w -c -l -b -s:  Type of index_file as in createCST (-w 0 = NPR-CN, 1 = NPR-CNR, 4 = NPR-CN-DYN). Read from the header of an index stored in sections (the default of createCST). Default = -w 4 -c 0 -l 0 -b 32 -s 8 " << endl;
+        cout << "-B block_sizes:  Comma separated block sizes tried (powers of two in [2,256]). NPR-CN and NPR-CNR only try 8, 16 and 32, the ones of createCST, and NPR-CNR each one with the small block sizes 4 and 8. Default = 4,8,16,32,64,128,256 " << endl;
+        cout << "-D levels:  Bottom levels of NPR-CN-DYN whose fanout is tuned one by one after trying each block size in all the levels. Default = 3 (0 = the same fanout in all the levels) " << endl;
+        cout << "-S bits:  Space budget of the whole index, in bits per symbol. Default = 0 (no limit) " << endl;
+        cout << "-L nanosec:  Latency SLO, average time of a query of the mix. The smallest index meeting it is chosen. Default = 0 (choose the fastest) " << endl;
+        cout << "-o output_name:  File where the index with the best NPR is stored. Default = index_file.tuned_<block_sizes> " << endl;
+        cout << "-p threads:  Number of threads used to build each NPR. Default = 1 " << endl;
+        return 1;
+    }
+
+    tune_options opt;
+    opt.file = argv[1];
+    int w = 4, c = 0, l = 0, b = 32, s = 8;
+    opt.block_sizes = {4, 8, 16, 32, 64, 128, 256};
+
+    int o;
+    while((o = getopt (argc, argv, "w:c:l:b:s:B:D:S:L:o:p:")) != -1){
+        switch (o) {
+            case 'w': w = atoi(optarg); break;
+            case 'c': c = atoi(optarg); break;
+            case 'l': l = atoi(optarg); break;
+            case 'b': b = atoi(optarg); break;
+            case 's': s = atoi(optarg); break;
+            case 'B': {
+                opt.block_sizes.clear();
+                stringstream ss(optarg);
+                string item;
+                while (getline(ss, item, ','))
+                    opt.block_sizes.push_back(atoll(item.c_str()));
+                break;
+            }
+            case 'D': opt.levels = atoll(optarg); break;
+            case 'S': opt.max_bits = atof(optarg); break;
+            case 'L': opt.max_latency = atof(optarg); break;
+            case 'o': opt.out_file = optarg; break;
+            case 'p': opt.threads = atoll(optarg); break;
+            case '?':
+                if(optopt == 'w' || optopt == 'c' || optopt == 'l' || optopt == 'b' || optopt == 's' ||
+                        optopt == 'B' || optopt == 'D' || optopt == 'S' || optopt == 'L' || optopt == 'o' ||
+                        optopt == 'p')
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                else
+                    fprintf(stderr,"Unknown option character `\\x%x'.\n",	optopt);
+                return 1;
+            default:  abort ();
+        }
+
+    }
+
+    //a sectioned index describes itself, so its header chooses the type to load
+    cstds::section_header header;
+    if (cstds::read_section_header(opt.file, header)) {
+        header.option('w', w);
+        header.option('c', c);
+        header.option('l', l);
+        header.option('b', b);
+        header.option('s', s);
+        opt.options = header.options;
+        cout << "Sectioned file: version " << header.version << ", options " << header.options << endl;
+    }
+
+    for (uint64_t bs : opt.block_sizes) {
+        if (bs < 2 or bs > 256 or (bs & (bs - 1)) != 0) {
+            cout << "Error: the -B values must be powers of two in [2,256]" << endl;
+            return 1;
+        }
+    }
+    if (w != 4) {
+        vector<uint64_t> sizes;
+        for (uint64_t bs : opt.block_sizes) {
+            if (bs == 8 or bs == 16 or bs == 32)
+                sizes.push_back(bs);
+        }
+        opt.block_sizes = sizes;
+    }
+    if (opt.block_sizes.empty()) {
+        cout << "Error: the -B option needs at least one block size" << (w != 4 ? " in 8, 16 and 32" : "") << endl;
+        return 1;
+    }
+    if (w != 0 and w != 1 and w != 4) {
+        cout << "Error: the -w option must be 0, 1 or 4" << endl;
+        return 1;
+    }
+
+    if (c == 0 and l == 0) {
+        cout << "index: cst_cn<csa_wt, lcp_dac>" << std::endl;
+        tune_index<csa_wt<>, lcp_dac<> >(w, b, s, opt);
+    } else if (c == 0 and l == 1) {
+        cout << "index: cst_cn<csa_wt, lcp_support_sada>" << std::endl;
+        tune_index<csa_wt<>, lcp_support_sada<> >(w, b, s, opt);
+    } else if (c == 1 and l == 0) {
+        cout << "index: cst_cn<csa_sada, lcp_dac>" << std::endl;
+        tune_index<csa_sada<>, lcp_dac<> >(w, b, s, opt);
+    } else if (c == 1 and l == 1) {
+        cout << "index: cst_cn<csa_sada, lcp_support_sada>" << std::endl;
+        tune_index<csa_sada<>, lcp_support_sada<> >(w, b, s, opt);
+    } else
+        cout << "Error: the -c and -l options must be in [0,1]" << endl;
+
+    return 0;
+}